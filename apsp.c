@@ -0,0 +1,186 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "apsp.h"
+#include "minplus.h"
+
+// What every thread of one apsp_floyd_warshall call shares
+typedef struct {
+    distance_t* dist;
+    size_t num_nodes;
+    size_t num_tiles; // tiles per row
+    size_t num_threads;
+    pthread_barrier_t barrier;
+} blocked_t;
+
+typedef struct {
+    blocked_t* blocked;
+    size_t id;
+} worker_args_t;
+
+void apsp_floyd_warshall_reference(distance_t* dist, size_t num_nodes)
+{
+    for (size_t intermediate = 0; intermediate < num_nodes; intermediate++) {
+        for (size_t src = 0; src < num_nodes; src++) {
+            for (size_t dst = 0; dst < num_nodes; dst++) {
+                distance_t through = dist[src * num_nodes + intermediate] + dist[intermediate * num_nodes + dst];
+                if (through < dist[src * num_nodes + dst]) {
+                    dist[src * num_nodes + dst] = through;
+                }
+            }
+        }
+    }
+}
+
+// Relaxes tile (row_tile, column_tile) through the intermediates of tile k_tile
+// Any order of these updates gives the reference result: the distances read through an intermediate k,
+// dist[i][k] and dist[k][j], cannot shrink while relaxing through k because dist[k][k] is never negative
+static void relax_tile(const blocked_t* blocked, size_t row_tile, size_t column_tile, size_t k_tile)
+{
+    size_t n = blocked->num_nodes;
+    size_t row_end = (row_tile + 1) * APSP_TILE < n ? (row_tile + 1) * APSP_TILE : n;
+    size_t column_start = column_tile * APSP_TILE;
+    size_t column_end = column_start + APSP_TILE < n ? column_start + APSP_TILE : n;
+    size_t k_end = (k_tile + 1) * APSP_TILE < n ? (k_tile + 1) * APSP_TILE : n;
+    for (size_t k = k_tile * APSP_TILE; k < k_end; k++) {
+        const distance_t* k_row = &blocked->dist[k * n];
+        for (size_t i = row_tile * APSP_TILE; i < row_end; i++) {
+            distance_t* row = &blocked->dist[i * n];
+            minplus_relax(&row[column_start], &k_row[column_start], row[k], column_end - column_start);
+        }
+    }
+}
+
+static void* blocked_worker(void* arg)
+{
+    worker_args_t* args = arg;
+    blocked_t* blocked = args->blocked;
+    size_t tiles = blocked->num_tiles;
+    for (size_t k_tile = 0; k_tile < tiles; k_tile++) {
+        // phase 1: the diagonal tile depends only on itself
+        if (args->id == 0) {
+            relax_tile(blocked, k_tile, k_tile, k_tile);
+        }
+        pthread_barrier_wait(&blocked->barrier);
+        // phase 2: the rest of row and column k_tile, each tile depending on itself and the diagonal one
+        for (size_t other = args->id; other < 2 * tiles; other += blocked->num_threads) {
+            size_t tile = other / 2;
+            if (tile != k_tile) {
+                if (other % 2 == 0) {
+                    relax_tile(blocked, k_tile, tile, k_tile);
+                } else {
+                    relax_tile(blocked, tile, k_tile, k_tile);
+                }
+            }
+        }
+        pthread_barrier_wait(&blocked->barrier);
+        // phase 3: every other tile, depending only on its own row's and column's tiles from phase 2
+        for (size_t tile = args->id; tile < tiles * tiles; tile += blocked->num_threads) {
+            size_t row_tile = tile / tiles;
+            size_t column_tile = tile % tiles;
+            if (row_tile != k_tile && column_tile != k_tile) {
+                relax_tile(blocked, row_tile, column_tile, k_tile);
+            }
+        }
+        pthread_barrier_wait(&blocked->barrier);
+    }
+    return NULL;
+}
+
+void apsp_floyd_warshall(distance_t* dist, size_t num_nodes, size_t num_threads)
+{
+    if (num_nodes == 0) {
+        return;
+    }
+    blocked_t blocked;
+    blocked.dist = dist;
+    blocked.num_nodes = num_nodes;
+    blocked.num_tiles = (num_nodes + APSP_TILE - 1) / APSP_TILE;
+    if (num_threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = cpus > 0 ? (size_t)cpus : 1;
+    }
+    // more threads than tiles in a row would have nothing to do in phase 2
+    blocked.num_threads = num_threads < blocked.num_tiles ? num_threads : blocked.num_tiles;
+    pthread_barrier_init(&blocked.barrier, NULL, (unsigned)blocked.num_threads);
+
+    pthread_t* threads = malloc(sizeof(pthread_t) * blocked.num_threads);
+    worker_args_t* args = malloc(sizeof(worker_args_t) * blocked.num_threads);
+    assert(threads != NULL && args != NULL);
+    for (size_t i = 0; i < blocked.num_threads; i++) {
+        args[i].blocked = &blocked;
+        args[i].id = i;
+    }
+    // the calling thread is worker 0
+    for (size_t i = 1; i < blocked.num_threads; i++) {
+        int pthread_status = pthread_create(&threads[i], NULL, blocked_worker, &args[i]);
+        assert(pthread_status == 0);
+        (void)pthread_status;
+    }
+    blocked_worker(&args[0]);
+    for (size_t i = 1; i < blocked.num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_barrier_destroy(&blocked.barrier);
+    free(args);
+    free(threads);
+}
+
+// Recomputes row src of dist from links alone, scanning for the nearest unsettled node each step
+static void dijkstra_row(distance_t* dist, const distance_t* links, size_t num_nodes, size_t src, bool* settled)
+{
+    distance_t* row = &dist[src * num_nodes];
+    for (size_t node = 0; node < num_nodes; node++) {
+        row[node] = links[src * num_nodes + node];
+        settled[node] = false;
+    }
+    row[src] = 0;
+    while (true) {
+        size_t nearest = num_nodes;
+        for (size_t node = 0; node < num_nodes; node++) {
+            if (!settled[node] && row[node] < inf_distance && (nearest == num_nodes || row[node] < row[nearest])) {
+                nearest = node;
+            }
+        }
+        if (nearest == num_nodes) {
+            return;
+        }
+        settled[nearest] = true;
+        minplus_relax(row, &links[nearest * num_nodes], row[nearest], num_nodes);
+    }
+}
+
+size_t apsp_update_link(distance_t* dist, const distance_t* links, size_t num_nodes, size_t src, size_t dst,
+                        distance_t old_cost)
+{
+    size_t n = num_nodes;
+    distance_t cost = links[src * n + dst];
+    if (src == dst || cost == old_cost) {
+        return 0;
+    }
+    if (cost < old_cost) {
+        // a shortest path crosses the link at most once, so the distances at either end of it are final
+        for (size_t i = 0; i < n; i++) {
+            distance_t to_src = dist[i * n + src];
+            if (to_src < inf_distance && to_src + cost < inf_distance) {
+                minplus_relax(&dist[i * n], &dist[dst * n], to_src + cost, n);
+            }
+        }
+        return 0;
+    }
+    // a shortest path from i over the link has a shortest path to dst over it as its prefix
+    bool* settled = malloc(sizeof(bool) * n);
+    assert(settled != NULL);
+    size_t recomputed = 0;
+    for (size_t i = 0; i < n; i++) {
+        distance_t to_dst = dist[i * n + dst];
+        if (to_dst < inf_distance && dist[i * n + src] + old_cost == to_dst) {
+            dijkstra_row(dist, links, n, i, settled);
+            recomputed++;
+        }
+    }
+    free(settled);
+    return recomputed;
+}
@@ -0,0 +1,33 @@
+#ifndef APSP_H
+#define APSP_H
+
+#include <stddef.h>
+
+// All-pairs shortest paths over the router topologies of stress.c
+// Distances are stored row-major in num_nodes * num_nodes arrays, inf_distance for no path; every entry must
+// be at most inf_distance, so the sum of two never overflows
+
+typedef unsigned int distance_t;
+
+static const distance_t inf_distance = 0x7fffffff;
+
+// Edge length of the square tiles apsp_floyd_warshall works on, 64 * 64 distances fill 16 KiB
+#define APSP_TILE 64
+
+// Turns the link costs in dist into shortest path distances in place, with the textbook triple loop
+void apsp_floyd_warshall_reference(distance_t* dist, size_t num_nodes);
+
+// Same result as apsp_floyd_warshall_reference, bit for bit, computed tile by tile: for each diagonal tile,
+// the tile itself, then its row and column of tiles, then all the other tiles, the last two phases spread
+// over num_threads threads (0 for one per online CPU)
+void apsp_floyd_warshall(distance_t* dist, size_t num_nodes, size_t num_threads);
+
+// Brings the shortest distances in dist up to date after the cost of the link from src to dst changed from
+// old_cost to the one in links, the num_nodes * num_nodes matrix of link costs with the change made
+// A cheaper link relaxes every row through it, O(num_nodes^2); a dearer or removed one reruns Dijkstra over
+// links, O(num_nodes^2) each, from just the sources whose shortest paths to dst went over it
+// Returns the number of rows recomputed that way
+size_t apsp_update_link(distance_t* dist, const distance_t* links, size_t num_nodes, size_t src, size_t dst,
+                        distance_t old_cost);
+
+#endif // APSP_H
@@ -0,0 +1,985 @@
+// Microbenchmarks for channel_t, separate from the pass/fail tests in test.c
+// Usage: ./bench [--csv | --json] [--reps N] [--quick] [--only BENCHMARK] [--impl QUEUE] [--verbose]
+// Every configuration is run N times (5 by default); each row gives the median of those runs and a 95%
+// confidence interval of their mean (Student's t), so changes can be told apart from run-to-run noise
+// Rows carry two parameters, param1 and param2 (0 when unused), whose meaning depends on the benchmark:
+//   pingpong, spsc, mpsc, mpmc  producers and consumers, over channels and the queues in bench_baselines.h
+//   select_fanin                producers and consumers (always 1)
+//   close_wakeup                param2 is the number of receivers woken by channel_close
+//   ring_load*, ring_occupancy_load*
+//                               threads in the stress_send_recv ring; --verbose writes per-thread hops to stderr
+//   router_*                    nodes in a generated topology (topogen.h) for run_stress, with deltas (impl
+//                               channel) or whole vectors (impl channel_full)
+//   router_workers_*            nodes and worker threads, with routers placed by partition or round robin (impl)
+//   router_reconverge_*         nodes, per link update made cheaper or dearer, plus the time to update the
+//                               reference solution (apsp_update_link)
+//   router_buffers_*            nodes, with router channels buffering 1 to 64 vectors (buffer)
+//   apsp                        nodes and threads, reference against blocked Floyd-Warshall (apsp.h)
+//   minplus                     vector length, for each min-plus kernel this CPU supports (minplus.h)
+//   topology_matrix, topology_edges
+//                               nodes and parser threads, in MB/s against one fscanf per entry (topology.h)
+//   topology_setup              nodes, router setup from a text file against a binary one with its solution
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "apsp.h"
+#include "bench_baselines.h"
+#include "bench_queue.h"
+#include "minplus.h"
+#include "channel.h"
+#include "stress.h"
+#include "stress_send_recv.h"
+#include "timer.h"
+#include "topogen.h"
+#include "topology.h"
+
+#define MAX_REPS 64
+
+// Tells a consumer to stop, never a real message
+static char stop_marker;
+#define BENCH_STOP ((void*)&stop_marker)
+
+typedef struct {
+    size_t reps;
+    size_t messages;   // messages per throughput run
+    size_t roundtrips; // round trips per ping-pong run
+    useconds_t ring_usec; // duration of each ring run
+    size_t router_max_nodes; // largest generated topology for the router benchmarks
+    bool verbose;
+    bool json;
+    const char* only;  // run only this benchmark, NULL for all
+    const char* impl;  // run only over this queue, NULL for all
+    size_t rows;       // rows written so far, for the JSON separators
+} bench_config_t;
+
+// channel_t behind the benchmark queue interface
+
+static void* channel_queue_create(size_t capacity)
+{
+    return channel_create(capacity);
+}
+
+static void channel_queue_destroy(void* queue)
+{
+    channel_close(queue);
+    channel_destroy(queue);
+}
+
+static void channel_queue_send(void* queue, void* data)
+{
+    enum channel_status status = channel_send(queue, data);
+    assert(status == SUCCESS);
+    (void)status;
+}
+
+static void* channel_queue_receive(void* queue)
+{
+    void* data = NULL;
+    enum channel_status status = channel_receive(queue, &data);
+    assert(status == SUCCESS);
+    (void)status;
+    return data;
+}
+
+static const bench_queue_ops_t channel_queue = {
+    "channel", channel_queue_create, channel_queue_destroy, channel_queue_send, channel_queue_receive,
+};
+
+// Statistics and output
+
+// Two-sided 95% Student's t quantiles for 1 to 30 degrees of freedom
+static const double t_quantiles[30] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+static int compare_doubles(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void report(bench_config_t* config, const char* benchmark, const char* impl, size_t buffer, size_t param1,
+                   size_t param2, const char* unit, double* samples, size_t reps)
+{
+    qsort(samples, reps, sizeof(double), compare_doubles);
+    double median = reps % 2 == 1 ? samples[reps / 2] : (samples[reps / 2 - 1] + samples[reps / 2]) / 2.0;
+    double mean = 0.0;
+    for (size_t i = 0; i < reps; i++) {
+        mean += samples[i];
+    }
+    mean /= (double)reps;
+    double variance = 0.0;
+    for (size_t i = 0; i < reps; i++) {
+        variance += (samples[i] - mean) * (samples[i] - mean);
+    }
+    double half_width = 0.0;
+    if (reps > 1) {
+        double t = reps - 1 <= 30 ? t_quantiles[reps - 2] : 1.96;
+        half_width = t * sqrt(variance / (double)(reps - 1)) / sqrt((double)reps);
+    }
+    if (config->json) {
+        printf("%s  {\"benchmark\": \"%s\", \"impl\": \"%s\", \"buffer\": %zu, \"param1\": %zu, \"param2\": %zu, "
+               "\"unit\": \"%s\", \"median\": %.1f, \"ci95_low\": %.1f, \"ci95_high\": %.1f, \"reps\": %zu}",
+               config->rows == 0 ? "" : ",\n", benchmark, impl, buffer, param1, param2, unit, median,
+               mean - half_width, mean + half_width, reps);
+    } else {
+        printf("%s,%s,%zu,%zu,%zu,%s,%.1f,%.1f,%.1f,%zu\n", benchmark, impl, buffer, param1, param2, unit, median,
+               mean - half_width, mean + half_width, reps);
+    }
+    fflush(stdout);
+    config->rows++;
+}
+
+// Producer/consumer throughput over any queue
+
+typedef struct {
+    const bench_queue_ops_t* ops;
+    void* queue;
+    size_t count;                // messages this producer sends
+    pthread_barrier_t* start;    // released once every thread is ready
+    atomic_size_t* received;     // messages taken by all consumers
+} throughput_args;
+
+static void* throughput_producer(void* arg)
+{
+    throughput_args* args = arg;
+    pthread_barrier_wait(args->start);
+    for (size_t i = 1; i <= args->count; i++) {
+        args->ops->send(args->queue, (void*)(uintptr_t)i);
+    }
+    return NULL;
+}
+
+static void* throughput_consumer(void* arg)
+{
+    throughput_args* args = arg;
+    size_t received = 0;
+    pthread_barrier_wait(args->start);
+    while (args->ops->receive(args->queue) != BENCH_STOP) {
+        received++;
+    }
+    atomic_fetch_add(args->received, received);
+    return NULL;
+}
+
+// Returns messages per second for producers threads sending messages in total to consumers threads
+static double run_throughput(const bench_queue_ops_t* ops, size_t buffer, size_t producers, size_t consumers, size_t messages)
+{
+    void* queue = ops->create(buffer);
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, (unsigned)(producers + consumers + 1));
+    atomic_size_t received;
+    atomic_init(&received, 0);
+    pthread_t* threads = malloc(sizeof(pthread_t) * (producers + consumers));
+    throughput_args* args = malloc(sizeof(throughput_args) * (producers + consumers));
+    assert(threads != NULL && args != NULL);
+    for (size_t i = 0; i < producers + consumers; i++) {
+        args[i].ops = ops;
+        args[i].queue = queue;
+        // spread the messages over the producers, the first ones take the remainder
+        args[i].count = i < producers ? messages / producers + (i < messages % producers) : 0;
+        args[i].start = &start;
+        args[i].received = &received;
+        int pthread_status = pthread_create(&threads[i], NULL, i < producers ? throughput_producer : throughput_consumer, &args[i]);
+        assert(pthread_status == 0);
+        (void)pthread_status;
+    }
+    pthread_barrier_wait(&start);
+    uint64_t begin = timer_now_ns();
+    for (size_t i = 0; i < producers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (size_t i = 0; i < consumers; i++) {
+        ops->send(queue, BENCH_STOP);
+    }
+    for (size_t i = producers; i < producers + consumers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed = timer_now_ns() - begin;
+    assert(atomic_load(&received) == messages);
+    pthread_barrier_destroy(&start);
+    free(args);
+    free(threads);
+    ops->destroy(queue);
+    return (double)messages * 1e9 / (double)elapsed;
+}
+
+// Ping-pong between two threads over a pair of queues
+
+typedef struct {
+    const bench_queue_ops_t* ops;
+    void* ping;
+    void* pong;
+} pingpong_args;
+
+static void* pingpong_echo(void* arg)
+{
+    pingpong_args* args = arg;
+    void* data;
+    while ((data = args->ops->receive(args->ping)) != BENCH_STOP) {
+        args->ops->send(args->pong, data);
+    }
+    return NULL;
+}
+
+// Returns the mean round-trip time in ns
+static double run_pingpong(const bench_queue_ops_t* ops, size_t buffer, size_t roundtrips)
+{
+    pingpong_args args = {ops, ops->create(buffer), ops->create(buffer)};
+    pthread_t echo;
+    int pthread_status = pthread_create(&echo, NULL, pingpong_echo, &args);
+    assert(pthread_status == 0);
+    (void)pthread_status;
+    // warm up both threads and the queues before timing
+    for (size_t i = 1; i <= roundtrips / 10 + 1; i++) {
+        ops->send(args.ping, (void*)(uintptr_t)i);
+        ops->receive(args.pong);
+    }
+    uint64_t begin = timer_now_ns();
+    for (size_t i = 1; i <= roundtrips; i++) {
+        ops->send(args.ping, (void*)(uintptr_t)i);
+        void* data = ops->receive(args.pong);
+        assert(data == (void*)(uintptr_t)i);
+        (void)data;
+    }
+    uint64_t elapsed = timer_now_ns() - begin;
+    ops->send(args.ping, BENCH_STOP);
+    pthread_join(echo, NULL);
+    ops->destroy(args.ping);
+    ops->destroy(args.pong);
+    return (double)elapsed / (double)roundtrips;
+}
+
+// Select fan-in: one consumer selecting over one channel per producer
+
+typedef struct {
+    channel_t* channel;
+    size_t count;
+    pthread_barrier_t* start;
+} fanin_args;
+
+static void* fanin_producer(void* arg)
+{
+    fanin_args* args = arg;
+    pthread_barrier_wait(args->start);
+    for (size_t i = 1; i <= args->count; i++) {
+        channel_send(args->channel, (void*)(uintptr_t)i);
+    }
+    return NULL;
+}
+
+// Returns messages per second received by channel_select over producers channels
+static double run_select_fanin(size_t buffer, size_t producers, size_t messages)
+{
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, (unsigned)(producers + 1));
+    pthread_t* threads = malloc(sizeof(pthread_t) * producers);
+    fanin_args* args = malloc(sizeof(fanin_args) * producers);
+    select_t* list = malloc(sizeof(select_t) * producers);
+    assert(threads != NULL && args != NULL && list != NULL);
+    for (size_t i = 0; i < producers; i++) {
+        args[i].channel = channel_create(buffer);
+        args[i].count = messages / producers + (i < messages % producers);
+        args[i].start = &start;
+        list[i].channel = args[i].channel;
+        list[i].dir = RECV;
+        int pthread_status = pthread_create(&threads[i], NULL, fanin_producer, &args[i]);
+        assert(pthread_status == 0);
+        (void)pthread_status;
+    }
+    pthread_barrier_wait(&start);
+    uint64_t begin = timer_now_ns();
+    for (size_t received = 0; received < messages; received++) {
+        size_t index;
+        enum channel_status status = channel_select(list, producers, &index);
+        assert(status == SUCCESS);
+        (void)status;
+    }
+    uint64_t elapsed = timer_now_ns() - begin;
+    for (size_t i = 0; i < producers; i++) {
+        pthread_join(threads[i], NULL);
+        channel_queue_destroy(args[i].channel);
+    }
+    pthread_barrier_destroy(&start);
+    free(list);
+    free(args);
+    free(threads);
+    return (double)messages * 1e9 / (double)elapsed;
+}
+
+// Close wakeup: how long channel_close takes to release every blocked receiver
+
+typedef struct {
+    channel_t* channel;
+    atomic_uint_fast64_t* last_wakeup;
+} close_args;
+
+static void* close_waiter(void* arg)
+{
+    close_args* args = arg;
+    void* data;
+    enum channel_status status = channel_receive(args->channel, &data);
+    assert(status == CLOSED_ERROR);
+    (void)status;
+    uint64_t now = timer_now_ns();
+    uint64_t last = atomic_load(args->last_wakeup);
+    while (now > last && !atomic_compare_exchange_weak(args->last_wakeup, &last, now)) {
+    }
+    return NULL;
+}
+
+// Returns the ns from calling channel_close until the last of waiters blocked receivers has returned
+static double run_close_wakeup(size_t waiters)
+{
+    channel_t* channel = channel_create(1);
+    atomic_uint_fast64_t last_wakeup;
+    atomic_init(&last_wakeup, 0);
+    close_args args = {channel, &last_wakeup};
+    pthread_t* threads = malloc(sizeof(pthread_t) * waiters);
+    assert(threads != NULL);
+    for (size_t i = 0; i < waiters; i++) {
+        int pthread_status = pthread_create(&threads[i], NULL, close_waiter, &args);
+        assert(pthread_status == 0);
+        (void)pthread_status;
+    }
+    // wait until every receiver sleeps on the channel
+    bool all_blocked = false;
+    while (!all_blocked) {
+        pthread_mutex_lock(&channel->channel_lock);
+        all_blocked = channel->blocked_receivers == waiters;
+        pthread_mutex_unlock(&channel->channel_lock);
+        sched_yield();
+    }
+    uint64_t begin = timer_now_ns();
+    channel_close(channel);
+    for (size_t i = 0; i < waiters; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    channel_destroy(channel);
+    free(threads);
+    return (double)(atomic_load(&last_wakeup) - begin);
+}
+
+// Sweeps
+
+static const size_t buffer_sizes[] = {1, 16, 256};
+#define NUM_BUFFER_SIZES (sizeof(buffer_sizes) / sizeof(buffer_sizes[0]))
+static const size_t thread_counts[] = {2, 4, 8};
+#define NUM_THREAD_COUNTS (sizeof(thread_counts) / sizeof(thread_counts[0]))
+
+static const bench_queue_ops_t* const queues[] = {&channel_queue, &pipe_queue, &eventfd_queue, &mutex_queue, &lockfree_queue};
+#define NUM_QUEUES (sizeof(queues) / sizeof(queues[0]))
+
+static bool selected(const bench_config_t* config, const char* benchmark)
+{
+    return config->only == NULL || strcmp(config->only, benchmark) == 0;
+}
+
+static bool impl_selected(const bench_config_t* config, const char* impl)
+{
+    return config->impl == NULL || strcmp(config->impl, impl) == 0;
+}
+
+static void bench_throughput(bench_config_t* config, const char* benchmark, const bench_queue_ops_t* ops,
+                             size_t buffer, size_t producers, size_t consumers)
+{
+    double samples[MAX_REPS];
+    for (size_t rep = 0; rep < config->reps; rep++) {
+        samples[rep] = run_throughput(ops, buffer, producers, consumers, config->messages);
+    }
+    report(config, benchmark, ops->name, buffer, producers, consumers, "msgs/s", samples, config->reps);
+}
+
+// Runs every producer/consumer workload over the given queue
+static void bench_queue(bench_config_t* config, const bench_queue_ops_t* ops)
+{
+    double samples[MAX_REPS];
+    for (size_t b = 0; b < NUM_BUFFER_SIZES; b++) {
+        size_t buffer = buffer_sizes[b];
+        if (selected(config, "pingpong")) {
+            for (size_t rep = 0; rep < config->reps; rep++) {
+                samples[rep] = run_pingpong(ops, buffer, config->roundtrips);
+            }
+            report(config, "pingpong", ops->name, buffer, 1, 1, "ns/roundtrip", samples, config->reps);
+        }
+        if (selected(config, "spsc")) {
+            bench_throughput(config, "spsc", ops, buffer, 1, 1);
+        }
+        for (size_t t = 0; t < NUM_THREAD_COUNTS; t++) {
+            if (selected(config, "mpsc")) {
+                bench_throughput(config, "mpsc", ops, buffer, thread_counts[t], 1);
+            }
+            if (selected(config, "mpmc")) {
+                bench_throughput(config, "mpmc", ops, buffer, thread_counts[t], thread_counts[t]);
+            }
+        }
+    }
+}
+
+// Runs the workloads that only exist for channels
+static void bench_channel_only(bench_config_t* config)
+{
+    double samples[MAX_REPS];
+    if (selected(config, "select_fanin")) {
+        for (size_t b = 0; b < NUM_BUFFER_SIZES; b++) {
+            for (size_t t = 0; t < NUM_THREAD_COUNTS; t++) {
+                for (size_t rep = 0; rep < config->reps; rep++) {
+                    samples[rep] = run_select_fanin(buffer_sizes[b], thread_counts[t], config->messages);
+                }
+                report(config, "select_fanin", "channel", buffer_sizes[b], thread_counts[t], 1, "msgs/s", samples, config->reps);
+            }
+        }
+    }
+    if (selected(config, "close_wakeup")) {
+        static const size_t waiters[] = {1, 4, 16};
+        for (size_t w = 0; w < sizeof(waiters) / sizeof(waiters[0]); w++) {
+            for (size_t rep = 0; rep < config->reps; rep++) {
+                samples[rep] = run_close_wakeup(waiters[w]);
+            }
+            report(config, "close_wakeup", "channel", 1, 0, waiters[w], "ns", samples, config->reps);
+        }
+    }
+}
+
+// Ring: messages passed around a ring of threads, one channel per thread (stress_send_recv)
+
+static const size_t ring_thread_counts[] = {1, 2, 4, 8, 16};
+#define NUM_RING_THREAD_COUNTS (sizeof(ring_thread_counts) / sizeof(ring_thread_counts[0]))
+// a full ring would deadlock, every thread holding a message and waiting for space in the next channel
+static const double ring_loads[] = {0.25, 0.5, 0.75};
+#define NUM_RING_LOADS (sizeof(ring_loads) / sizeof(ring_loads[0]))
+
+static void bench_ring(bench_config_t* config)
+{
+    if (!selected(config, "ring")) {
+        return;
+    }
+    double hops[MAX_REPS];
+    double occupancy[MAX_REPS];
+    for (size_t l = 0; l < NUM_RING_LOADS; l++) {
+        char hops_name[32];
+        char occupancy_name[32];
+        snprintf(hops_name, sizeof(hops_name), "ring_load%d", (int)(ring_loads[l] * 100));
+        snprintf(occupancy_name, sizeof(occupancy_name), "ring_occupancy_load%d", (int)(ring_loads[l] * 100));
+        for (size_t b = 0; b < NUM_BUFFER_SIZES; b++) {
+            for (size_t t = 0; t < NUM_RING_THREAD_COUNTS; t++) {
+                if ((size_t)((double)(ring_thread_counts[t] * (buffer_sizes[b] + 1)) * ring_loads[l]) == 0) {
+                    continue; // too small a ring for even one message at this load
+                }
+                for (size_t rep = 0; rep < config->reps; rep++) {
+                    stress_send_recv_report_t ring;
+                    run_stress_send_recv_report(buffer_sizes[b], ring_thread_counts[t], ring_loads[l], config->ring_usec, &ring);
+                    if (config->verbose) {
+                        stress_send_recv_report_print(stderr, &ring);
+                    }
+                    hops[rep] = ring.hops_per_sec;
+                    occupancy[rep] = ring.occupancy * 100;
+                    free(ring.thread_hops);
+                }
+                report(config, hops_name, "channel", buffer_sizes[b], ring_thread_counts[t], 0,
+                       "hops/s", hops, config->reps);
+                report(config, occupancy_name, "channel", buffer_sizes[b], ring_thread_counts[t], 0,
+                       "%", occupancy, config->reps);
+            }
+        }
+    }
+}
+
+// Router: one thread per node exchanging distance vectors over channel_select until they converge (stress.c)
+
+static const size_t router_sizes[] = {64, 256, 1024};
+#define NUM_ROUTER_SIZES (sizeof(router_sizes) / sizeof(router_sizes[0]))
+// a complete graph sends about num_nodes^2 vectors, each through a select over num_nodes channels
+#define ROUTER_COMPLETE_MAX_NODES 64
+
+static void bench_router(bench_config_t* config)
+{
+    if (!selected(config, "router")) {
+        return;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench_topology_%d.txt", (int)getpid());
+    double converge[MAX_REPS];
+    double setup[MAX_REPS];
+    double messages[MAX_REPS];
+    double selects[MAX_REPS];
+    double entries[MAX_REPS];
+    double full_converge[MAX_REPS];
+    double full_entries[MAX_REPS];
+    for (size_t kind = 0; kind < TOPOGEN_KIND_COUNT; kind++) {
+        const char* kind_name = topogen_kind_name((enum topogen_kind)kind);
+        for (size_t s = 0; s < NUM_ROUTER_SIZES && router_sizes[s] <= config->router_max_nodes; s++) {
+            if (kind == TOPOGEN_COMPLETE && router_sizes[s] > ROUTER_COMPLETE_MAX_NODES) {
+                continue;
+            }
+            topogen_config_t topology = {(enum topogen_kind)kind, router_sizes[s], 4, 10, 1};
+            topogen_graph_t graph;
+            int status = topogen_generate(&topology, &graph);
+            assert(status == 0);
+            FILE* file = fopen(path, "w");
+            assert(file != NULL);
+            status = topogen_write_edges(file, &graph);
+            assert(status == 0);
+            (void)status;
+            fclose(file);
+            topogen_free(&graph);
+            for (size_t rep = 0; rep < config->reps; rep++) {
+                stress_report_t router;
+                run_stress_report(1, 1, path, &router);
+                converge[rep] = router.converge_seconds * 1e3;
+                setup[rep] = router.setup_seconds * 1e3;
+                messages[rep] = (double)router.messages;
+                selects[rep] = (double)router.selects;
+                entries[rep] = (double)router.entries;
+                stress_config_t full = {1, 1, true, 0, STRESS_PARTITIONED};
+                run_stress_config(path, &full, &router);
+                full_converge[rep] = router.converge_seconds * 1e3;
+                full_entries[rep] = (double)router.entries;
+            }
+            char name[64];
+            snprintf(name, sizeof(name), "router_%s", kind_name);
+            report(config, name, "channel", 1, router_sizes[s], 0, "ms", converge, config->reps);
+            snprintf(name, sizeof(name), "router_%s_setup", kind_name);
+            report(config, name, "channel", 1, router_sizes[s], 0, "ms", setup, config->reps);
+            snprintf(name, sizeof(name), "router_%s_messages", kind_name);
+            report(config, name, "channel", 1, router_sizes[s], 0, "msgs", messages, config->reps);
+            snprintf(name, sizeof(name), "router_%s_selects", kind_name);
+            report(config, name, "channel", 1, router_sizes[s], 0, "selects", selects, config->reps);
+            snprintf(name, sizeof(name), "router_%s_entries", kind_name);
+            report(config, name, "channel", 1, router_sizes[s], 0, "entries", entries, config->reps);
+            // the same runs with every distance vector sent whole
+            snprintf(name, sizeof(name), "router_%s", kind_name);
+            report(config, name, "channel_full", 1, router_sizes[s], 0, "ms", full_converge, config->reps);
+            snprintf(name, sizeof(name), "router_%s_entries", kind_name);
+            report(config, name, "channel_full", 1, router_sizes[s], 0, "entries", full_entries, config->reps);
+        }
+    }
+    unlink(path);
+}
+
+// The router workload on fewer threads than routers, placed by partition_topology against round robin
+static void bench_router_workers(bench_config_t* config)
+{
+    if (!selected(config, "router_workers")) {
+        return;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench_topology_%d.txt", (int)getpid());
+    double converge[MAX_REPS];
+    double local[MAX_REPS];
+    enum topogen_kind kinds[] = {TOPOGEN_GEOMETRIC, TOPOGEN_SCALE_FREE};
+    enum stress_placement placements[] = {STRESS_PARTITIONED, STRESS_ROUND_ROBIN};
+    const char* placement_names[] = {"channel_partitioned", "channel_round_robin"};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        const char* kind_name = topogen_kind_name(kinds[k]);
+        for (size_t s = 0; s < NUM_ROUTER_SIZES && router_sizes[s] <= config->router_max_nodes; s++) {
+            topogen_config_t topology = {kinds[k], router_sizes[s], 4, 10, 1};
+            topogen_graph_t graph;
+            int status = topogen_generate(&topology, &graph);
+            assert(status == 0);
+            FILE* file = fopen(path, "w");
+            assert(file != NULL);
+            status = topogen_write_edges(file, &graph);
+            assert(status == 0);
+            (void)status;
+            fclose(file);
+            topogen_free(&graph);
+            for (size_t t = 0; t < NUM_THREAD_COUNTS; t++) {
+                for (size_t p = 0; p < sizeof(placements) / sizeof(placements[0]); p++) {
+                    stress_config_t workers = {1, 1, false, thread_counts[t], placements[p]};
+                    for (size_t rep = 0; rep < config->reps; rep++) {
+                        stress_report_t router;
+                        run_stress_config(path, &workers, &router);
+                        converge[rep] = router.converge_seconds * 1e3;
+                        local[rep] = router.messages > 0 ? 100.0 * (double)router.local_messages / (double)router.messages : 0;
+                    }
+                    char name[64];
+                    snprintf(name, sizeof(name), "router_workers_%s", kind_name);
+                    report(config, name, placement_names[p], 1, router_sizes[s], thread_counts[t], "ms", converge, config->reps);
+                    snprintf(name, sizeof(name), "router_workers_%s_local", kind_name);
+                    report(config, name, placement_names[p], 1, router_sizes[s], thread_counts[t], "%", local, config->reps);
+                }
+            }
+        }
+    }
+    unlink(path);
+}
+
+// Link updates applied to converged routers at every fourth of the links, each made cheaper or dearer
+#define ROUTER_UPDATES 4
+
+// Reconvergence after link updates, per update, against converging from cold in the router rows
+static void bench_router_updates(bench_config_t* config)
+{
+    if (!selected(config, "router_updates")) {
+        return;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench_topology_%d.txt", (int)getpid());
+    double reconverge[MAX_REPS];
+    double verify[MAX_REPS];
+    enum topogen_kind kinds[] = {TOPOGEN_GEOMETRIC, TOPOGEN_SCALE_FREE};
+    const char* directions[] = {"cheaper", "dearer"};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        const char* kind_name = topogen_kind_name(kinds[k]);
+        for (size_t s = 0; s < NUM_ROUTER_SIZES && router_sizes[s] <= config->router_max_nodes; s++) {
+            topogen_config_t topology = {kinds[k], router_sizes[s], 4, 10, 1};
+            topogen_graph_t graph;
+            int status = topogen_generate(&topology, &graph);
+            assert(status == 0);
+            FILE* file = fopen(path, "w");
+            assert(file != NULL);
+            status = topogen_write_edges(file, &graph);
+            assert(status == 0);
+            (void)status;
+            fclose(file);
+            for (size_t d = 0; d < 2; d++) {
+                stress_link_update_t updates[ROUTER_UPDATES];
+                for (size_t u = 0; u < ROUTER_UPDATES; u++) {
+                    const topogen_edge_t* edge = &graph.edges[u * graph.num_edges / ROUTER_UPDATES];
+                    updates[u] = (stress_link_update_t){edge->src, edge->dst, d == 0 ? 1 : edge->cost * 10 + 10};
+                }
+                stress_config_t router_config = {1, 1, false, 0, STRESS_PARTITIONED, updates, ROUTER_UPDATES};
+                for (size_t rep = 0; rep < config->reps; rep++) {
+                    stress_report_t router;
+                    run_stress_config(path, &router_config, &router);
+                    reconverge[rep] = router.reconverge_seconds * 1e3 / ROUTER_UPDATES;
+                    verify[rep] = router.verify_seconds * 1e3 / ROUTER_UPDATES;
+                }
+                char name[64];
+                char impl[32];
+                snprintf(name, sizeof(name), "router_reconverge_%s", kind_name);
+                snprintf(impl, sizeof(impl), "channel_%s", directions[d]);
+                report(config, name, impl, 1, router_sizes[s], 0, "ms", reconverge, config->reps);
+                snprintf(name, sizeof(name), "router_reconverge_%s_verify", kind_name);
+                snprintf(impl, sizeof(impl), "apsp_update_%s", directions[d]);
+                report(config, name, impl, 1, router_sizes[s], 0, "ms", verify, config->reps);
+            }
+            topogen_free(&graph);
+        }
+    }
+    unlink(path);
+}
+
+static const size_t router_buffer_sizes[] = {1, 4, 16, 64};
+#define NUM_ROUTER_BUFFER_SIZES (sizeof(router_buffer_sizes) / sizeof(router_buffer_sizes[0]))
+
+// The router workload over deeper channels, each router keeping as many recent vectors as they can buffer
+static void bench_router_buffers(bench_config_t* config)
+{
+    if (!selected(config, "router_buffers")) {
+        return;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench_topology_%d.txt", (int)getpid());
+    double converge[MAX_REPS];
+    double throughput[MAX_REPS];
+    enum topogen_kind kinds[] = {TOPOGEN_GEOMETRIC, TOPOGEN_SCALE_FREE};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        const char* kind_name = topogen_kind_name(kinds[k]);
+        for (size_t s = 0; s < NUM_ROUTER_SIZES && router_sizes[s] <= config->router_max_nodes; s++) {
+            topogen_config_t topology = {kinds[k], router_sizes[s], 4, 10, 1};
+            topogen_graph_t graph;
+            int status = topogen_generate(&topology, &graph);
+            assert(status == 0);
+            FILE* file = fopen(path, "w");
+            assert(file != NULL);
+            status = topogen_write_edges(file, &graph);
+            assert(status == 0);
+            (void)status;
+            fclose(file);
+            topogen_free(&graph);
+            for (size_t b = 0; b < NUM_ROUTER_BUFFER_SIZES; b++) {
+                for (size_t rep = 0; rep < config->reps; rep++) {
+                    stress_report_t router;
+                    run_stress_report(router_buffer_sizes[b], 1, path, &router);
+                    converge[rep] = router.converge_seconds * 1e3;
+                    throughput[rep] = (double)router.messages / router.converge_seconds;
+                }
+                char name[64];
+                snprintf(name, sizeof(name), "router_buffers_%s", kind_name);
+                report(config, name, "channel", router_buffer_sizes[b], router_sizes[s], 0, "ms", converge, config->reps);
+                snprintf(name, sizeof(name), "router_buffers_%s_throughput", kind_name);
+                report(config, name, "channel", router_buffer_sizes[b], router_sizes[s], 0, "msgs/s", throughput, config->reps);
+            }
+        }
+    }
+    unlink(path);
+}
+
+// All-pairs shortest paths over a generated scale-free topology, the matrix stress.c verifies routers against
+
+static void bench_apsp(bench_config_t* config)
+{
+    if (!selected(config, "apsp")) {
+        return;
+    }
+    double samples[MAX_REPS];
+    for (size_t s = 0; s < NUM_ROUTER_SIZES && router_sizes[s] <= config->router_max_nodes; s++) {
+        size_t n = router_sizes[s];
+        topogen_config_t topology = {TOPOGEN_SCALE_FREE, n, 4, 10, 1};
+        topogen_graph_t graph;
+        int status = topogen_generate(&topology, &graph);
+        assert(status == 0);
+        (void)status;
+        distance_t* links = malloc(sizeof(distance_t) * n * n);
+        distance_t* dist = malloc(sizeof(distance_t) * n * n);
+        assert(links != NULL && dist != NULL);
+        for (size_t i = 0; i < n * n; i++) {
+            links[i] = i / n == i % n ? 0 : inf_distance;
+        }
+        for (size_t e = 0; e < graph.num_edges; e++) {
+            links[graph.edges[e].src * n + graph.edges[e].dst] = graph.edges[e].cost;
+        }
+        topogen_free(&graph);
+
+        for (size_t rep = 0; rep < config->reps; rep++) {
+            memcpy(dist, links, sizeof(distance_t) * n * n);
+            uint64_t begin = timer_now_ns();
+            apsp_floyd_warshall_reference(dist, n);
+            samples[rep] = (double)(timer_now_ns() - begin) / 1e6;
+        }
+        report(config, "apsp", "reference", 0, n, 1, "ms", samples, config->reps);
+        for (size_t t = 0; t < NUM_THREAD_COUNTS; t++) {
+            for (size_t rep = 0; rep < config->reps; rep++) {
+                memcpy(dist, links, sizeof(distance_t) * n * n);
+                uint64_t begin = timer_now_ns();
+                apsp_floyd_warshall(dist, n, thread_counts[t]);
+                samples[rep] = (double)(timer_now_ns() - begin) / 1e6;
+            }
+            report(config, "apsp", "blocked", 0, n, thread_counts[t], "ms", samples, config->reps);
+        }
+        free(links);
+        free(dist);
+    }
+}
+
+// Loading generated topology files, the part of router setup that grows with the file rather than the links
+
+// The matrix reader stress.c used before topology_load: one fscanf per entry, keeping only the link count
+static size_t scanf_matrix(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    assert(file != NULL);
+    size_t num_nodes;
+    int num_scanned = fscanf(file, "%zu", &num_nodes);
+    assert(num_scanned == 1);
+    size_t num_links = 0;
+    for (size_t entry = 0; entry < num_nodes * num_nodes; entry++) {
+        int distance;
+        num_scanned = fscanf(file, "%d", &distance);
+        assert(num_scanned == 1);
+        num_links += distance >= 0 && entry / num_nodes != entry % num_nodes;
+    }
+    (void)num_scanned;
+    fclose(file);
+    return num_links;
+}
+
+static void bench_topology(bench_config_t* config)
+{
+    if (!selected(config, "topology")) {
+        return;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench_topology_%d.txt", (int)getpid());
+    double samples[MAX_REPS];
+    for (size_t s = 0; s < NUM_ROUTER_SIZES && router_sizes[s] <= config->router_max_nodes; s++) {
+        size_t n = router_sizes[s];
+        topogen_config_t topology = {TOPOGEN_SCALE_FREE, n, 4, 10, 1};
+        topogen_graph_t graph;
+        int status = topogen_generate(&topology, &graph);
+        assert(status == 0);
+        for (int edges = 0; edges <= 1; edges++) {
+            FILE* file = fopen(path, "w");
+            assert(file != NULL);
+            status = edges ? topogen_write_edges(file, &graph) : topogen_write_matrix(file, &graph);
+            assert(status == 0);
+            (void)status;
+            fclose(file);
+            const char* name = edges ? "topology_edges" : "topology_matrix";
+            if (!edges) {
+                for (size_t rep = 0; rep < config->reps; rep++) {
+                    uint64_t begin = timer_now_ns();
+                    size_t num_links = scanf_matrix(path);
+                    uint64_t elapsed = timer_now_ns() - begin;
+                    assert(num_links == graph.num_edges);
+                    (void)num_links;
+                    struct stat info;
+                    stat(path, &info);
+                    samples[rep] = (double)info.st_size * 1e3 / (double)elapsed;
+                }
+                report(config, name, "fscanf", 0, n, 1, "MB/s", samples, config->reps);
+            }
+            for (size_t t = 0; t <= NUM_THREAD_COUNTS; t++) {
+                size_t threads = t == 0 ? 1 : thread_counts[t - 1];
+                for (size_t rep = 0; rep < config->reps; rep++) {
+                    topology_t* loaded = topology_load(path, threads);
+                    assert(loaded != NULL && loaded->num_links == graph.num_edges);
+                    samples[rep] = (double)loaded->file_bytes / 1e6 / loaded->load_seconds;
+                    topology_free(loaded);
+                }
+                report(config, name, "mmap", 0, n, threads, "MB/s", samples, config->reps);
+            }
+        }
+        topogen_free(&graph);
+
+        // router setup from the edge list just written, against its binary conversion with the solution
+        char binary_path[64];
+        snprintf(binary_path, sizeof(binary_path), "/tmp/bench_topology_%d.bin", (int)getpid());
+        distance_t* solution = malloc(sizeof(distance_t) * n * n);
+        assert(solution != NULL);
+        for (size_t rep = 0; rep < config->reps; rep++) {
+            uint64_t begin = timer_now_ns();
+            topology_t* loaded = topology_load(path, 0);
+            topology_to_matrix(loaded, solution);
+            apsp_floyd_warshall(solution, n, 0);
+            samples[rep] = (double)(timer_now_ns() - begin) / 1e6;
+            if (rep == 0) {
+                FILE* file = fopen(binary_path, "wb");
+                assert(file != NULL);
+                status = topology_write_binary(file, loaded, solution);
+                assert(status == 0);
+                fclose(file);
+            }
+            topology_free(loaded);
+        }
+        report(config, "topology_setup", "text", 0, n, 0, "ms", samples, config->reps);
+        for (size_t rep = 0; rep < config->reps; rep++) {
+            uint64_t begin = timer_now_ns();
+            topology_t* loaded = topology_load(binary_path, 0);
+            assert(loaded != NULL && loaded->solution != NULL);
+            memcpy(solution, loaded->solution, sizeof(distance_t) * n * n);
+            samples[rep] = (double)(timer_now_ns() - begin) / 1e6;
+            topology_free(loaded);
+        }
+        report(config, "topology_setup", "binary", 0, n, 0, "ms", samples, config->reps);
+        free(solution);
+        unlink(binary_path);
+    }
+    unlink(path);
+}
+
+// Min-plus relaxation of one distance vector through another, the per-message work of a router
+
+static void bench_minplus(bench_config_t* config)
+{
+    if (!selected(config, "minplus")) {
+        return;
+    }
+    static const size_t lengths[] = {256, 4096, 65536};
+    double samples[MAX_REPS];
+    enum minplus_impl detected = minplus_current();
+    for (int impl = MINPLUS_SCALAR; impl < MINPLUS_IMPL_COUNT; impl++) {
+        if (minplus_use((enum minplus_impl)impl) != 0) {
+            continue;
+        }
+        for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+            size_t count = lengths[l];
+            distance_t* dist = malloc(sizeof(distance_t) * count);
+            distance_t* through = malloc(sizeof(distance_t) * count);
+            assert(dist != NULL && through != NULL);
+            // about as many relaxations per run as the throughput benchmarks send messages
+            size_t rounds = config->messages * 64 / count + 1;
+            for (size_t rep = 0; rep < config->reps; rep++) {
+                for (size_t i = 0; i < count; i++) {
+                    dist[i] = (distance_t)(i * 7 % 1000);
+                    through[i] = (distance_t)(i * 13 % 1000);
+                }
+                uint64_t begin = timer_now_ns();
+                size_t changed = 0;
+                for (size_t round = 0; round < rounds; round++) {
+                    // an offset that shrinks every round keeps some entries changing
+                    changed += minplus_relax(dist, through, (distance_t)(rounds - round), count);
+                }
+                uint64_t elapsed = timer_now_ns() - begin;
+                assert(changed > 0);
+                samples[rep] = (double)(rounds * count) * 1e3 / (double)elapsed;
+            }
+            report(config, "minplus", minplus_impl_name((enum minplus_impl)impl), 0, count, 0, "Mdist/s", samples, config->reps);
+            free(dist);
+            free(through);
+        }
+    }
+    minplus_use(detected);
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [--csv | --json] [--reps N] [--quick] [--only BENCHMARK] [--impl QUEUE] [--verbose]\n"
+                    "Benchmarks: pingpong spsc mpsc mpmc select_fanin close_wakeup ring router router_workers router_updates router_buffers apsp minplus topology\n"
+                    "Queues:", program);
+    for (size_t q = 0; q < NUM_QUEUES; q++) {
+        fprintf(stderr, " %s", queues[q]->name);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv)
+{
+    bench_config_t config = {5, 200000, 20000, 200000, 1024, false, false, NULL, NULL, 0};
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) {
+            config.json = false;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            config.json = true;
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            config.reps = 3;
+            config.messages = 20000;
+            config.roundtrips = 2000;
+            config.ring_usec = 20000;
+            config.router_max_nodes = 256;
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            config.reps = (size_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            config.only = argv[++i];
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            config.verbose = true;
+        } else if (strcmp(argv[i], "--impl") == 0 && i + 1 < argc) {
+            config.impl = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.reps == 0 || config.reps > MAX_REPS) {
+        fprintf(stderr, "--reps must be between 1 and %d\n", MAX_REPS);
+        return 1;
+    }
+
+    if (config.json) {
+        printf("[\n");
+    } else {
+        printf("benchmark,impl,buffer,param1,param2,unit,median,ci95_low,ci95_high,reps\n");
+    }
+    for (size_t q = 0; q < NUM_QUEUES; q++) {
+        if (impl_selected(&config, queues[q]->name)) {
+            bench_queue(&config, queues[q]);
+        }
+    }
+    if (impl_selected(&config, channel_queue.name)) {
+        bench_channel_only(&config);
+        bench_ring(&config);
+        bench_router(&config);
+        bench_router_workers(&config);
+        bench_router_updates(&config);
+        bench_router_buffers(&config);
+    }
+    bench_apsp(&config);
+    bench_minplus(&config);
+    bench_topology(&config);
+    if (config.json) {
+        printf("\n]\n");
+    }
+    return 0;
+}
@@ -0,0 +1,314 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "bench_baselines.h"
+
+// pipe(2)
+
+typedef struct {
+    int fds[2];
+} pipe_queue_t;
+
+static void* pipe_create(size_t capacity)
+{
+    pipe_queue_t* queue = malloc(sizeof(pipe_queue_t));
+    assert(queue != NULL);
+    int status = pipe(queue->fds);
+    assert(status == 0);
+    (void)status;
+    // best effort: the kernel rounds this up to a page and may refuse sizes above its limit
+    fcntl(queue->fds[1], F_SETPIPE_SZ, (int)(capacity * sizeof(void*)));
+    return queue;
+}
+
+static void pipe_destroy(void* arg)
+{
+    pipe_queue_t* queue = arg;
+    close(queue->fds[0]);
+    close(queue->fds[1]);
+    free(queue);
+}
+
+static void pipe_send(void* arg, void* data)
+{
+    pipe_queue_t* queue = arg;
+    // writes of at most PIPE_BUF bytes are atomic, so concurrent senders never interleave a pointer
+    ssize_t written = write(queue->fds[1], &data, sizeof(data));
+    assert(written == sizeof(data));
+    (void)written;
+}
+
+static void* pipe_receive(void* arg)
+{
+    pipe_queue_t* queue = arg;
+    void* data = NULL;
+    // every write is one whole pointer, so a read never returns part of one
+    ssize_t got = read(queue->fds[0], &data, sizeof(data));
+    assert(got == sizeof(data));
+    (void)got;
+    return data;
+}
+
+const bench_queue_ops_t pipe_queue = {"pipe", pipe_create, pipe_destroy, pipe_send, pipe_receive};
+
+// Ring buffer shared by the eventfd and mutex queues, not thread-safe by itself
+
+typedef struct {
+    void** slots;
+    size_t capacity;
+    size_t head; // next slot to read
+    size_t size; // messages stored
+} ring_t;
+
+static void ring_init(ring_t* ring, size_t capacity)
+{
+    ring->slots = malloc(sizeof(void*) * capacity);
+    assert(ring->slots != NULL);
+    ring->capacity = capacity;
+    ring->head = 0;
+    ring->size = 0;
+}
+
+static void ring_push(ring_t* ring, void* data)
+{
+    ring->slots[(ring->head + ring->size) % ring->capacity] = data;
+    ring->size++;
+}
+
+static void* ring_pop(ring_t* ring)
+{
+    void* data = ring->slots[ring->head];
+    ring->head = (ring->head + 1) % ring->capacity;
+    ring->size--;
+    return data;
+}
+
+// eventfd plus ring
+
+typedef struct {
+    ring_t ring;
+    pthread_mutex_t lock;
+    int free_slots;   // EFD_SEMAPHORE counter of free slots, senders take one
+    int filled_slots; // EFD_SEMAPHORE counter of filled slots, receivers take one
+} eventfd_queue_t;
+
+static void* eventfd_create(size_t capacity)
+{
+    eventfd_queue_t* queue = malloc(sizeof(eventfd_queue_t));
+    assert(queue != NULL);
+    ring_init(&queue->ring, capacity);
+    pthread_mutex_init(&queue->lock, NULL);
+    queue->free_slots = eventfd((unsigned)capacity, EFD_SEMAPHORE);
+    queue->filled_slots = eventfd(0, EFD_SEMAPHORE);
+    assert(queue->free_slots >= 0 && queue->filled_slots >= 0);
+    return queue;
+}
+
+static void eventfd_destroy(void* arg)
+{
+    eventfd_queue_t* queue = arg;
+    close(queue->free_slots);
+    close(queue->filled_slots);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->ring.slots);
+    free(queue);
+}
+
+// Takes one unit from a semaphore eventfd, blocking while it is zero
+static void eventfd_down(int fd)
+{
+    uint64_t value;
+    ssize_t got = read(fd, &value, sizeof(value));
+    assert(got == sizeof(value));
+    (void)got;
+}
+
+static void eventfd_up(int fd)
+{
+    uint64_t value = 1;
+    ssize_t written = write(fd, &value, sizeof(value));
+    assert(written == sizeof(value));
+    (void)written;
+}
+
+static void eventfd_send(void* arg, void* data)
+{
+    eventfd_queue_t* queue = arg;
+    eventfd_down(queue->free_slots);
+    pthread_mutex_lock(&queue->lock);
+    ring_push(&queue->ring, data);
+    pthread_mutex_unlock(&queue->lock);
+    eventfd_up(queue->filled_slots);
+}
+
+static void* eventfd_receive(void* arg)
+{
+    eventfd_queue_t* queue = arg;
+    eventfd_down(queue->filled_slots);
+    pthread_mutex_lock(&queue->lock);
+    void* data = ring_pop(&queue->ring);
+    pthread_mutex_unlock(&queue->lock);
+    eventfd_up(queue->free_slots);
+    return data;
+}
+
+const bench_queue_ops_t eventfd_queue = {"eventfd", eventfd_create, eventfd_destroy, eventfd_send, eventfd_receive};
+
+// mutex and condition variables
+
+typedef struct {
+    ring_t ring;
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+} mutex_queue_t;
+
+static void* mutex_create(size_t capacity)
+{
+    mutex_queue_t* queue = malloc(sizeof(mutex_queue_t));
+    assert(queue != NULL);
+    ring_init(&queue->ring, capacity);
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    return queue;
+}
+
+static void mutex_destroy(void* arg)
+{
+    mutex_queue_t* queue = arg;
+    pthread_cond_destroy(&queue->not_full);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->ring.slots);
+    free(queue);
+}
+
+static void mutex_send(void* arg, void* data)
+{
+    mutex_queue_t* queue = arg;
+    pthread_mutex_lock(&queue->lock);
+    while (queue->ring.size == queue->ring.capacity) {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+    ring_push(&queue->ring, data);
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static void* mutex_receive(void* arg)
+{
+    mutex_queue_t* queue = arg;
+    pthread_mutex_lock(&queue->lock);
+    while (queue->ring.size == 0) {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    }
+    void* data = ring_pop(&queue->ring);
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return data;
+}
+
+const bench_queue_ops_t mutex_queue = {"mutex", mutex_create, mutex_destroy, mutex_send, mutex_receive};
+
+// Vyukov bounded MPMC queue
+// Slot i is free for the sender claiming position p when its sequence equals p, and holds the message for
+// the receiver claiming position p when its sequence equals p + 1
+
+typedef struct {
+    atomic_size_t sequence;
+    void* data;
+} lockfree_slot_t;
+
+typedef struct {
+    lockfree_slot_t* slots;
+    size_t mask;
+    // claimed positions, on separate cache lines so senders and receivers do not false-share
+    _Alignas(64) atomic_size_t tail;
+    _Alignas(64) atomic_size_t head;
+} lockfree_queue_t;
+
+static void* lockfree_create(size_t capacity)
+{
+    // with a single slot "filled for position p" and "free for position p + 1" would be the same sequence
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    lockfree_queue_t* queue = aligned_alloc(64, sizeof(lockfree_queue_t));
+    assert(queue != NULL);
+    queue->slots = malloc(sizeof(lockfree_slot_t) * size);
+    assert(queue->slots != NULL);
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&queue->slots[i].sequence, i);
+    }
+    queue->mask = size - 1;
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->head, 0);
+    return queue;
+}
+
+static void lockfree_destroy(void* arg)
+{
+    lockfree_queue_t* queue = arg;
+    free(queue->slots);
+    free(queue);
+}
+
+static void lockfree_send(void* arg, void* data)
+{
+    lockfree_queue_t* queue = arg;
+    size_t position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    while (true) {
+        lockfree_slot_t* slot = &queue->slots[position & queue->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence == position) {
+            if (atomic_compare_exchange_weak_explicit(&queue->tail, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                slot->data = data;
+                atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+                return;
+            }
+        } else if (sequence < position) {
+            // full: the receiver of the previous lap has not freed this slot yet
+            sched_yield();
+            position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        } else {
+            position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
+    }
+}
+
+static void* lockfree_receive(void* arg)
+{
+    lockfree_queue_t* queue = arg;
+    size_t position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    while (true) {
+        lockfree_slot_t* slot = &queue->slots[position & queue->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence == position + 1) {
+            if (atomic_compare_exchange_weak_explicit(&queue->head, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                void* data = slot->data;
+                atomic_store_explicit(&slot->sequence, position + queue->mask + 1, memory_order_release);
+                return data;
+            }
+        } else if (sequence < position + 1) {
+            // empty: no sender has filled this slot yet
+            sched_yield();
+            position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        } else {
+            position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        }
+    }
+}
+
+const bench_queue_ops_t lockfree_queue = {"lockfree", lockfree_create, lockfree_destroy, lockfree_send, lockfree_receive};
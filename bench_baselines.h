@@ -0,0 +1,22 @@
+#ifndef BENCH_BASELINES_H
+#define BENCH_BASELINES_H
+
+#include "bench_queue.h"
+
+// Simple alternatives to channel_t behind the benchmark queue interface, so every benchmark run shows how
+// channels compare to them on the same machine
+
+// pipe(2) carrying the pointers themselves; the kernel rounds the capacity up to at least one page of pointers
+extern const bench_queue_ops_t pipe_queue;
+
+// Ring buffer under a mutex, with two EFD_SEMAPHORE eventfds counting free and filled slots for blocking
+extern const bench_queue_ops_t eventfd_queue;
+
+// Ring buffer under a mutex with not-full/not-empty condition variables, the textbook bounded queue
+extern const bench_queue_ops_t mutex_queue;
+
+// Vyukov's bounded lock-free MPMC queue (per-slot sequence numbers); it has no way to sleep, so a full or
+// empty queue is waited out with sched_yield; the capacity is rounded up to a power of two, at least 2
+extern const bench_queue_ops_t lockfree_queue;
+
+#endif // BENCH_BASELINES_H
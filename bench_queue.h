@@ -0,0 +1,19 @@
+#ifndef BENCH_QUEUE_H
+#define BENCH_QUEUE_H
+
+#include <stddef.h>
+
+// A bounded blocking FIFO of void* as seen by the benchmarks, so the same workload can run over channel_t
+// and over other queue implementations
+typedef struct {
+    const char* name;
+    // Returns a new queue holding at most capacity messages
+    void* (*create)(size_t capacity);
+    void (*destroy)(void* queue);
+    // Adds data, waiting while the queue is full
+    void (*send)(void* queue, void* data);
+    // Removes and returns the oldest message, waiting while the queue is empty
+    void* (*receive)(void* queue);
+} bench_queue_ops_t;
+
+#endif // BENCH_QUEUE_H
@@ -1,4 +1,155 @@
 #include "channel.h"
+#include "trace.h"
+#include "channel_probes.h"
+#include "channel_registry.h"
+#include "watchdog.h"
+
+static uint64_t channel_clock_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+#if CHANNEL_STATS
+#define CHANNEL_STAT_ADD(channel, field, value) ((channel)->stats.field += (value))
+
+static uint64_t channel_stat_clock(void)
+{
+    return channel_clock_ns();
+}
+
+// adds the time spent blocked since blocked_since (0 if the caller never blocked)
+static void channel_stat_blocked(channel_t* channel, uint64_t blocked_since)
+{
+    if (blocked_since != 0){
+        channel->stats.blocked_ns += channel_stat_clock() - blocked_since;
+    }
+}
+
+static void channel_stat_occupancy(channel_t* channel)
+{
+    size_t occupancy = buffer_current_size(channel->buffer);
+    if (occupancy > channel->stats.peak_occupancy){
+        channel->stats.peak_occupancy = occupancy;
+    }
+}
+#else
+#define CHANNEL_STAT_ADD(channel, field, value) ((void)0)
+static inline uint64_t channel_stat_clock(void) { return 0; }
+static inline void channel_stat_blocked(channel_t* channel, uint64_t blocked_since) {}
+static inline void channel_stat_occupancy(channel_t* channel) {}
+#endif
+#define CHANNEL_STAT_INC(channel, field) CHANNEL_STAT_ADD(channel, field, 1)
+
+#if CHANNEL_LOCK_PROFILE
+#define CHANNEL_LOCK_PROFILE_INC(channel, field) ((channel)->lock_profile.field++)
+
+static uint64_t channel_lock_profile_clock(void)
+{
+    return channel_clock_ns();
+}
+
+// takes channel_lock on behalf of op, timing the wait if the lock is already taken
+static void channel_lock_acquire(channel_t* channel, enum channel_lock_op op)
+{
+    uint64_t wait_ns = 0;
+    bool contended = pthread_mutex_trylock(&channel->channel_lock) != 0;
+    if (contended){
+        uint64_t wait_since = channel_clock_ns();
+        pthread_mutex_lock(&channel->channel_lock);
+        channel->lock_acquired_ns = channel_clock_ns();
+        wait_ns = channel->lock_acquired_ns - wait_since;
+    }
+    else{
+        channel->lock_acquired_ns = channel_clock_ns();
+    }
+    channel_lock_op_profile_t* profile = &channel->lock_profile.ops[op];
+    profile->acquisitions++;
+    profile->contended += contended;
+    profile->wait_ns += wait_ns;
+    if (wait_ns > profile->max_wait_ns){
+        profile->max_wait_ns = wait_ns;
+    }
+}
+
+// charges the time since the lock was (re)acquired to op, still holding the lock
+static void channel_lock_profile_held(channel_t* channel, enum channel_lock_op op)
+{
+    uint64_t hold_ns = channel_clock_ns() - channel->lock_acquired_ns;
+    channel_lock_op_profile_t* profile = &channel->lock_profile.ops[op];
+    profile->hold_ns += hold_ns;
+    if (hold_ns > profile->max_hold_ns){
+        profile->max_hold_ns = hold_ns;
+    }
+}
+
+static void channel_lock_release(channel_t* channel, enum channel_lock_op op)
+{
+    channel_lock_profile_held(channel, op);
+    pthread_mutex_unlock(&channel->channel_lock);
+}
+
+// restarts the hold time after pthread_cond_wait reacquired the lock
+// reacquiring the lock on wakeup is counted as part of the blocked time, not as lock wait time
+static void channel_lock_profile_reacquired(channel_t* channel)
+{
+    channel->lock_acquired_ns = channel_clock_ns();
+}
+
+static void channel_lock_profile_notified(channel_t* channel, uint64_t notify_since)
+{
+    channel->lock_profile.notify_ns += channel_clock_ns() - notify_since;
+}
+#else
+#define CHANNEL_LOCK_PROFILE_INC(channel, field) ((void)0)
+static inline uint64_t channel_lock_profile_clock(void) { return 0; }
+static inline void channel_lock_acquire(channel_t* channel, enum channel_lock_op op) { pthread_mutex_lock(&channel->channel_lock); }
+static inline void channel_lock_release(channel_t* channel, enum channel_lock_op op) { pthread_mutex_unlock(&channel->channel_lock); }
+static inline void channel_lock_profile_held(channel_t* channel, enum channel_lock_op op) {}
+static inline void channel_lock_profile_reacquired(channel_t* channel) {}
+static inline void channel_lock_profile_notified(channel_t* channel, uint64_t notify_since) {}
+#endif
+
+// waits on cond; the lock is not held while sleeping, so the hold time is split around the wait
+static int channel_lock_wait(channel_t* channel, pthread_cond_t* cond, enum channel_lock_op op)
+{
+    size_t* blocked = op == CHANNEL_LOCK_SEND ? &channel->blocked_senders : &channel->blocked_receivers;
+    if (op == CHANNEL_LOCK_SEND){
+        watchdog_block(WATCHDOG_SEND, channel, SEND, channel->last_receiver);
+    }
+    else{
+        watchdog_block(WATCHDOG_RECEIVE, channel, RECV, channel->last_sender);
+    }
+    channel_lock_profile_held(channel, op);
+    trace_op_event(TRACE_BLOCK, channel);
+    CHANNEL_PROBE1(block, channel);
+    (*blocked)++;
+    int status = pthread_cond_wait(cond, &channel->channel_lock);
+    (*blocked)--;
+    CHANNEL_PROBE1(wake, channel);
+    trace_op_event(TRACE_WAKE, channel);
+    channel_lock_profile_reacquired(channel);
+    return status;
+}
+
+// stamps the message that was just added at the tail of the buffer, if latency recording is enabled
+static void channel_latency_enqueued(channel_t* channel, uint64_t now)
+{
+    buffer_t* buffer = channel->buffer;
+    size_t pos = buffer->next + buffer->size - 1;
+    if (pos >= buffer->capacity){
+        pos -= buffer->capacity;
+    }
+    channel->latency->enqueue_ns[pos] = now;
+}
+
+// records the latency of the message about to be removed from the head of the buffer
+static void channel_latency_dequeued(channel_t* channel, uint64_t now)
+{
+    uint64_t enqueued = channel->latency->enqueue_ns[channel->buffer->next];
+    latency_hist_record(&channel->latency->hist, now > enqueued ? now - enqueued : 0);
+}
 
 // Creates a new channel with the provided size and returns it to the caller
 channel_t* channel_create(size_t size)
@@ -24,9 +175,44 @@ channel_t* channel_create(size_t size)
     // initialize the sender, receiver lists;
     new_channel->sel_sends = list_create();
     new_channel->sel_recvs = list_create();
+    new_channel->latency = NULL;
+    new_channel->name[0] = '\0';
+    new_channel->blocked_senders = 0;
+    new_channel->blocked_receivers = 0;
+    new_channel->last_sender = 0;
+    new_channel->last_receiver = 0;
+#if CHANNEL_STATS
+    memset(&new_channel->stats, 0, sizeof(new_channel->stats));
+#endif
+#if CHANNEL_LOCK_PROFILE
+    memset(&new_channel->lock_profile, 0, sizeof(new_channel->lock_profile));
+    new_channel->lock_acquired_ns = 0;
+#endif
+    channel_registry_add(new_channel);
     return new_channel;
 }
 
+// wake up every select that registered itself in the given sel_sends/sel_recvs list
+// assumes the calling process holds the channel lock, so the list cannot change while we walk it
+static void channel_notify_selects(channel_t* channel, list_t* sel_list)
+{
+  list_node_t* head = list_head(sel_list);
+  if (head == NULL){
+    return;
+  }
+  uint64_t notify_since = channel_lock_profile_clock();
+  while (head != NULL){
+    // lock the corresponding select lock pointer
+    pthread_mutex_lock(((sel_sync_t*)head->data)->sel_lock);
+    // signal the thread
+    pthread_cond_signal(((sel_sync_t*)head->data)->sel_cond);
+    pthread_mutex_unlock(((sel_sync_t*)head->data)->sel_lock);
+    CHANNEL_LOCK_PROFILE_INC(channel, notified_selects);
+    head = head->next;
+  }
+  channel_lock_profile_notified(channel, notify_since);
+}
+
 enum channel_status channel_send_core(channel_t *channel, void* data){
   // assume the calling process already holds the lock, and the buffer has adequate size, so just send it
   // and then notify the waiting consumers and send/receiver lists
@@ -34,24 +220,18 @@ enum channel_status channel_send_core(channel_t *channel, void* data){
   if (buffer_add(channel->buffer, data) == BUFFER_ERROR){
     return GENERIC_ERROR;
   }
+  if (channel->latency != NULL){
+    channel_latency_enqueued(channel, channel_clock_ns());
+  }
+  CHANNEL_STAT_INC(channel, sends);
+  channel_stat_occupancy(channel);
+  watchdog_note_peer(&channel->last_sender);
   // signal to a consumer thread to consume data if required
   pthread_cond_signal(&channel->full);       
   // acquire that local lock defined in select
 
   // notify all select receives on this channel
-  size_t num_recvs = list_count(channel->sel_recvs);
-  if (num_recvs != 0){
-    // iterate over the list
-    list_node_t* head = list_head(channel->sel_recvs);
-    while (head != NULL){
-      // lock the corresponding select lock pointer
-      pthread_mutex_lock(((sel_sync_t*)head->data)->sel_lock);
-      // signal the thread
-      pthread_cond_signal(((sel_sync_t*)head->data)->sel_cond);
-      pthread_mutex_unlock(((sel_sync_t*)head->data)->sel_lock);
-      head = head->next;
-    }
-  }
+  channel_notify_selects(channel, channel->sel_recvs);
   return SUCCESS;
 }
 
@@ -59,27 +239,19 @@ enum channel_status channel_receive_core(channel_t *channel, void** data){
   // assume the calling process already holds the lock, and the buffer has > 0 size, so just receive from it
   // and then notify the waiting consumers and send/receiver lists
   // remove from the buffer
+  if (channel->latency != NULL && buffer_current_size(channel->buffer) > 0){
+    channel_latency_dequeued(channel, channel_clock_ns());
+  }
   if (buffer_remove(channel->buffer, data) == BUFFER_ERROR){
-    pthread_mutex_unlock(&channel->channel_lock);
     return GENERIC_ERROR;
   }
+  CHANNEL_STAT_INC(channel, receives);
+  watchdog_note_peer(&channel->last_receiver);
   // signal to a prdoducer thread to produce data if required
   pthread_cond_signal(&channel->empty);
   
   // notify all select sends on this channel
-  size_t num_sends = list_count(channel->sel_sends);
-  if (num_sends != 0){
-    // iterate over the list
-    list_node_t* head = list_head(channel->sel_sends);
-    while (head != NULL){
-      // lock the corresponding select lock pointer
-      pthread_mutex_lock(((sel_sync_t*)head->data)->sel_lock);
-      // signal the thread
-      pthread_cond_signal(((sel_sync_t*)head->data)->sel_cond);
-      pthread_mutex_unlock(((sel_sync_t*)head->data)->sel_lock);
-      head = head->next;
-    }
-  }
+  channel_notify_selects(channel, channel->sel_sends);
   return SUCCESS;
 }
 
@@ -90,33 +262,44 @@ enum channel_status channel_receive_core(channel_t *channel, void** data){
 // Returns SUCCESS for successfully writing data to the channel,
 // CLOSED_ERROR if the channel is closed, and
 // GENERIC_ERROR on encountering any other generic error of any sort
-enum channel_status channel_send(channel_t *channel, void* data)
+static enum channel_status channel_send_impl(channel_t *channel, void* data)
 {
     // acquire lock
-    pthread_mutex_lock(&channel->channel_lock);
+    channel_lock_acquire(channel, CHANNEL_LOCK_SEND);
     // thread woke up now, and guaranteed that buffer is not full, just now check if channel is open, still hold the lock, so no closer thread can close the channel
     if (channel->channel_status == false){
-      pthread_mutex_unlock(&channel->channel_lock);
+      channel_lock_release(channel, CHANNEL_LOCK_SEND);
       return CLOSED_ERROR;
     }
     // see if buffer is not full
     size_t cap = buffer_capacity(channel->buffer);
+    uint64_t blocked_since = 0;
+    if (buffer_current_size(channel->buffer) == cap){
+      CHANNEL_STAT_INC(channel, blocked_sends);
+      blocked_since = channel_stat_clock();
+    }
     while (buffer_current_size(channel->buffer) == cap)
     {
       // wait for a consumer thread
-      if (pthread_cond_wait(&channel->empty, &channel->channel_lock) != 0){
-        pthread_mutex_unlock(&channel->channel_lock);
+      if (channel_lock_wait(channel, &channel->empty, CHANNEL_LOCK_SEND) != 0){
+        channel_lock_release(channel, CHANNEL_LOCK_SEND);
         return GENERIC_ERROR;
       }
+      CHANNEL_STAT_INC(channel, wakeups);
       if (channel->channel_status == false){
-	pthread_mutex_unlock(&channel->channel_lock);
+        channel_stat_blocked(channel, blocked_since);
+	channel_lock_release(channel, CHANNEL_LOCK_SEND);
         return CLOSED_ERROR;
       }
+      if (buffer_current_size(channel->buffer) == cap){
+        CHANNEL_STAT_INC(channel, spurious_wakeups);
+      }
     }
+    channel_stat_blocked(channel, blocked_since);
     
     enum channel_status stat = channel_send_core(channel, data);
     // unlock the channel_lock
-    pthread_mutex_unlock(&channel->channel_lock);
+    channel_lock_release(channel, CHANNEL_LOCK_SEND);
     return stat;
 }
 // Reads data from the given channel and stores it in the function's input parameter, data (Note that it is a double pointer)
@@ -125,33 +308,44 @@ enum channel_status channel_send(channel_t *channel, void* data)
 // Returns SUCCESS for successful retrieval of data,
 // CLOSED_ERROR if the channel is closed, and
 // GENERIC_ERROR on encountering any other generic error of any sort
-enum channel_status channel_receive(channel_t* channel, void** data)
+static enum channel_status channel_receive_impl(channel_t* channel, void** data)
 {
     // acquire lock
-    pthread_mutex_lock(&channel->channel_lock);
+    channel_lock_acquire(channel, CHANNEL_LOCK_RECEIVE);
     // thread woke up now, and guaranteed that buffer is not empty, just now check if channel is open, still hold the lock, so no closer thread can close the channel
     if (channel->channel_status == false){
-      pthread_mutex_unlock(&channel->channel_lock);
+      channel_lock_release(channel, CHANNEL_LOCK_RECEIVE);
       return CLOSED_ERROR;
     }
 
     // see if buffer is not empty
+    uint64_t blocked_since = 0;
+    if (buffer_current_size(channel->buffer) == 0){
+      CHANNEL_STAT_INC(channel, blocked_receives);
+      blocked_since = channel_stat_clock();
+    }
     while (buffer_current_size(channel->buffer) == 0)
     {
       // wait for a producer thread
-      if (pthread_cond_wait(&channel->full, &channel->channel_lock) != 0){
-        pthread_mutex_unlock(&channel->channel_lock);
+      if (channel_lock_wait(channel, &channel->full, CHANNEL_LOCK_RECEIVE) != 0){
+        channel_lock_release(channel, CHANNEL_LOCK_RECEIVE);
         return GENERIC_ERROR;
       }
+      CHANNEL_STAT_INC(channel, wakeups);
         // thread woke up now, and guaranteed that buffer is not empty, just now check if channel is open, still hold the lock, so no closer thread can close the channel
       if (channel->channel_status == false){
-        pthread_mutex_unlock(&channel->channel_lock);
+        channel_stat_blocked(channel, blocked_since);
+        channel_lock_release(channel, CHANNEL_LOCK_RECEIVE);
         return CLOSED_ERROR;
       }
+      if (buffer_current_size(channel->buffer) == 0){
+        CHANNEL_STAT_INC(channel, spurious_wakeups);
+      }
     }
+    channel_stat_blocked(channel, blocked_since);
     enum channel_status stat = channel_receive_core(channel, data);
     // unlock the channel_lock
-    pthread_mutex_unlock(&channel->channel_lock);
+    channel_lock_release(channel, CHANNEL_LOCK_RECEIVE);
     return stat;
 }
 
@@ -162,20 +356,20 @@ enum channel_status channel_receive(channel_t* channel, void** data)
 // CHANNEL_FULL if the channel is full and the data was not added to the buffer,
 // CLOSED_ERROR if the channel is closed, and
 // GENERIC_ERROR on encountering any other generic error of any sort
-enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
+static enum channel_status channel_non_blocking_send_impl(channel_t* channel, void* data)
 {
     // first detect if the buffer is full, acquire lock first
-    pthread_mutex_lock(&channel->channel_lock);
+    channel_lock_acquire(channel, CHANNEL_LOCK_SEND);
     
     // check if channel is not closed
     if (channel->channel_status == false){
-        pthread_mutex_unlock(&channel->channel_lock);
+        channel_lock_release(channel, CHANNEL_LOCK_SEND);
         return CLOSED_ERROR;
     }
     size_t cap = buffer_capacity(channel->buffer);
     if (buffer_current_size(channel->buffer) == cap){
         // buffer is now full, release the lock first, and then return CHANNEL_FULL status
-        pthread_mutex_unlock(&channel->channel_lock);
+        channel_lock_release(channel, CHANNEL_LOCK_SEND);
         return CHANNEL_FULL;
     }
     // if channel is not full, blocking send should work
@@ -183,7 +377,7 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
     // do things like adding to buffer and notifying threads only
     enum channel_status stat = channel_send_core(channel, data);
     // release the lock on the buffer
-    pthread_mutex_unlock(&channel->channel_lock);
+    channel_lock_release(channel, CHANNEL_LOCK_SEND);
     return stat;
 }
 
@@ -193,28 +387,155 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
 // CHANNEL_EMPTY if the channel is empty and nothing was stored in data,
 // CLOSED_ERROR if the channel is closed, and
 // GENERIC_ERROR on encountering any other generic error of any sort
-enum channel_status channel_non_blocking_receive(channel_t* channel, void** data)
+static enum channel_status channel_non_blocking_receive_impl(channel_t* channel, void** data)
 {
     // first detect if the buffer is empty, acquire lock first
-    pthread_mutex_lock(&channel->channel_lock);
+    channel_lock_acquire(channel, CHANNEL_LOCK_RECEIVE);
     
     // check if channel is not closed
     if (channel->channel_status == false){
-        pthread_mutex_unlock(&channel->channel_lock);
+        channel_lock_release(channel, CHANNEL_LOCK_RECEIVE);
         return CLOSED_ERROR;
     }
     if (buffer_current_size(channel->buffer) == 0){
         // buffer is now empty, release the lock first, and then return CHANNEL_EMPTY status
-        pthread_mutex_unlock(&channel->channel_lock);
+        channel_lock_release(channel, CHANNEL_LOCK_RECEIVE);
         return CHANNEL_EMPTY;
     }
     // if channel is not empty, blocking receive should work
     enum channel_status stat = channel_receive_core(channel, data);
     // release the lock on the buffer
-    pthread_mutex_unlock(&channel->channel_lock);
+    channel_lock_release(channel, CHANNEL_LOCK_RECEIVE);
     return stat;
 }
 
+// Writes count messages from data to the given channel, in order
+// This is a blocking call i.e., the function waits for space whenever the channel is full
+// Messages are added under a single lock acquisition for as long as the buffer has room, so a batch costs
+// one wakeup of the consumers instead of one per message
+// The number of messages that made it into the channel is stored in sent
+// Returns SUCCESS once all messages have been written,
+// CLOSED_ERROR if the channel is closed (sent tells how many messages were written before that), and
+// GENERIC_ERROR on encountering any other generic error of any sort
+static enum channel_status channel_send_batch_impl(channel_t* channel, void** data, size_t count, size_t* sent)
+{
+    *sent = 0;
+    // acquire lock
+    channel_lock_acquire(channel, CHANNEL_LOCK_SEND);
+    size_t cap = buffer_capacity(channel->buffer);
+    while (*sent < count)
+    {
+        if (channel->channel_status == false){
+            channel_lock_release(channel, CHANNEL_LOCK_SEND);
+            return CLOSED_ERROR;
+        }
+        if (buffer_current_size(channel->buffer) == cap){
+            // wait for a consumer thread
+            CHANNEL_STAT_INC(channel, blocked_sends);
+            uint64_t blocked_since = channel_stat_clock();
+            if (channel_lock_wait(channel, &channel->empty, CHANNEL_LOCK_SEND) != 0){
+                channel_lock_release(channel, CHANNEL_LOCK_SEND);
+                return GENERIC_ERROR;
+            }
+            CHANNEL_STAT_INC(channel, wakeups);
+            channel_stat_blocked(channel, blocked_since);
+            if (channel->channel_status == true && buffer_current_size(channel->buffer) == cap){
+                CHANNEL_STAT_INC(channel, spurious_wakeups);
+            }
+            continue;
+        }
+        // fill the buffer with as much of the batch as fits
+        size_t added = 0;
+        uint64_t now = channel->latency != NULL ? channel_clock_ns() : 0;
+        while (*sent < count && buffer_add(channel->buffer, data[*sent]) == BUFFER_SUCCESS){
+            if (channel->latency != NULL){
+                channel_latency_enqueued(channel, now);
+            }
+            (*sent)++;
+            added++;
+        }
+        CHANNEL_STAT_ADD(channel, sends, added);
+        channel_stat_occupancy(channel);
+        watchdog_note_peer(&channel->last_sender);
+        // wake as many consumers as there are new messages
+        if (added > 1){
+            pthread_cond_broadcast(&channel->full);
+        }
+        else{
+            pthread_cond_signal(&channel->full);
+        }
+        channel_notify_selects(channel, channel->sel_recvs);
+    }
+    channel_lock_release(channel, CHANNEL_LOCK_SEND);
+    return SUCCESS;
+}
+
+// Reads up to max_count messages from the given channel into data, in FIFO order
+// This is a blocking call i.e., the function waits till the channel has at least one message to read,
+// then takes whatever else is already buffered (up to max_count) under the same lock acquisition
+// The number of messages read is stored in count
+// Returns SUCCESS for successful retrieval of at least one message,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort (including max_count == 0)
+static enum channel_status channel_receive_batch_impl(channel_t* channel, void** data, size_t max_count, size_t* count)
+{
+    *count = 0;
+    if (max_count == 0){
+        return GENERIC_ERROR;
+    }
+    // acquire lock
+    channel_lock_acquire(channel, CHANNEL_LOCK_RECEIVE);
+    if (channel->channel_status == false){
+        channel_lock_release(channel, CHANNEL_LOCK_RECEIVE);
+        return CLOSED_ERROR;
+    }
+    // see if buffer is not empty
+    uint64_t blocked_since = 0;
+    if (buffer_current_size(channel->buffer) == 0){
+        CHANNEL_STAT_INC(channel, blocked_receives);
+        blocked_since = channel_stat_clock();
+    }
+    while (buffer_current_size(channel->buffer) == 0)
+    {
+        // wait for a producer thread
+        if (channel_lock_wait(channel, &channel->full, CHANNEL_LOCK_RECEIVE) != 0){
+            channel_lock_release(channel, CHANNEL_LOCK_RECEIVE);
+            return GENERIC_ERROR;
+        }
+        CHANNEL_STAT_INC(channel, wakeups);
+        if (channel->channel_status == false){
+            channel_stat_blocked(channel, blocked_since);
+            channel_lock_release(channel, CHANNEL_LOCK_RECEIVE);
+            return CLOSED_ERROR;
+        }
+        if (buffer_current_size(channel->buffer) == 0){
+            CHANNEL_STAT_INC(channel, spurious_wakeups);
+        }
+    }
+    channel_stat_blocked(channel, blocked_since);
+    // drain as much of the buffer as the caller has room for
+    uint64_t now = channel->latency != NULL ? channel_clock_ns() : 0;
+    while (*count < max_count && buffer_current_size(channel->buffer) > 0){
+        if (channel->latency != NULL){
+            channel_latency_dequeued(channel, now);
+        }
+        buffer_remove(channel->buffer, &data[*count]);
+        (*count)++;
+    }
+    CHANNEL_STAT_ADD(channel, receives, *count);
+    watchdog_note_peer(&channel->last_receiver);
+    // wake as many producers as there are free slots
+    if (*count > 1){
+        pthread_cond_broadcast(&channel->empty);
+    }
+    else{
+        pthread_cond_signal(&channel->empty);
+    }
+    channel_notify_selects(channel, channel->sel_sends);
+    channel_lock_release(channel, CHANNEL_LOCK_RECEIVE);
+    return SUCCESS;
+}
+
 // Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
 // Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
 // Returns SUCCESS if close is successful,
@@ -224,47 +545,24 @@ enum channel_status channel_close(channel_t* channel)
 {
     // try to acquire the status lock first
     // acquire the channel lock first
-    pthread_mutex_lock(&channel->channel_lock);
+    channel_lock_acquire(channel, CHANNEL_LOCK_CLOSE);
     //update the status to closed
     if (channel->channel_status == false){
-        pthread_mutex_unlock(&channel->channel_lock);
+        channel_lock_release(channel, CHANNEL_LOCK_CLOSE);
         return CLOSED_ERROR;
     }
     else{
         channel->channel_status = false;
+        trace_op_instant(TRACE_CLOSE, channel);
+        CHANNEL_PROBE1(close, channel);
         // need to wake up all threads (senders and receivers)
         pthread_cond_broadcast(&channel->full);
         pthread_cond_broadcast(&channel->empty);
         
         // notify all sender and receiver threads on this channel
-        size_t num_recvs = list_count(channel->sel_recvs);
-	    if (num_recvs != 0){
-	      // iterate over the list
-	      list_node_t* head = list_head(channel->sel_recvs);
-	      while (head != NULL){
-		// lock the corresponding select lock pointer
-		pthread_mutex_lock(((sel_sync_t*)head->data)->sel_lock);
-		// signal the thread
-		pthread_cond_signal(((sel_sync_t*)head->data)->sel_cond);
-		pthread_mutex_unlock(((sel_sync_t*)head->data)->sel_lock);
-		head = head->next;
-	      }
-	    }
-	
-	size_t num_sends = list_count(channel->sel_sends);
-	    if (num_sends != 0){
-	      // iterate over the list
-	      list_node_t* head = list_head(channel->sel_sends);
-	      while (head != NULL){
-		// lock the corresponding select lock pointer
-		pthread_mutex_lock(((sel_sync_t*)head->data)->sel_lock);
-		// signal the thread
-		pthread_cond_signal(((sel_sync_t*)head->data)->sel_cond);
-		pthread_mutex_unlock(((sel_sync_t*)head->data)->sel_lock);
-		head = head->next;
-	      }
-	    }    
-        pthread_mutex_unlock(&channel->channel_lock);
+        channel_notify_selects(channel, channel->sel_recvs);
+        channel_notify_selects(channel, channel->sel_sends);
+        channel_lock_release(channel, CHANNEL_LOCK_CLOSE);
         
         //if (channel->select_lock != NULL){
 	//	pthread_mutex_lock(channel->select_lock);
@@ -283,16 +581,23 @@ enum channel_status channel_close(channel_t* channel)
 enum channel_status channel_destroy(channel_t* channel)
 {
     
-    pthread_mutex_lock(&channel->channel_lock);
+    channel_lock_acquire(channel, CHANNEL_LOCK_OTHER);
     // check if channel is open
     if (channel->channel_status == true)
     {
-        pthread_mutex_unlock(&channel->channel_lock);
+        channel_lock_release(channel, CHANNEL_LOCK_OTHER);
         return DESTROY_ERROR;
     }
+    channel_lock_release(channel, CHANNEL_LOCK_OTHER);
+    // registry dumps lock the channel while holding the registry lock, so once the channel is out of the
+    // registry nothing else can reach it and it can be freed without holding its lock
+    channel_registry_remove(channel);
     // free the buffer and the channel
     buffer_free(channel->buffer);
-    pthread_mutex_unlock(&channel->channel_lock);
+    if (channel->latency != NULL){
+        free(channel->latency->enqueue_ns);
+        free(channel->latency);
+    }
     // free the lists
     list_destroy(channel->sel_sends);
     list_destroy(channel->sel_recvs);
@@ -301,6 +606,22 @@ enum channel_status channel_destroy(channel_t* channel)
     return SUCCESS;
 }
 
+// Orders channels by address for select's lock ordering
+static int channel_address_compare(const void* a, const void* b)
+{
+    uintptr_t left = (uintptr_t)*(channel_t* const*)a;
+    uintptr_t right = (uintptr_t)*(channel_t* const*)b;
+    return (left > right) - (left < right);
+}
+
+// Releases the select locks of the distinct channels taken by channel_select_locked
+static void select_unlock_all(channel_t** ordered, size_t num_ordered)
+{
+    for (size_t i = 0; i < num_ordered; i++){
+        channel_lock_release(ordered[i], CHANNEL_LOCK_SELECT);
+    }
+}
+
 // Takes an array of channels (channel_list) of type select_t and the array length (channel_count) as inputs
 // This API iterates over the provided list and finds the set of possible channels which can be used to invoke the required operation (send or receive) specified in select_t
 // If multiple options are available, it selects the first option and performs its corresponding action
@@ -308,7 +629,8 @@ enum channel_status channel_destroy(channel_t* channel)
 // Once an operation has been successfully performed, select should set selected_index to the index of the channel that performed the operation and then return SUCCESS
 // In the event that a channel is closed or encounters any error, the error should be propagated and returned through select
 // Additionally, selected_index is set to the index of the channel that generated the error
-enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index)
+static enum channel_status channel_select_locked(select_t* channel_list, size_t channel_count, size_t* selected_index,
+                                                 channel_t** ordered, size_t num_ordered)
 {
     /* IMPLEMENT THIS */
     // check status of thread A
@@ -326,18 +648,10 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
 
     while (true){
       // try to lock all channels first, so that the status doesn't change
-      for (size_t i = 0; i < channel_count; i++)
+      // locks are taken in address order so that concurrent selects over overlapping channels cannot deadlock
+      for (size_t i = 0; i < num_ordered; i++)
       {
-          // should only lock if channel[i] is not duplicate
-          bool dup = false;
-          for(size_t j = 0; j < i; j++){
-              if (channel_list[j].channel == channel_list[i].channel){
-                dup = true;
-                break;
-              }
-          }
-          if (dup == false)
-          	pthread_mutex_lock(&(channel_list[i].channel->channel_lock));  
+          channel_lock_acquire(ordered[i], CHANNEL_LOCK_SELECT);
       }
       // remove this lock from all the channel (sender/receiver lists)
       for (size_t i = 0; i < channel_count; i++){
@@ -346,12 +660,14 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
         	list_node_t* node = list_find(channel_list[i].channel->sel_sends, &sel_sync);
         	if (node != NULL){
            		list_remove(channel_list[i].channel->sel_sends, node);
+           		trace_op_event(TRACE_SELECT_UNREGISTER, channel_list[i].channel);
         	}
         }
         else{
         	list_node_t* node = list_find(channel_list[i].channel->sel_recvs, &sel_sync);
             	if (node != NULL){
               		list_remove(channel_list[i].channel->sel_recvs, node);
+              		trace_op_event(TRACE_SELECT_UNREGISTER, channel_list[i].channel);
             	}
         }
       }
@@ -366,20 +682,9 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
           // check if the channel is closed first
           if (channel->channel_status == false){
           	// channel is closed, so release all the locks and return with closed error
+          	*selected_index = i;
           	// unlock all channels before making the call
-	        for (size_t i = 0; i < channel_count; i++)
-	        {
-	        // should only unlock if channel[i] is not duplicate
-	          bool dup = false;
-	          for(size_t j = 0; j < i; j++){
-	            if (channel_list[j].channel == channel_list[i].channel){
-	              dup = true;
-	              break;
-	            }
-	          }
-	          if (dup == false)
-	            pthread_mutex_unlock(&(channel_list[i].channel->channel_lock));
-	        }
+	        select_unlock_all(ordered, num_ordered);
 	    // return
 	    return CLOSED_ERROR;
             }
@@ -394,19 +699,7 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
               // set the selected_index to point to this channel
               *selected_index = i;
               // unlock all channels before making the call
-              for (size_t i = 0; i < channel_count; i++)
-              {
-              // should only unlock if channel[i] is not duplicate
-                bool dup = false;
-                for(size_t j = 0; j < i; j++){
-                  if (channel_list[j].channel == channel_list[i].channel){
-                    dup = true;
-                    break;
-                  }
-                }
-                if (dup == false)
-                  pthread_mutex_unlock(&(channel_list[i].channel->channel_lock));
-              }
+              select_unlock_all(ordered, num_ordered);
               return stat;
             }
           }
@@ -414,20 +707,9 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
             // check if the channel is closed first
             if (channel->channel_status == false){
             	// channel is closed, so release all the locks and return with closed error
+            	*selected_index = i;
             	// unlock all channels before making the call
-	          for (size_t i = 0; i < channel_count; i++)
-	          {
-	          // should only unlock if channel[i] is not duplicate
-	            bool dup = false;
-	            for(size_t j = 0; j < i; j++){
-	              if (channel_list[j].channel == channel_list[i].channel){
-	                dup = true;
-	                break;
-	              }
-	            }
-	            if (dup == false)
-	              pthread_mutex_unlock(&(channel_list[i].channel->channel_lock));
-	          }
+	          select_unlock_all(ordered, num_ordered);
 	      // return
 	      return CLOSED_ERROR;
             }
@@ -441,19 +723,7 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
               enum channel_status stat = channel_receive_core(channel, &channel_list[i].data);
               *selected_index = i;
               // unlock all channels before making the receive call
-              for (size_t i = 0; i < channel_count; i++)
-              {
-                // should only lock if channel[i] is not duplicate
-                bool dup = false;
-                for(size_t j = 0; j < i; j++){
-                  if (channel_list[j].channel == channel_list[i].channel){
-                    dup = true;
-                    break;
-                  }
-                }
-                if (dup == false)
-                  pthread_mutex_unlock(&(channel_list[i].channel->channel_lock));
-              }
+              select_unlock_all(ordered, num_ordered);
               return stat;
             }
           }
@@ -463,6 +733,9 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
         // let all the channels' accessors know that this select is sleeping, before going to sleep
         // acquire the local lock and assign the lock/condition variable to all channels
         pthread_mutex_lock(&local_lock);
+        if (atomic_load_explicit(&watchdog_active, memory_order_relaxed)){
+          watchdog_wait_begin(WATCHDOG_SELECT);
+        }
         // should insert only if non duplicate (same channel and same operation not allowed more than once)
         for (size_t i = 0; i < channel_count; i++){
           // still have the channel lock
@@ -477,24 +750,250 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
           }
           if (dup == false && channel_list[i].dir == SEND){
             list_insert(channel_list[i].channel->sel_sends, &sel_sync);
+            if (watchdog_waiting){
+              watchdog_wait_channel(channel_list[i].channel, SEND, channel_list[i].channel->last_receiver);
+            }
+            trace_op_event(TRACE_SELECT_REGISTER, channel_list[i].channel);
+            CHANNEL_STAT_INC(channel_list[i].channel, select_registrations);
           }
           else if (dup == false && channel_list[i].dir == RECV){
             list_insert(channel_list[i].channel->sel_recvs, &sel_sync);
-          }
-          // release the channel lock
-          // should only lock if channel[i] is not duplicate
-          dup = false;
-          for(size_t j = 0; j < i; j++){
-            if (channel_list[j].channel == channel_list[i].channel){
-              dup = true;
-              break;
+            if (watchdog_waiting){
+              watchdog_wait_channel(channel_list[i].channel, RECV, channel_list[i].channel->last_sender);
             }
+            trace_op_event(TRACE_SELECT_REGISTER, channel_list[i].channel);
+            CHANNEL_STAT_INC(channel_list[i].channel, select_registrations);
           }
-          if (dup == false)
-            pthread_mutex_unlock(&(channel_list[i].channel->channel_lock));
         }
+        // release the channel locks only once every registration is in, duplicates included
+        select_unlock_all(ordered, num_ordered);
+        trace_op_event(TRACE_BLOCK, NULL);
+        CHANNEL_PROBE1(block, NULL);
         pthread_cond_wait(&local_cond, &local_lock);
+        CHANNEL_PROBE1(wake, NULL);
+        trace_op_event(TRACE_WAKE, NULL);
         pthread_mutex_unlock(&local_lock);
       }
     return SUCCESS;
 }
+
+// Selects over up to this many channels sort them on the stack, larger ones allocate the sorted copy
+#define SELECT_STACK_CHANNELS 16
+
+static enum channel_status channel_select_impl(select_t* channel_list, size_t channel_count, size_t* selected_index)
+{
+    // nothing could ever be selected
+    if (channel_count == 0){
+        return GENERIC_ERROR;
+    }
+    // collect the distinct channels sorted by address, duplicates are only locked once
+    channel_t* stack_ordered[SELECT_STACK_CHANNELS];
+    channel_t** ordered = stack_ordered;
+    if (channel_count > SELECT_STACK_CHANNELS){
+        ordered = malloc(sizeof(channel_t*) * channel_count);
+        if (ordered == NULL){
+            return GENERIC_ERROR;
+        }
+    }
+    for (size_t i = 0; i < channel_count; i++){
+        ordered[i] = channel_list[i].channel;
+    }
+    qsort(ordered, channel_count, sizeof(channel_t*), channel_address_compare);
+    size_t num_ordered = 0;
+    for (size_t i = 0; i < channel_count; i++){
+        if (num_ordered == 0 || ordered[num_ordered - 1] != ordered[i]){
+            ordered[num_ordered++] = ordered[i];
+        }
+    }
+    enum channel_status stat = channel_select_locked(channel_list, channel_count, selected_index, ordered, num_ordered);
+    if (ordered != stack_ordered){
+        free(ordered);
+    }
+    return stat;
+}
+
+// Public entry points: each operation is traced as one begin/end pair around its implementation above
+enum channel_status channel_send(channel_t* channel, void* data)
+{
+    CHANNEL_PROBE2(send_entry, channel, data);
+    trace_op_begin(TRACE_SEND_BEGIN, channel);
+    enum channel_status stat = channel_send_impl(channel, data);
+    watchdog_done();
+    trace_op_end(TRACE_SEND_END, channel, stat);
+    CHANNEL_PROBE2(send_return, channel, (int)stat);
+    return stat;
+}
+
+enum channel_status channel_receive(channel_t* channel, void** data)
+{
+    CHANNEL_PROBE1(receive_entry, channel);
+    trace_op_begin(TRACE_RECV_BEGIN, channel);
+    enum channel_status stat = channel_receive_impl(channel, data);
+    watchdog_done();
+    trace_op_end(TRACE_RECV_END, channel, stat);
+    CHANNEL_PROBE3(receive_return, channel, (int)stat, stat == SUCCESS ? *data : NULL);
+    return stat;
+}
+
+enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
+{
+    CHANNEL_PROBE2(send_entry, channel, data);
+    trace_op_begin(TRACE_SEND_BEGIN, channel);
+    enum channel_status stat = channel_non_blocking_send_impl(channel, data);
+    trace_op_end(TRACE_SEND_END, channel, stat);
+    CHANNEL_PROBE2(send_return, channel, (int)stat);
+    return stat;
+}
+
+enum channel_status channel_non_blocking_receive(channel_t* channel, void** data)
+{
+    CHANNEL_PROBE1(receive_entry, channel);
+    trace_op_begin(TRACE_RECV_BEGIN, channel);
+    enum channel_status stat = channel_non_blocking_receive_impl(channel, data);
+    trace_op_end(TRACE_RECV_END, channel, stat);
+    CHANNEL_PROBE3(receive_return, channel, (int)stat, stat == SUCCESS ? *data : NULL);
+    return stat;
+}
+
+enum channel_status channel_send_batch(channel_t* channel, void** data, size_t count, size_t* sent)
+{
+    CHANNEL_PROBE2(send_batch_entry, channel, count);
+    trace_op_begin(TRACE_SEND_BEGIN, channel);
+    enum channel_status stat = channel_send_batch_impl(channel, data, count, sent);
+    watchdog_done();
+    trace_op_end(TRACE_SEND_END, channel, stat);
+    CHANNEL_PROBE3(send_batch_return, channel, (int)stat, *sent);
+    return stat;
+}
+
+enum channel_status channel_receive_batch(channel_t* channel, void** data, size_t max_count, size_t* count)
+{
+    CHANNEL_PROBE2(receive_batch_entry, channel, max_count);
+    trace_op_begin(TRACE_RECV_BEGIN, channel);
+    enum channel_status stat = channel_receive_batch_impl(channel, data, max_count, count);
+    watchdog_done();
+    trace_op_end(TRACE_RECV_END, channel, stat);
+    CHANNEL_PROBE3(receive_batch_return, channel, (int)stat, *count);
+    return stat;
+}
+
+enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index)
+{
+    CHANNEL_PROBE2(select_entry, channel_list, channel_count);
+    trace_op_begin(TRACE_SELECT_BEGIN, NULL);
+    enum channel_status stat = channel_select_impl(channel_list, channel_count, selected_index);
+    watchdog_done();
+    trace_op_end(TRACE_SELECT_END, channel_count > 0 && stat != GENERIC_ERROR ? channel_list[*selected_index].channel : NULL, stat);
+    CHANNEL_PROBE2(select_return, (int)stat, stat != GENERIC_ERROR ? *selected_index : channel_count);
+    return stat;
+}
+
+// Labels the channel for registry dumps and other diagnostics, truncated to CHANNEL_NAME_MAX - 1 characters
+void channel_set_name(channel_t* channel, const char* name)
+{
+    channel_lock_acquire(channel, CHANNEL_LOCK_OTHER);
+    snprintf(channel->name, sizeof(channel->name), "%s", name);
+    channel_lock_release(channel, CHANNEL_LOCK_OTHER);
+}
+
+// Copies the statistics counters of the channel into stats
+// Returns SUCCESS on success and
+// GENERIC_ERROR if the counters were compiled out (stats is zeroed apart from occupancy in that case)
+enum channel_status channel_get_stats(channel_t* channel, channel_stats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    channel_lock_acquire(channel, CHANNEL_LOCK_OTHER);
+#if CHANNEL_STATS
+    *stats = channel->stats;
+#endif
+    // occupancy is read from the buffer, so it is there even without the counters
+    stats->occupancy = buffer_current_size(channel->buffer);
+    channel_lock_release(channel, CHANNEL_LOCK_OTHER);
+    return CHANNEL_STATS ? SUCCESS : GENERIC_ERROR;
+}
+
+// Starts recording the enqueue to dequeue latency of every message passing through the channel
+// Messages already buffered when recording starts are measured from the time of this call
+// Returns SUCCESS if recording is enabled (or already was) and
+// GENERIC_ERROR if the recording state could not be allocated
+enum channel_status channel_latency_enable(channel_t* channel)
+{
+    size_t capacity = buffer_capacity(channel->buffer);
+    channel_latency_t* latency = malloc(sizeof(channel_latency_t));
+    uint64_t* enqueue_ns = malloc(sizeof(uint64_t) * (capacity > 0 ? capacity : 1));
+    if (latency == NULL || enqueue_ns == NULL){
+        free(latency);
+        free(enqueue_ns);
+        return GENERIC_ERROR;
+    }
+    latency->enqueue_ns = enqueue_ns;
+    latency_hist_init(&latency->hist);
+    channel_lock_acquire(channel, CHANNEL_LOCK_OTHER);
+    if (channel->latency != NULL){
+        // somebody else enabled it first
+        channel_lock_release(channel, CHANNEL_LOCK_OTHER);
+        free(enqueue_ns);
+        free(latency);
+        return SUCCESS;
+    }
+    uint64_t now = channel_clock_ns();
+    for (size_t i = 0; i < capacity; i++){
+        enqueue_ns[i] = now;
+    }
+    channel->latency = latency;
+    channel_lock_release(channel, CHANNEL_LOCK_OTHER);
+    return SUCCESS;
+}
+
+// Copies the latency histogram of the channel into hist
+// Returns SUCCESS on success and
+// GENERIC_ERROR if latency recording is not enabled on the channel (hist is emptied in that case)
+enum channel_status channel_get_latency(channel_t* channel, latency_hist_t* hist)
+{
+    channel_lock_acquire(channel, CHANNEL_LOCK_OTHER);
+    if (channel->latency == NULL){
+        channel_lock_release(channel, CHANNEL_LOCK_OTHER);
+        latency_hist_init(hist);
+        return GENERIC_ERROR;
+    }
+    *hist = channel->latency->hist;
+    channel_lock_release(channel, CHANNEL_LOCK_OTHER);
+    return SUCCESS;
+}
+
+// Copies the lock profile of the channel into profile
+// Returns SUCCESS on success and
+// GENERIC_ERROR if lock profiling was compiled out (profile is zeroed in that case)
+enum channel_status channel_get_lock_profile(channel_t* channel, channel_lock_profile_t* profile)
+{
+    memset(profile, 0, sizeof(*profile));
+#if CHANNEL_LOCK_PROFILE
+    channel_lock_acquire(channel, CHANNEL_LOCK_OTHER);
+    *profile = channel->lock_profile;
+    channel_lock_release(channel, CHANNEL_LOCK_OTHER);
+    return SUCCESS;
+#else
+    (void)channel;
+    return GENERIC_ERROR;
+#endif
+}
+
+// Prints one line per operation type with acquisitions, contention and wait/hold times, prefixed by label
+void channel_lock_profile_print(FILE* file, const char* label, const channel_lock_profile_t* profile)
+{
+    // an array of arrays lives in read-only data, so channel.o keeps no writable globals
+    static const char op_names[CHANNEL_LOCK_OP_COUNT][8] = {"send", "receive", "select", "close", "other"};
+    for (size_t op = 0; op < CHANNEL_LOCK_OP_COUNT; op++){
+        const channel_lock_op_profile_t* p = &profile->ops[op];
+        if (p->acquisitions == 0){
+            continue;
+        }
+        fprintf(file, "%s %s: acquisitions=%llu contended=%llu wait=%lluns (max %lluns) hold=%lluns (max %lluns)\n",
+                label, op_names[op],
+                (unsigned long long)p->acquisitions, (unsigned long long)p->contended,
+                (unsigned long long)p->wait_ns, (unsigned long long)p->max_wait_ns,
+                (unsigned long long)p->hold_ns, (unsigned long long)p->max_hold_ns);
+    }
+    fprintf(file, "%s notify: selects=%llu time=%lluns\n", label,
+            (unsigned long long)profile->notified_selects, (unsigned long long)profile->notify_ns);
+}
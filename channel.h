@@ -9,7 +9,25 @@
 #include <stddef.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 #include "linked_list.h"
+#include "latency_hist.h"
+
+// Per-channel statistics counters, on by default
+// Build with -DCHANNEL_STATS=0 to compile them out of channel_t and the hot paths entirely
+#ifndef CHANNEL_STATS
+#define CHANNEL_STATS 1
+#endif
+
+// Lock contention profiling, off by default since it reads the clock on every lock acquisition and release
+// Build with -DCHANNEL_LOCK_PROFILE=1 to time how long threads wait for and hold channel_lock
+#ifndef CHANNEL_LOCK_PROFILE
+#define CHANNEL_LOCK_PROFILE 0
+#endif
+
+// Longest channel name kept by channel_set_name, including the terminating NUL
+#define CHANNEL_NAME_MAX 32
 
 // Defines possible return values from channel functions
 enum channel_status {
@@ -22,6 +40,52 @@ enum channel_status {
     DESTROY_ERROR = -3  // Error during destroy
 };
 
+// Statistics kept per channel, all updated under channel_lock
+typedef struct {
+    uint64_t sends;                // messages added to the buffer
+    uint64_t receives;             // messages removed from the buffer
+    uint64_t blocked_sends;        // times a sender had to wait for space
+    uint64_t blocked_receives;     // times a receiver had to wait for a message
+    uint64_t blocked_ns;           // total time senders and receivers spent waiting
+    uint64_t wakeups;              // returns from waiting on the channel's condition variables
+    uint64_t spurious_wakeups;     // wakeups after which the waited-for condition was still false
+    uint64_t select_registrations; // times a blocking select registered itself on the channel
+    size_t peak_occupancy;         // largest number of messages buffered at once
+    size_t occupancy;              // number of messages buffered when the snapshot was taken
+} channel_stats_t;
+
+// Operation a channel_lock acquisition is made for, so lock times can be attributed
+enum channel_lock_op {
+    CHANNEL_LOCK_SEND,    // blocking, non-blocking and batch sends
+    CHANNEL_LOCK_RECEIVE, // blocking, non-blocking and batch receives
+    CHANNEL_LOCK_SELECT,  // channel_select scanning, registering and completing on the channel
+    CHANNEL_LOCK_CLOSE,   // channel_close
+    CHANNEL_LOCK_OTHER,   // destroy and the introspection functions
+    CHANNEL_LOCK_OP_COUNT
+};
+
+typedef struct {
+    uint64_t acquisitions; // times the lock was taken
+    uint64_t contended;    // acquisitions that found the lock already taken
+    uint64_t wait_ns;      // total time spent waiting for the lock
+    uint64_t max_wait_ns;  // longest single wait for the lock
+    uint64_t hold_ns;      // total time the lock was held, excluding condition variable sleeps
+    uint64_t max_hold_ns;  // longest single stretch the lock was held
+} channel_lock_op_profile_t;
+
+// Lock profile kept per channel, all updated under channel_lock
+typedef struct {
+    channel_lock_op_profile_t ops[CHANNEL_LOCK_OP_COUNT];
+    uint64_t notify_ns;        // part of the hold time spent walking sel_sends/sel_recvs and signalling selects
+    uint64_t notified_selects; // selects signalled while walking those lists
+} channel_lock_profile_t;
+
+// Latency recording state of a channel, see channel_latency_enable
+typedef struct {
+    uint64_t* enqueue_ns; // enqueue timestamp of each buffered message, indexed like buffer->data
+    latency_hist_t hist;  // enqueue to dequeue latency of every received message
+} channel_latency_t;
+
 // define a structure to hold a lock and associated cond variable
 typedef struct{
   pthread_mutex_t *sel_lock;
@@ -44,6 +108,25 @@ typedef struct {
     list_t* sel_sends;
     list_t* sel_recvs;
     bool channel_status;
+    // NULL unless latency recording was enabled on this channel
+    channel_latency_t* latency;
+    // label for diagnostics, see channel_set_name
+    char name[CHANNEL_NAME_MAX];
+    // threads currently sleeping on empty (senders) and full (receivers)
+    size_t blocked_senders;
+    size_t blocked_receivers;
+    // watchdog ids of the threads that last sent on and received from this channel, 0 if unknown
+    uint64_t last_sender;
+    uint64_t last_receiver;
+    // this channel's node in the registry of live channels
+    list_node_t* registry_node;
+#if CHANNEL_STATS
+    channel_stats_t stats;
+#endif
+#if CHANNEL_LOCK_PROFILE
+    channel_lock_profile_t lock_profile;
+    uint64_t lock_acquired_ns; // when the current holder (re)acquired channel_lock
+#endif
 } channel_t;
 
 // Defines channel list structure for channel_select function
@@ -97,6 +180,24 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data);
 // GENERIC_ERROR on encountering any other generic error of any sort
 enum channel_status channel_non_blocking_receive(channel_t* channel, void** data);
 
+// Writes count messages from data to the given channel, in order
+// This is a blocking call i.e., the function waits for space whenever the channel is full
+// Messages are added under a single lock acquisition for as long as the buffer has room
+// The number of messages that made it into the channel is stored in sent
+// Returns SUCCESS once all messages have been written,
+// CLOSED_ERROR if the channel is closed (sent tells how many messages were written before that), and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_send_batch(channel_t* channel, void** data, size_t count, size_t* sent);
+
+// Reads up to max_count messages from the given channel into data, in FIFO order
+// This is a blocking call i.e., the function waits till the channel has at least one message to read,
+// then takes whatever else is already buffered (up to max_count) under the same lock acquisition
+// The number of messages read is stored in count
+// Returns SUCCESS for successful retrieval of at least one message,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort (including max_count == 0)
+enum channel_status channel_receive_batch(channel_t* channel, void** data, size_t max_count, size_t* count);
+
 // Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
 // Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
 // Returns SUCCESS if close is successful,
@@ -120,4 +221,32 @@ enum channel_status channel_destroy(channel_t* channel);
 // Additionally, selected_index is set to the index of the channel that generated the error
 enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index);
 
+// Labels the channel for registry dumps and other diagnostics, truncated to CHANNEL_NAME_MAX - 1 characters
+void channel_set_name(channel_t* channel, const char* name);
+
+// Copies the statistics counters of the channel into stats
+// Returns SUCCESS on success and
+// GENERIC_ERROR if the counters were compiled out (stats is zeroed apart from occupancy in that case)
+enum channel_status channel_get_stats(channel_t* channel, channel_stats_t* stats);
+
+// Starts recording the enqueue to dequeue latency of every message passing through the channel
+// Messages already buffered when recording starts are measured from the time of this call
+// Returns SUCCESS if recording is enabled (or already was) and
+// GENERIC_ERROR if the recording state could not be allocated
+enum channel_status channel_latency_enable(channel_t* channel);
+
+// Copies the latency histogram of the channel into hist
+// Query it with latency_hist_percentile, e.g. for p50/p99/p999, and hist->max
+// Returns SUCCESS on success and
+// GENERIC_ERROR if latency recording is not enabled on the channel (hist is emptied in that case)
+enum channel_status channel_get_latency(channel_t* channel, latency_hist_t* hist);
+
+// Copies the lock profile of the channel into profile
+// Returns SUCCESS on success and
+// GENERIC_ERROR if lock profiling was compiled out (profile is zeroed in that case)
+enum channel_status channel_get_lock_profile(channel_t* channel, channel_lock_profile_t* profile);
+
+// Prints one line per operation type with acquisitions, contention and wait/hold times, prefixed by label
+void channel_lock_profile_print(FILE* file, const char* label, const channel_lock_profile_t* profile);
+
 #endif // CHANNEL_H
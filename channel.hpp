@@ -0,0 +1,429 @@
+#ifndef CHANNEL_HPP
+#define CHANNEL_HPP
+
+// Header-only C++20 wrapper around channel_t
+// Channel<T, Capacity, Producers, Consumers> carries values of a trivially copyable type T without void* casts,
+// offers co_await-able send/recv operations and a variadic select that expands at compile time
+// Everything forwards directly to the C functions in channel.h, there is no virtual dispatch anywhere
+
+extern "C" {
+#include "channel.h"
+}
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace chan {
+
+// Channel shapes that can be requested at compile time
+enum class kind {
+    spsc, // single producer, single consumer
+    mpsc, // multiple producers, single consumer
+    mpmc, // multiple producers, multiple consumers
+};
+
+template <std::size_t Producers, std::size_t Consumers>
+inline constexpr kind kind_of = (Producers == 1 && Consumers == 1) ? kind::spsc
+                              : (Consumers == 1) ? kind::mpsc
+                              : kind::mpmc;
+
+// Implementation used for each channel shape
+// channel_t already supports any number of senders and receivers, so every shape currently maps onto it;
+// a specialised SPSC/MPSC backend only needs to specialise this template to be picked up by Channel
+template <kind K>
+struct backend {
+    using handle = channel_t*;
+
+    static handle create(std::size_t capacity) { return channel_create(capacity); }
+    static channel_status send(handle ch, void* msg) { return channel_send(ch, msg); }
+    static channel_status receive(handle ch, void** msg) { return channel_receive(ch, msg); }
+    static channel_status try_send(handle ch, void* msg) { return channel_non_blocking_send(ch, msg); }
+    static channel_status try_receive(handle ch, void** msg) { return channel_non_blocking_receive(ch, msg); }
+    static channel_status close(handle ch) { return channel_close(ch); }
+    static channel_status destroy(handle ch) { return channel_destroy(ch); }
+    static channel_t* raw(handle ch) { return ch; }
+};
+
+// Converts a T to the void* message stored in the channel buffer and back
+// Values that fit in a pointer are stored inline, larger values are boxed on the heap
+template <typename T>
+struct payload {
+    static_assert(std::is_trivially_copyable_v<T>, "channel values must be trivially copyable");
+
+    static constexpr bool is_inline = sizeof(T) <= sizeof(void*) && alignof(T) <= alignof(void*);
+
+    static void* encode(const T& value)
+    {
+        if constexpr (is_inline) {
+            void* msg = nullptr;
+            std::memcpy(&msg, &value, sizeof(T));
+            return msg;
+        } else {
+            return new T(value);
+        }
+    }
+
+    static T decode(void* msg)
+    {
+        if constexpr (is_inline) {
+            alignas(T) unsigned char storage[sizeof(T)];
+            std::memcpy(storage, &msg, sizeof(T));
+            return *std::launder(reinterpret_cast<T*>(storage));
+        } else {
+            T* boxed = static_cast<T*>(msg);
+            T value = *boxed;
+            delete boxed;
+            return value;
+        }
+    }
+
+    // Releases a message that was encoded but never delivered
+    static void discard(void* msg)
+    {
+        if constexpr (!is_inline) {
+            delete static_cast<T*>(msg);
+        }
+    }
+};
+
+// Result of a receive: the status from channel_receive and the value on SUCCESS
+template <typename T>
+struct received {
+    channel_status status;
+    std::optional<T> value;
+
+    explicit operator bool() const { return status == SUCCESS; }
+};
+
+// Result of a select: the status from channel_select and the index of the case that completed or failed
+struct selected {
+    channel_status status;
+    std::size_t index;
+};
+
+namespace detail {
+
+// A send or receive a suspended coroutine is waiting on; filled in by the waiter before it resumes the coroutine
+struct pending_op {
+    select_t entry;
+    channel_status status;
+    std::coroutine_handle<> coroutine;
+};
+
+// One thread that completes every suspended send/recv of a channel with a single channel_select over all of
+// them plus a doorbell channel rung whenever a new operation is added
+// Started by the first suspension and joined by stop, so a channel never has more than one helper thread
+// Coroutines are resumed on this thread; they must not destroy the channel that resumed them
+class waiter {
+public:
+    waiter() = default;
+    ~waiter() { stop(); }
+
+    waiter(const waiter&) = delete;
+    waiter& operator=(const waiter&) = delete;
+
+    void add(pending_op* op)
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (!thread_.joinable()) {
+            bell_ = channel_create(1);
+            thread_ = std::thread([this] { run(); });
+        }
+        added_.push_back(op);
+        // a full doorbell already has a ring pending
+        channel_non_blocking_send(bell_, nullptr);
+    }
+
+    // Waits for every pending operation to complete and joins the thread
+    // The caller closes the channel first so that operations that could otherwise block forever fail instead
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            if (!thread_.joinable()) {
+                return;
+            }
+            stopping_ = true;
+            channel_non_blocking_send(bell_, nullptr);
+        }
+        thread_.join();
+        channel_close(bell_);
+        channel_destroy(bell_);
+    }
+
+private:
+    void run()
+    {
+        std::vector<pending_op*> ops;
+        std::vector<select_t> list;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> guard(lock_);
+                ops.insert(ops.end(), added_.begin(), added_.end());
+                added_.clear();
+                if (stopping_ && ops.empty()) {
+                    return;
+                }
+            }
+            list.clear();
+            list.push_back({bell_, RECV, nullptr});
+            for (pending_op* op : ops) {
+                list.push_back(op->entry);
+            }
+            std::size_t index = 0;
+            channel_status status = channel_select(list.data(), list.size(), &index);
+            if (index == 0) {
+                continue;
+            }
+            pending_op* op = ops[index - 1];
+            ops.erase(ops.begin() + static_cast<std::ptrdiff_t>(index - 1));
+            op->status = status;
+            op->entry.data = list[index].data;
+            op->coroutine.resume();
+        }
+    }
+
+    std::mutex lock_;
+    std::vector<pending_op*> added_;
+    bool stopping_ = false;
+    channel_t* bell_ = nullptr;
+    std::thread thread_;
+};
+
+} // namespace detail
+
+template <typename T, std::size_t Capacity, std::size_t Producers = 1, std::size_t Consumers = 1>
+class Channel {
+public:
+    using value_type = T;
+    static constexpr std::size_t capacity = Capacity;
+    static constexpr kind shape = kind_of<Producers, Consumers>;
+
+    static_assert(Producers > 0 && Consumers > 0, "a channel needs at least one producer and one consumer");
+
+private:
+    using impl = backend<shape>;
+    using codec = payload<T>;
+
+public:
+    Channel() : handle_(impl::create(Capacity)) {}
+
+    ~Channel()
+    {
+        impl::close(handle_);
+        // every suspended operation has failed with CLOSED_ERROR once the waiter is joined
+        waiter_.stop();
+        // boxed values still sitting in the buffer would leak otherwise
+        if constexpr (!codec::is_inline) {
+            void* msg = nullptr;
+            while (buffer_remove(impl::raw(handle_)->buffer, &msg) == BUFFER_SUCCESS) {
+                codec::discard(msg);
+            }
+        }
+        impl::destroy(handle_);
+    }
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    channel_t* raw() const { return impl::raw(handle_); }
+
+    channel_status close() { return impl::close(handle_); }
+
+    // Blocking send, see channel_send
+    channel_status blocking_send(const T& value)
+    {
+        void* msg = codec::encode(value);
+        channel_status status = impl::send(handle_, msg);
+        if (status != SUCCESS) {
+            codec::discard(msg);
+        }
+        return status;
+    }
+
+    // Blocking receive, see channel_receive
+    received<T> blocking_recv()
+    {
+        void* msg = nullptr;
+        channel_status status = impl::receive(handle_, &msg);
+        if (status != SUCCESS) {
+            return {status, std::nullopt};
+        }
+        return {status, codec::decode(msg)};
+    }
+
+    // Non-blocking send, see channel_non_blocking_send
+    channel_status try_send(const T& value)
+    {
+        void* msg = codec::encode(value);
+        channel_status status = impl::try_send(handle_, msg);
+        if (status != SUCCESS) {
+            codec::discard(msg);
+        }
+        return status;
+    }
+
+    // Non-blocking receive, see channel_non_blocking_receive
+    received<T> try_recv()
+    {
+        void* msg = nullptr;
+        channel_status status = impl::try_receive(handle_, &msg);
+        if (status != SUCCESS) {
+            return {status, std::nullopt};
+        }
+        return {status, codec::decode(msg)};
+    }
+
+    // Awaitable send
+    // Completes without suspending when there is room in the buffer; otherwise the coroutine is suspended until
+    // the channel's waiter thread completes the send, and resumes on that thread
+    // The value is only encoded once the send is attempted, so an awaiter that is never awaited owns nothing
+    class send_awaiter {
+    public:
+        send_awaiter(Channel& ch, const T& value)
+            : ch_(ch), value_(value), op_{{ch.raw(), SEND, nullptr}, GENERIC_ERROR, {}}
+        {
+        }
+
+        bool await_ready()
+        {
+            op_.entry.data = codec::encode(value_);
+            op_.status = impl::try_send(ch_.handle_, op_.entry.data);
+            return op_.status != CHANNEL_FULL;
+        }
+
+        void await_suspend(std::coroutine_handle<> coroutine)
+        {
+            op_.coroutine = coroutine;
+            ch_.waiter_.add(&op_);
+        }
+
+        channel_status await_resume()
+        {
+            if (op_.status != SUCCESS) {
+                codec::discard(op_.entry.data);
+            }
+            return op_.status;
+        }
+
+    private:
+        Channel& ch_;
+        T value_;
+        detail::pending_op op_;
+    };
+
+    // Awaitable receive, suspends and resumes the same way as send_awaiter
+    class recv_awaiter {
+    public:
+        explicit recv_awaiter(Channel& ch) : ch_(ch), op_{{ch.raw(), RECV, nullptr}, GENERIC_ERROR, {}} {}
+
+        bool await_ready()
+        {
+            op_.status = impl::try_receive(ch_.handle_, &op_.entry.data);
+            return op_.status != CHANNEL_EMPTY;
+        }
+
+        void await_suspend(std::coroutine_handle<> coroutine)
+        {
+            op_.coroutine = coroutine;
+            ch_.waiter_.add(&op_);
+        }
+
+        received<T> await_resume()
+        {
+            if (op_.status != SUCCESS) {
+                return {op_.status, std::nullopt};
+            }
+            return {op_.status, codec::decode(op_.entry.data)};
+        }
+
+    private:
+        Channel& ch_;
+        detail::pending_op op_;
+    };
+
+    send_awaiter send(const T& value) { return send_awaiter(*this, value); }
+    recv_awaiter recv() { return recv_awaiter(*this); }
+
+    // Cases for select
+    // A send case owns its encoded message until select delivers it; a recv case holds the value received
+    class send_case {
+    public:
+        send_case(Channel& ch, const T& value) : ch_(ch), msg_(codec::encode(value)), delivered_(false) {}
+        ~send_case()
+        {
+            if (!delivered_) {
+                codec::discard(msg_);
+            }
+        }
+        send_case(const send_case&) = delete;
+        send_case& operator=(const send_case&) = delete;
+
+        select_t entry() const { return {ch_.raw(), SEND, msg_}; }
+        void complete(void*) { delivered_ = true; }
+
+    private:
+        Channel& ch_;
+        void* msg_;
+        bool delivered_;
+    };
+
+    class recv_case {
+    public:
+        explicit recv_case(Channel& ch) : ch_(ch) {}
+
+        select_t entry() const { return {ch_.raw(), RECV, nullptr}; }
+        void complete(void* msg) { value = codec::decode(msg); }
+
+        std::optional<T> value;
+
+    private:
+        Channel& ch_;
+    };
+
+    send_case send_op(const T& value) { return send_case(*this, value); }
+    recv_case recv_op() { return recv_case(*this); }
+
+private:
+    typename impl::handle handle_;
+    detail::waiter waiter_;
+};
+
+namespace detail {
+
+template <typename... Cases, std::size_t... I>
+selected select_impl(std::index_sequence<I...>, Cases&... cases)
+{
+    std::array<select_t, sizeof...(Cases)> list = {cases.entry()...};
+    selected result{GENERIC_ERROR, sizeof...(Cases)};
+    result.status = channel_select(list.data(), list.size(), &result.index);
+    if (result.status == SUCCESS) {
+        // only the case at result.index completed, hand it its message
+        ((I == result.index ? cases.complete(list[I].data) : void()), ...);
+    }
+    return result;
+}
+
+} // namespace detail
+
+// Blocks until one of the cases can complete, performs it and returns its index, see channel_select
+// The list of select_t entries is built on the stack from the parameter pack, so no allocation takes place
+template <typename... Cases>
+selected select(Cases&... cases)
+{
+    static_assert(sizeof...(Cases) > 0, "select needs at least one case");
+    return detail::select_impl(std::index_sequence_for<Cases...>{}, cases...);
+}
+
+} // namespace chan
+
+#endif // CHANNEL_HPP
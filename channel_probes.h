@@ -0,0 +1,48 @@
+#ifndef CHANNEL_PROBES_H
+#define CHANNEL_PROBES_H
+
+// USDT (SDT) probe points on the channel hot paths, provider "channel"
+// Each probe compiles to a single nop plus an ELF note and costs nothing until a tracer attaches to it, e.g.
+//   bpftrace -e 'usdt:./channel:channel:block { @start[tid] = nsecs; }
+//                usdt:./channel:channel:wake /@start[tid]/ { @blocked = hist(nsecs - @start[tid]); delete(@start[tid]); }'
+//   perf buildid-cache --add ./channel && perf record -e sdt_channel:send_entry ...
+// Probes are built in whenever the header-only <sys/sdt.h> (systemtap-sdt-dev) is available
+// Build with -DCHANNEL_USDT=0 to leave them out, or -DCHANNEL_USDT=1 to insist on them
+//
+// Probe                  Arguments
+// send_entry             channel, data (channel_send and channel_non_blocking_send)
+// send_return            channel, status
+// receive_entry          channel (channel_receive and channel_non_blocking_receive)
+// receive_return         channel, status, data (NULL unless status is SUCCESS)
+// send_batch_entry       channel, count
+// send_batch_return      channel, status, messages sent
+// receive_batch_entry    channel, max_count
+// receive_batch_return   channel, status, messages received
+// select_entry           select list, channel count
+// select_return          status, selected index (channel count on GENERIC_ERROR)
+// block                  channel (NULL for a select), about to sleep on a condition variable
+// wake                   channel (NULL for a select), woke up from that sleep
+// close                  channel
+#ifndef CHANNEL_USDT
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define CHANNEL_USDT 1
+#endif
+#endif
+#endif
+#ifndef CHANNEL_USDT
+#define CHANNEL_USDT 0
+#endif
+
+#if CHANNEL_USDT
+#include <sys/sdt.h>
+#define CHANNEL_PROBE1(name, arg1) DTRACE_PROBE1(channel, name, arg1)
+#define CHANNEL_PROBE2(name, arg1, arg2) DTRACE_PROBE2(channel, name, arg1, arg2)
+#define CHANNEL_PROBE3(name, arg1, arg2, arg3) DTRACE_PROBE3(channel, name, arg1, arg2, arg3)
+#else
+#define CHANNEL_PROBE1(name, arg1) ((void)0)
+#define CHANNEL_PROBE2(name, arg1, arg2) ((void)0)
+#define CHANNEL_PROBE3(name, arg1, arg2, arg3) ((void)0)
+#endif
+
+#endif // CHANNEL_PROBES_H
@@ -0,0 +1,232 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "channel_registry.h"
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+// live channels in creation order; created with the first of them and freed with the last, so nothing is
+// left allocated once every channel is destroyed
+static list_t* registry;
+
+static int server_fd = -1;
+static pthread_t server_thread;
+static atomic_bool server_stopping;
+static char server_path[sizeof(((struct sockaddr_un*)NULL)->sun_path)];
+
+void channel_registry_add(channel_t* channel)
+{
+    pthread_mutex_lock(&registry_lock);
+    if (registry == NULL) {
+        registry = list_create();
+    }
+    channel->registry_node = list_insert(registry, channel);
+    pthread_mutex_unlock(&registry_lock);
+}
+
+void channel_registry_remove(channel_t* channel)
+{
+    pthread_mutex_lock(&registry_lock);
+    list_remove(registry, channel->registry_node);
+    channel->registry_node = NULL;
+    if (list_count(registry) == 0) {
+        list_destroy(registry);
+        registry = NULL;
+    }
+    pthread_mutex_unlock(&registry_lock);
+}
+
+size_t channel_registry_count(void)
+{
+    pthread_mutex_lock(&registry_lock);
+    size_t count = registry == NULL ? 0 : list_count(registry);
+    pthread_mutex_unlock(&registry_lock);
+    return count;
+}
+
+// Fills info from the channel, assumes the registry lock is held so the channel cannot be destroyed
+static void registry_info(channel_t* channel, channel_info_t* info)
+{
+    pthread_mutex_lock(&channel->channel_lock);
+    info->channel = channel;
+    memcpy(info->name, channel->name, sizeof(info->name));
+    info->capacity = buffer_capacity(channel->buffer);
+    info->depth = buffer_current_size(channel->buffer);
+    info->blocked_senders = channel->blocked_senders;
+    info->blocked_receivers = channel->blocked_receivers;
+    info->select_senders = list_count(channel->sel_sends);
+    info->select_receivers = list_count(channel->sel_recvs);
+    info->closed = channel->channel_status == false;
+    pthread_mutex_unlock(&channel->channel_lock);
+}
+
+size_t channel_registry_snapshot(channel_info_t* infos, size_t max_count)
+{
+    size_t count = 0;
+    pthread_mutex_lock(&registry_lock);
+    if (registry != NULL) {
+        for (list_node_t* node = list_head(registry); node != NULL && count < max_count; node = list_next(node)) {
+            registry_info(list_data(node), &infos[count++]);
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return count;
+}
+
+// Writes a label value, escaping the characters OpenMetrics reserves
+static void write_label_value(FILE* file, const char* value)
+{
+    for (const char* c = value; *c != '\0'; c++) {
+        if (*c == '\\' || *c == '"') {
+            fprintf(file, "\\%c", *c);
+        } else if (*c == '\n') {
+            fprintf(file, "\\n");
+        } else {
+            fputc(*c, file);
+        }
+    }
+}
+
+static void write_family_header(FILE* file, const char* name, const char* type, const char* help)
+{
+    fprintf(file, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+}
+
+static void write_sample(FILE* file, const char* name, const channel_info_t* info, unsigned long long value)
+{
+    fprintf(file, "%s{channel=\"", name);
+    write_label_value(file, info->name);
+    fprintf(file, "\",address=\"%p\"} %llu\n", (const void*)info->channel, value);
+}
+
+size_t channel_registry_dump(FILE* file)
+{
+    // take the snapshot first so that no lock is held while writing
+    pthread_mutex_lock(&registry_lock);
+    size_t count = registry == NULL ? 0 : list_count(registry);
+    channel_info_t* infos = malloc(sizeof(channel_info_t) * (count > 0 ? count : 1));
+    channel_stats_t* stats = malloc(sizeof(channel_stats_t) * (count > 0 ? count : 1));
+    assert(infos != NULL && stats != NULL);
+    size_t index = 0;
+    for (list_node_t* node = count > 0 ? list_head(registry) : NULL; node != NULL; node = list_next(node)) {
+        registry_info(list_data(node), &infos[index]);
+        channel_get_stats(list_data(node), &stats[index]);
+        index++;
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+#define WRITE_GAUGE(name, help, field)                              \
+    write_family_header(file, name, "gauge", help);                 \
+    for (size_t i = 0; i < count; i++) {                            \
+        write_sample(file, name, &infos[i], (unsigned long long)infos[i].field); \
+    }
+    WRITE_GAUGE("channel_capacity", "Maximum number of buffered messages.", capacity);
+    WRITE_GAUGE("channel_depth", "Messages currently buffered.", depth);
+    WRITE_GAUGE("channel_blocked_senders", "Threads blocked in a send waiting for space.", blocked_senders);
+    WRITE_GAUGE("channel_blocked_receivers", "Threads blocked in a receive waiting for a message.", blocked_receivers);
+    WRITE_GAUGE("channel_select_senders", "Blocked selects waiting to send on the channel.", select_senders);
+    WRITE_GAUGE("channel_select_receivers", "Blocked selects waiting to receive from the channel.", select_receivers);
+    WRITE_GAUGE("channel_closed", "1 if the channel has been closed.", closed);
+#undef WRITE_GAUGE
+#if CHANNEL_STATS
+    write_family_header(file, "channel_sends", "counter", "Messages added to the buffer.");
+    for (size_t i = 0; i < count; i++) {
+        write_sample(file, "channel_sends_total", &infos[i], (unsigned long long)stats[i].sends);
+    }
+    write_family_header(file, "channel_receives", "counter", "Messages removed from the buffer.");
+    for (size_t i = 0; i < count; i++) {
+        write_sample(file, "channel_receives_total", &infos[i], (unsigned long long)stats[i].receives);
+    }
+#endif
+    fprintf(file, "# EOF\n");
+    free(stats);
+    free(infos);
+    return count;
+}
+
+long channel_registry_dump_path(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    size_t count = channel_registry_dump(file);
+    if (fclose(file) != 0) {
+        return -1;
+    }
+    return (long)count;
+}
+
+static void* server_main(void* arg)
+{
+    int fd = *(int*)arg;
+    while (true) {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            if (atomic_load(&server_stopping)) {
+                break;
+            }
+            continue;
+        }
+        // render into memory and send with MSG_NOSIGNAL, so a client hanging up early cannot raise SIGPIPE
+        char* dump = NULL;
+        size_t length = 0;
+        FILE* file = open_memstream(&dump, &length);
+        if (file != NULL) {
+            channel_registry_dump(file);
+            fclose(file);
+            for (size_t sent = 0; sent < length;) {
+                ssize_t written = send(client, dump + sent, length - sent, MSG_NOSIGNAL);
+                if (written <= 0) {
+                    break;
+                }
+                sent += (size_t)written;
+            }
+            free(dump);
+        }
+        close(client);
+    }
+    return NULL;
+}
+
+int channel_registry_serve(const char* path)
+{
+    struct sockaddr_un address;
+    if (server_fd >= 0 || strlen(path) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 8) != 0) {
+        close(fd);
+        return -1;
+    }
+    strcpy(server_path, path);
+    server_fd = fd;
+    atomic_store(&server_stopping, false);
+    int pthread_status = pthread_create(&server_thread, NULL, server_main, &server_fd);
+    assert(pthread_status == 0);
+    (void)pthread_status;
+    return 0;
+}
+
+void channel_registry_serve_stop(void)
+{
+    if (server_fd < 0) {
+        return;
+    }
+    atomic_store(&server_stopping, true);
+    // wakes the server thread out of accept
+    shutdown(server_fd, SHUT_RDWR);
+    pthread_join(server_thread, NULL);
+    close(server_fd);
+    unlink(server_path);
+    server_fd = -1;
+}
@@ -0,0 +1,55 @@
+#ifndef CHANNEL_REGISTRY_H
+#define CHANNEL_REGISTRY_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "channel.h"
+
+// Process-wide registry of live channels
+// channel_create registers every channel and channel_destroy unregisters it, so the registry always lists
+// exactly the channels that can still be used
+// Lock order: the registry lock is taken before any channel_lock, never the other way round
+
+// Point-in-time view of one channel, all fields read under its channel_lock
+typedef struct {
+    const channel_t* channel;
+    char name[CHANNEL_NAME_MAX]; // label given with channel_set_name, empty if none
+    size_t capacity;             // maximum number of buffered messages
+    size_t depth;                // messages currently buffered
+    size_t blocked_senders;      // threads sleeping in a send until space frees up
+    size_t blocked_receivers;    // threads sleeping in a receive until a message arrives
+    size_t select_senders;       // blocked selects waiting to send on the channel
+    size_t select_receivers;     // blocked selects waiting to receive from the channel
+    bool closed;
+} channel_info_t;
+
+// Called by channel_create and channel_destroy
+void channel_registry_add(channel_t* channel);
+void channel_registry_remove(channel_t* channel);
+
+// Returns the number of live channels
+size_t channel_registry_count(void);
+
+// Stores a view of up to max_count live channels in infos, in creation order
+// Returns the number of views stored
+size_t channel_registry_snapshot(channel_info_t* infos, size_t max_count);
+
+// Writes every live channel in OpenMetrics text format, one sample per metric and channel,
+// labelled with the channel's name and address
+// Returns the number of channels written
+size_t channel_registry_dump(FILE* file);
+
+// Same as channel_registry_dump, writing to the file at path
+// Returns the number of channels written, or -1 if the file could not be written
+long channel_registry_dump_path(const char* path);
+
+// Starts a thread that serves a fresh dump to every client connecting to the Unix socket at path,
+// e.g. `socat - UNIX-CONNECT:path` or a Prometheus exporter sidecar
+// Any existing file at path is replaced
+// Returns 0 on success, -1 if the socket could not be set up or a server is already running
+int channel_registry_serve(const char* path);
+
+// Stops the socket server started by channel_registry_serve and removes the socket file
+void channel_registry_serve_stop(void);
+
+#endif // CHANNEL_REGISTRY_H
@@ -42,6 +42,9 @@ def add_test_case_sanitize(test_name, iters=0, timeout=0):
 def add_test_case_valgrind(test_name, iters=0, timeout=0):
     test_cases[f"valgrind_{test_name}"] = {"args": ["valgrind", "-v", "--leak-check=full", "--errors-for-leak-kinds=all", "--error-exitcode=2", "./channel", test_name, str(iters_valgrind if iters == 0 else iters)], "timeout": timeout_valgrind if timeout == 0 else timeout}
 
+def add_test_case_profile(test_name, iters=0, timeout=0):
+    test_cases[f"profile_{test_name}"] = {"args": ["./channel_profile", test_name, str(iters_channel if iters == 0 else iters)], "timeout": timeout_channel if timeout == 0 else timeout}
+
 def add_test_cases(test_name, iters=0, timeout=0):
     add_test_case_channel(test_name, iters, timeout)
     add_test_case_sanitize(test_name, iters, timeout)
@@ -82,6 +85,31 @@ add_test_cases("test_select_response_time", iters_response_time, timeout_respons
 add_test_cases("test_cpu_utilization_select", iters_cpu_utilization, timeout_cpu_utilization)
 add_test_cases("test_cpu_utilization_overall", iters_cpu_utilization, timeout_cpu_utilization)
 add_test_cases("test_for_too_many_wakeups", iters_one, timeout_too_many_wakeups)
+add_test_cases("test_select_many_channels", iters_slow)
+add_test_cases("test_send_receive_batch", iters_slow)
+add_test_cases("test_pipeline", iters_one)
+add_test_cases("test_pipeline_drain", iters_one)
+add_test_cases("test_timer_channels", iters_one)
+add_test_cases("test_channel_stats", iters_slow)
+add_test_cases("test_latency_histogram", iters_one)
+add_test_cases("test_lock_profile", iters_one)
+add_test_case_profile("test_lock_profile", iters_slow)
+add_test_cases("test_trace", iters_one)
+add_test_cases("test_channel_registry", iters_one)
+add_test_cases("test_watchdog", iters_one)
+add_test_cases("test_stress_send_recv_report", iters_one, timeout_stress_send_recv)
+add_test_cases("test_loadgen", iters_one, timeout_stress_send_recv)
+add_test_cases("test_topogen", iters_slow)
+add_test_cases("test_stress_report", iters_one, timeout_valgrind * 5)
+add_test_cases("test_floyd_warshall", iters_one, timeout_valgrind * 5)
+add_test_cases("test_minplus", iters_slow)
+add_test_cases("test_topology", iters_one, timeout_valgrind * 5)
+add_test_cases("test_stress_deltas", iters_one, timeout_valgrind * 5)
+add_test_cases("test_partition", iters_slow)
+add_test_cases("test_stress_workers", iters_one, timeout_valgrind * 5)
+add_test_cases("test_apsp_update", iters_one, timeout_valgrind * 5)
+add_test_cases("test_stress_updates", iters_one, timeout_valgrind * 5)
+add_test_cases("test_stress_buffers", iters_one, timeout_valgrind * 5)
 
 # Score distribution
 point_breakdown_checkpoint = [
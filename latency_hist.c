@@ -0,0 +1,103 @@
+#include <string.h>
+#include "latency_hist.h"
+
+static size_t bucket_index(uint64_t value)
+{
+    if (value < LATENCY_HIST_SUB_BUCKETS) {
+        return (size_t)value;
+    }
+    unsigned msb = 63u - (unsigned)__builtin_clzll(value);
+    unsigned shift = msb - LATENCY_HIST_SUB_BITS;
+    size_t sub = (size_t)((value >> shift) & (LATENCY_HIST_SUB_BUCKETS - 1));
+    return (shift + 1) * LATENCY_HIST_SUB_BUCKETS + sub;
+}
+
+// Largest value that falls into the given bucket
+static uint64_t bucket_upper_bound(size_t index)
+{
+    if (index < LATENCY_HIST_SUB_BUCKETS) {
+        return index;
+    }
+    unsigned shift = (unsigned)(index / LATENCY_HIST_SUB_BUCKETS) - 1;
+    uint64_t sub = index % LATENCY_HIST_SUB_BUCKETS;
+    uint64_t lower = (LATENCY_HIST_SUB_BUCKETS + sub) << shift;
+    return lower + ((1ull << shift) - 1);
+}
+
+void latency_hist_init(latency_hist_t* hist)
+{
+    memset(hist, 0, sizeof(*hist));
+    hist->min = UINT64_MAX;
+}
+
+void latency_hist_record(latency_hist_t* hist, uint64_t value)
+{
+    hist->counts[bucket_index(value)]++;
+    hist->count++;
+    hist->sum += value;
+    if (value < hist->min) {
+        hist->min = value;
+    }
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+void latency_hist_merge(latency_hist_t* dst, const latency_hist_t* src)
+{
+    for (size_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+uint64_t latency_hist_percentile(const latency_hist_t* hist, double percentile)
+{
+    if (hist->count == 0) {
+        return 0;
+    }
+    if (percentile >= 100.0) {
+        return hist->max;
+    }
+    // rank of the wanted value, at least the first one
+    uint64_t rank = (uint64_t)((percentile / 100.0) * (double)hist->count + 0.999999);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            uint64_t upper = bucket_upper_bound(i);
+            return upper < hist->max ? upper : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+double latency_hist_mean(const latency_hist_t* hist)
+{
+    if (hist->count == 0) {
+        return 0.0;
+    }
+    return (double)hist->sum / (double)hist->count;
+}
+
+void latency_hist_print(FILE* file, const char* label, const latency_hist_t* hist)
+{
+    fprintf(file, "%s: count=%llu mean=%.0fns p50=%lluns p99=%lluns p999=%lluns max=%lluns\n",
+            label,
+            (unsigned long long)hist->count,
+            latency_hist_mean(hist),
+            (unsigned long long)latency_hist_percentile(hist, 50.0),
+            (unsigned long long)latency_hist_percentile(hist, 99.0),
+            (unsigned long long)latency_hist_percentile(hist, 99.9),
+            (unsigned long long)hist->max);
+}
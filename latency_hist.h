@@ -0,0 +1,42 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Log-linear (HDR-style) histogram of nanosecond values
+// Every power of two is split into LATENCY_HIST_SUB_BUCKETS linear buckets, so any recorded value is
+// reported with a relative error below 1 / LATENCY_HIST_SUB_BUCKETS over the full 64-bit range
+#define LATENCY_HIST_SUB_BITS 4
+#define LATENCY_HIST_SUB_BUCKETS (1u << LATENCY_HIST_SUB_BITS)
+#define LATENCY_HIST_BUCKETS ((64 - LATENCY_HIST_SUB_BITS + 1) * LATENCY_HIST_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t counts[LATENCY_HIST_BUCKETS];
+    uint64_t count; // number of recorded values
+    uint64_t min;   // smallest recorded value (UINT64_MAX while empty)
+    uint64_t max;   // largest recorded value
+    uint64_t sum;   // sum of recorded values, for the mean
+} latency_hist_t;
+
+// Empties the histogram
+void latency_hist_init(latency_hist_t* hist);
+
+// Records one value
+void latency_hist_record(latency_hist_t* hist, uint64_t value);
+
+// Adds all values recorded in src to dst
+void latency_hist_merge(latency_hist_t* dst, const latency_hist_t* src);
+
+// Returns the value below which percentile (0-100) percent of the recorded values fall
+// The result is the upper bound of the bucket holding that value, capped at the recorded maximum
+// Returns 0 for an empty histogram
+uint64_t latency_hist_percentile(const latency_hist_t* hist, double percentile);
+
+// Returns the mean of the recorded values, 0 for an empty histogram
+double latency_hist_mean(const latency_hist_t* hist);
+
+// Prints count, mean, p50, p99, p999 and max on one line, prefixed by label
+void latency_hist_print(FILE* file, const char* label, const latency_hist_t* hist);
+
+#endif // LATENCY_HIST_H
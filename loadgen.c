@@ -0,0 +1,158 @@
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include "channel.h"
+#include "loadgen.h"
+#include "timer.h"
+
+typedef struct {
+    channel_t* channel;
+    uint64_t service_ns;
+    latency_hist_t latency;
+} consumer_args_t;
+
+// Sleeps until the given CLOCK_MONOTONIC time
+static void sleep_until_ns(uint64_t when_ns)
+{
+    struct timespec when;
+    when.tv_sec = (time_t)(when_ns / 1000000000ull);
+    when.tv_nsec = (long)(when_ns % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, NULL) != 0) {
+        // interrupted by a signal, sleep for the rest
+    }
+}
+
+// xorshift64*, good enough for arrival gaps and reproducible from the seed
+static uint64_t next_random(uint64_t* state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+// Returns a uniform double in (0, 1]
+static double next_uniform(uint64_t* state)
+{
+    return ((double)(next_random(state) >> 11) + 1.0) / 9007199254740992.0;
+}
+
+// Each message is its scheduled arrival time, never 0, so NULL can tell the consumers to stop
+static void* consumer_thread(void* arg)
+{
+    consumer_args_t* args = arg;
+    while (true) {
+        void* data = NULL;
+        enum channel_status status = channel_receive(args->channel, &data);
+        assert(status == SUCCESS);
+        (void)status;
+        if (data == NULL) {
+            break;
+        }
+        uint64_t scheduled_ns = (uint64_t)(uintptr_t)data;
+        uint64_t now = timer_now_ns();
+        // busy, like a server working on a request, rather than sleeping
+        uint64_t done_ns = now + args->service_ns;
+        while (now < done_ns) {
+            now = timer_now_ns();
+        }
+        latency_hist_record(&args->latency, now - scheduled_ns);
+    }
+    return NULL;
+}
+
+int loadgen_run(const loadgen_config_t* config, loadgen_report_t* report)
+{
+    // a channel without room for a message never completes a send
+    if (!(config->rate > 0) || config->duration_ns == 0 || config->buffer_size == 0 || config->num_consumers == 0 ||
+        (config->arrival == LOADGEN_BURSTY && config->burst_on_ns == 0)) {
+        return -1;
+    }
+    channel_t* channel = channel_create(config->buffer_size);
+    assert(channel != NULL);
+    channel_set_name(channel, "loadgen");
+    pthread_t* threads = malloc(sizeof(pthread_t) * config->num_consumers);
+    consumer_args_t* args = malloc(sizeof(consumer_args_t) * config->num_consumers);
+    assert(threads != NULL && args != NULL);
+    for (size_t i = 0; i < config->num_consumers; i++) {
+        args[i].channel = channel;
+        args[i].service_ns = config->service_ns;
+        latency_hist_init(&args[i].latency);
+        int pthread_status = pthread_create(&threads[i], NULL, consumer_thread, &args[i]);
+        assert(pthread_status == 0);
+        (void)pthread_status;
+    }
+
+    double gap_ns = 1e9 / config->rate;
+    if (config->arrival == LOADGEN_BURSTY) {
+        // all arrivals of a cycle fall in its on period
+        gap_ns = gap_ns * (double)config->burst_on_ns / (double)(config->burst_on_ns + config->burst_off_ns);
+    }
+    uint64_t random_state = config->seed != 0 ? config->seed : 0x9e3779b97f4a7c15ull;
+    uint64_t start_ns = timer_now_ns();
+    uint64_t max_lag_ns = 0;
+    size_t sent = 0;
+    double poisson_offset_ns = 0;
+    while (true) {
+        // offset of the next arrival from the start, computed from the message index where possible so that
+        // rounding does not drift
+        double offset_ns;
+        if (config->arrival == LOADGEN_CONSTANT) {
+            offset_ns = (double)sent * gap_ns;
+        } else if (config->arrival == LOADGEN_POISSON) {
+            poisson_offset_ns += -log(next_uniform(&random_state)) * gap_ns;
+            offset_ns = poisson_offset_ns;
+        } else {
+            double active_ns = (double)sent * gap_ns;
+            double cycles = floor(active_ns / (double)config->burst_on_ns);
+            offset_ns = cycles * (double)(config->burst_on_ns + config->burst_off_ns) +
+                        (active_ns - cycles * (double)config->burst_on_ns);
+        }
+        if (offset_ns >= (double)config->duration_ns) {
+            break;
+        }
+        uint64_t scheduled_ns = start_ns + 1 + (uint64_t)offset_ns;
+        uint64_t now = timer_now_ns();
+        if (now < scheduled_ns) {
+            sleep_until_ns(scheduled_ns);
+        } else if (now - scheduled_ns > max_lag_ns) {
+            max_lag_ns = now - scheduled_ns;
+        }
+        enum channel_status status = channel_send(channel, (void*)(uintptr_t)scheduled_ns);
+        assert(status == SUCCESS);
+        (void)status;
+        sent++;
+    }
+
+    for (size_t i = 0; i < config->num_consumers; i++) {
+        enum channel_status status = channel_send(channel, NULL);
+        assert(status == SUCCESS);
+        (void)status;
+    }
+    latency_hist_init(&report->latency);
+    for (size_t i = 0; i < config->num_consumers; i++) {
+        pthread_join(threads[i], NULL);
+        latency_hist_merge(&report->latency, &args[i].latency);
+    }
+    uint64_t elapsed_ns = timer_now_ns() - start_ns;
+    report->sent = sent;
+    report->seconds = (double)elapsed_ns / 1e9;
+    report->offered_rate = (double)sent * 1e9 / (double)config->duration_ns;
+    report->achieved_rate = (double)sent / report->seconds;
+    report->max_lag_ns = max_lag_ns;
+
+    channel_close(channel);
+    channel_destroy(channel);
+    free(args);
+    free(threads);
+    return 0;
+}
+
+void loadgen_report_print(FILE* file, const char* label, const loadgen_report_t* report)
+{
+    fprintf(file, "%s: %zu messages, offered %.0f/s, achieved %.0f/s, max lag %.3f ms\n", label, report->sent,
+            report->offered_rate, report->achieved_rate, (double)report->max_lag_ns / 1e6);
+    latency_hist_print(file, label, &report->latency);
+}
@@ -0,0 +1,48 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "latency_hist.h"
+
+// Open-loop load generator: messages are injected into a channel on a fixed schedule, whatever the consumers
+// do, and each message's latency is measured from the time it was scheduled to arrive
+// When the channel is full the generator falls behind, but the messages it then sends late keep their
+// scheduled times, so queueing delay is counted instead of hidden (no coordinated omission)
+
+enum loadgen_arrival {
+    LOADGEN_CONSTANT, // evenly spaced arrivals
+    LOADGEN_POISSON,  // exponentially distributed gaps
+    LOADGEN_BURSTY,   // evenly spaced arrivals during on periods, none during off periods
+};
+
+typedef struct {
+    enum loadgen_arrival arrival;
+    double rate;           // mean arrivals per second over the run
+    uint64_t duration_ns;  // arrivals are scheduled during this long
+    uint64_t burst_on_ns;  // LOADGEN_BURSTY only: length of the on and off periods; arrivals during an
+    uint64_t burst_off_ns; // on period run at rate * (on + off) / on so that the mean stays rate
+    size_t buffer_size;    // capacity of the channel between generator and consumers
+    size_t num_consumers;
+    uint64_t service_ns;   // time each consumer spends on a message after receiving it
+    uint64_t seed;         // seed for LOADGEN_POISSON gaps, the same seed gives the same schedule
+} loadgen_config_t;
+
+typedef struct {
+    size_t sent;            // messages scheduled and sent, all of which were received
+    double seconds;         // from the first scheduled arrival until the last message was handled
+    double offered_rate;    // sent / duration
+    double achieved_rate;   // sent / seconds
+    uint64_t max_lag_ns;    // furthest the generator fell behind its schedule
+    latency_hist_t latency; // scheduled arrival to end of service, in nanoseconds
+} loadgen_report_t;
+
+// Runs the generator on the calling thread against num_consumers consumer threads and fills report
+// Returns 0, or -1 if the configuration is invalid (no rate, no duration, no buffer, no consumers, or bursty
+// without an on period)
+int loadgen_run(const loadgen_config_t* config, loadgen_report_t* report);
+
+// Prints rates, lag and the latency percentiles on a few lines prefixed by label
+void loadgen_report_print(FILE* file, const char* label, const loadgen_report_t* report);
+
+#endif // LOADGEN_H
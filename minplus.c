@@ -0,0 +1,145 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include "minplus.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MINPLUS_X86 1
+#else
+#define MINPLUS_X86 0
+#endif
+
+typedef bool (*relax_fn_t)(distance_t* dist, const distance_t* through, distance_t offset, size_t count);
+
+static const char* impl_names[] = {"scalar", "sse4.1", "avx2"};
+
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+static _Atomic(relax_fn_t) relax_fn;
+static atomic_int current_impl;
+
+static bool relax_scalar(distance_t* dist, const distance_t* through, distance_t offset, size_t count)
+{
+    bool changed = false;
+    for (size_t i = 0; i < count; i++) {
+        distance_t sum = offset + through[i];
+        if (sum < dist[i]) {
+            dist[i] = sum;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+#if MINPLUS_X86
+// The vector loops store every minimum, changed or not, OR together old XOR new to tell whether anything
+// shrank, and leave the last count % width entries to relax_scalar
+
+__attribute__((target("sse4.1")))
+static bool relax_sse41(distance_t* dist, const distance_t* through, distance_t offset, size_t count)
+{
+    __m128i offsets = _mm_set1_epi32((int)offset);
+    __m128i changed = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i old = _mm_loadu_si128((const __m128i*)&dist[i]);
+        __m128i sum = _mm_add_epi32(offsets, _mm_loadu_si128((const __m128i*)&through[i]));
+        __m128i best = _mm_min_epu32(old, sum);
+        changed = _mm_or_si128(changed, _mm_xor_si128(old, best));
+        _mm_storeu_si128((__m128i*)&dist[i], best);
+    }
+    bool tail_changed = relax_scalar(&dist[i], &through[i], offset, count - i);
+    return !_mm_testz_si128(changed, changed) || tail_changed;
+}
+
+__attribute__((target("avx2")))
+static bool relax_avx2(distance_t* dist, const distance_t* through, distance_t offset, size_t count)
+{
+    __m256i offsets = _mm256_set1_epi32((int)offset);
+    __m256i changed = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i old = _mm256_loadu_si256((const __m256i*)&dist[i]);
+        __m256i sum = _mm256_add_epi32(offsets, _mm256_loadu_si256((const __m256i*)&through[i]));
+        __m256i best = _mm256_min_epu32(old, sum);
+        changed = _mm256_or_si256(changed, _mm256_xor_si256(old, best));
+        _mm256_storeu_si256((__m256i*)&dist[i], best);
+    }
+    bool tail_changed = relax_scalar(&dist[i], &through[i], offset, count - i);
+    return !_mm256_testz_si256(changed, changed) || tail_changed;
+}
+#endif
+
+static bool supported(enum minplus_impl impl)
+{
+    switch (impl) {
+    case MINPLUS_SCALAR:
+        return true;
+#if MINPLUS_X86
+    case MINPLUS_SSE41:
+        return __builtin_cpu_supports("sse4.1");
+    case MINPLUS_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+static void set_impl(enum minplus_impl impl)
+{
+    relax_fn_t fn = relax_scalar;
+#if MINPLUS_X86
+    if (impl == MINPLUS_SSE41) {
+        fn = relax_sse41;
+    } else if (impl == MINPLUS_AVX2) {
+        fn = relax_avx2;
+    }
+#endif
+    atomic_store(&current_impl, (int)impl);
+    atomic_store(&relax_fn, fn);
+}
+
+static void detect(void)
+{
+#if MINPLUS_X86
+    __builtin_cpu_init();
+#endif
+    enum minplus_impl best = MINPLUS_SCALAR;
+    for (int impl = MINPLUS_SCALAR; impl < MINPLUS_IMPL_COUNT; impl++) {
+        if (supported((enum minplus_impl)impl)) {
+            best = (enum minplus_impl)impl;
+        }
+    }
+    set_impl(best);
+}
+
+bool minplus_relax(distance_t* dist, const distance_t* through, distance_t offset, size_t count)
+{
+    relax_fn_t fn = atomic_load_explicit(&relax_fn, memory_order_acquire);
+    if (fn == NULL) {
+        pthread_once(&detect_once, detect);
+        fn = atomic_load_explicit(&relax_fn, memory_order_acquire);
+    }
+    return fn(dist, through, offset, count);
+}
+
+enum minplus_impl minplus_current(void)
+{
+    pthread_once(&detect_once, detect);
+    return (enum minplus_impl)atomic_load(&current_impl);
+}
+
+int minplus_use(enum minplus_impl impl)
+{
+    pthread_once(&detect_once, detect);
+    if (impl >= MINPLUS_IMPL_COUNT || !supported(impl)) {
+        return -1;
+    }
+    set_impl(impl);
+    return 0;
+}
+
+const char* minplus_impl_name(enum minplus_impl impl)
+{
+    return impl < MINPLUS_IMPL_COUNT ? impl_names[impl] : "unknown";
+}
@@ -0,0 +1,34 @@
+#ifndef MINPLUS_H
+#define MINPLUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "apsp.h"
+
+// Min-plus relaxation, the inner loop of both the routers and Floyd-Warshall:
+//     dist[i] = min(dist[i], offset + through[i]) for i < count
+// As everywhere in apsp.h, offset and every distance must be at most inf_distance, so sums cannot wrap and
+// an unreachable entry can never replace a reachable one
+// Vector versions are picked at run time from what the CPU supports; all give the same results
+
+enum minplus_impl {
+    MINPLUS_SCALAR,
+    MINPLUS_SSE41, // 4 distances per instruction
+    MINPLUS_AVX2,  // 8 distances per instruction
+    MINPLUS_IMPL_COUNT,
+};
+
+// Relaxes dist through offset + through and returns whether any entry of dist shrank
+// dist and through may be the same array
+bool minplus_relax(distance_t* dist, const distance_t* through, distance_t offset, size_t count);
+
+// Returns the implementation minplus_relax uses, the widest one the CPU supports unless minplus_use chose
+enum minplus_impl minplus_current(void);
+
+// Makes minplus_relax use impl; returns 0, or -1 (changing nothing) if this CPU or build cannot run it
+int minplus_use(enum minplus_impl impl);
+
+// Returns "scalar", "sse4.1" or "avx2"
+const char* minplus_impl_name(enum minplus_impl impl);
+
+#endif // MINPLUS_H
@@ -0,0 +1,169 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "partition.h"
+
+// Border refinement stops after this many passes over the nodes even if moves are still being made
+#define REFINE_PASSES 8
+
+// Max-heap of (links into the growing part, node) keys; entries go stale when a node's count grows again or
+// it is assigned, and are skipped when they come out
+typedef struct {
+    uint64_t* keys;
+    size_t size;
+    size_t capacity;
+} heap_t;
+
+static inline uint64_t heap_key(uint32_t links, uint32_t node)
+{
+    // ties go to the lower node
+    return (uint64_t)links << 32 | (UINT32_MAX - node);
+}
+
+static void heap_push(heap_t* heap, uint64_t key)
+{
+    if (heap->size == heap->capacity) {
+        heap->capacity = heap->capacity > 0 ? heap->capacity * 2 : 64;
+        heap->keys = realloc(heap->keys, sizeof(uint64_t) * heap->capacity);
+        assert(heap->keys != NULL);
+    }
+    size_t i = heap->size++;
+    while (i > 0 && heap->keys[(i - 1) / 2] < key) {
+        heap->keys[i] = heap->keys[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->keys[i] = key;
+}
+
+static uint64_t heap_pop(heap_t* heap)
+{
+    uint64_t top = heap->keys[0];
+    uint64_t last = heap->keys[--heap->size];
+    size_t i = 0;
+    while (2 * i + 1 < heap->size) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < heap->size && heap->keys[child + 1] > heap->keys[child]) {
+            child++;
+        }
+        if (heap->keys[child] <= last) {
+            break;
+        }
+        heap->keys[i] = heap->keys[child];
+        i = child;
+    }
+    heap->keys[i] = last;
+    return top;
+}
+
+// Grows the parts one after another to exactly even sizes
+static void grow_parts(const topology_t* topology, size_t num_parts, uint32_t* part)
+{
+    size_t n = topology->num_nodes;
+    uint32_t* links_in = calloc(n, sizeof(uint32_t)); // links from each unassigned node into the growing part
+    assert(links_in != NULL);
+    heap_t heap = {NULL, 0, 0};
+    size_t next_seed = 0;
+    for (size_t p = 0; p < num_parts; p++) {
+        size_t target = n / num_parts + (p < n % num_parts ? 1 : 0);
+        heap.size = 0;
+        for (size_t size = 0; size < target; size++) {
+            uint32_t node = UINT32_MAX;
+            while (heap.size > 0) {
+                uint64_t key = heap_pop(&heap);
+                uint32_t candidate = UINT32_MAX - (uint32_t)key;
+                if (part[candidate] == UINT32_MAX && links_in[candidate] == key >> 32) {
+                    node = candidate;
+                    break;
+                }
+            }
+            if (node == UINT32_MAX) {
+                // the part's component has run out: start again from the lowest unassigned node
+                while (part[next_seed] != UINT32_MAX) {
+                    next_seed++;
+                }
+                node = (uint32_t)next_seed;
+            }
+            part[node] = (uint32_t)p;
+            for (size_t link = topology->offsets[node]; link < topology->offsets[node + 1]; link++) {
+                uint32_t neighbor = topology->targets[link];
+                if (part[neighbor] == UINT32_MAX) {
+                    heap_push(&heap, heap_key(++links_in[neighbor], neighbor));
+                }
+            }
+        }
+        // counts only ever refer to the part being grown
+        for (size_t i = 0; i < heap.size; i++) {
+            links_in[UINT32_MAX - (uint32_t)heap.keys[i]] = 0;
+        }
+    }
+    free(heap.keys);
+    free(links_in);
+}
+
+// Moves border nodes to the part most of their links go to while that lowers the cut
+static void refine_parts(const topology_t* topology, size_t num_parts, uint32_t* part)
+{
+    size_t n = topology->num_nodes;
+    size_t max_size = (n + num_parts - 1) / num_parts + n / num_parts / 16;
+    size_t* sizes = calloc(num_parts, sizeof(size_t));
+    uint32_t* counts = calloc(num_parts, sizeof(uint32_t)); // links from the node being looked at into each part
+    assert(sizes != NULL && counts != NULL);
+    for (size_t node = 0; node < n; node++) {
+        sizes[part[node]]++;
+    }
+    for (size_t pass = 0; pass < REFINE_PASSES; pass++) {
+        bool moved = false;
+        for (size_t node = 0; node < n; node++) {
+            uint32_t own = part[node];
+            uint32_t best = own;
+            for (size_t link = topology->offsets[node]; link < topology->offsets[node + 1]; link++) {
+                counts[part[topology->targets[link]]]++;
+            }
+            for (size_t link = topology->offsets[node]; link < topology->offsets[node + 1]; link++) {
+                uint32_t other = part[topology->targets[link]];
+                if (other != own && sizes[other] < max_size && (best == own || counts[other] > counts[best])) {
+                    best = other;
+                }
+            }
+            if (best != own && counts[best] > counts[own] && sizes[own] > 1) {
+                part[node] = best;
+                sizes[own]--;
+                sizes[best]++;
+                moved = true;
+            }
+            for (size_t link = topology->offsets[node]; link < topology->offsets[node + 1]; link++) {
+                counts[part[topology->targets[link]]] = 0;
+            }
+        }
+        if (!moved) {
+            break;
+        }
+    }
+    free(counts);
+    free(sizes);
+}
+
+size_t partition_topology(const topology_t* topology, size_t num_parts, uint32_t* part)
+{
+    size_t n = topology->num_nodes;
+    assert(num_parts > 0 && num_parts <= n);
+    for (size_t node = 0; node < n; node++) {
+        part[node] = UINT32_MAX;
+    }
+    grow_parts(topology, num_parts, part);
+    if (num_parts > 1) {
+        refine_parts(topology, num_parts, part);
+    }
+    return partition_cut(topology, part);
+}
+
+size_t partition_cut(const topology_t* topology, const uint32_t* part)
+{
+    size_t cut = 0;
+    for (size_t node = 0; node < topology->num_nodes; node++) {
+        for (size_t link = topology->offsets[node]; link < topology->offsets[node + 1]; link++) {
+            cut += part[topology->targets[link]] != part[node];
+        }
+    }
+    return cut;
+}
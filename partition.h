@@ -0,0 +1,18 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "topology.h"
+
+// Splits the nodes of topology into num_parts nonempty parts with few links between them: parts are grown
+// one at a time to an even split, each taking the unassigned node with the most links into it next, then
+// nodes on the borders move to the part most of their links go to while that cuts more links than it adds
+// and leaves no part more than 1/16 above ceil(num_nodes / num_parts)
+// part receives the part of each node; returns the number of directed links between different parts
+size_t partition_topology(const topology_t* topology, size_t num_parts, uint32_t* part);
+
+// Returns the number of directed links of topology between nodes in different parts
+size_t partition_cut(const topology_t* topology, const uint32_t* part);
+
+#endif // PARTITION_H
@@ -0,0 +1,324 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include "pipeline.h"
+
+enum pipeline_stage_kind {
+    STAGE_MAP,
+    STAGE_FILTER,
+    STAGE_FAN_OUT,
+    STAGE_FAN_IN,
+};
+
+struct pipeline_stage {
+    enum pipeline_stage_kind kind;
+    // map/filter/fan_out read from ins[0], fan_in reads from all of ins
+    channel_t** ins;
+    size_t num_ins;
+    // map/filter/fan_in write to outs[0], fan_out writes to all of outs
+    channel_t** outs;
+    size_t num_outs;
+    pipeline_map_fn map;
+    pipeline_filter_fn filter;
+    pipeline_release_fn release;
+    void* arg;
+    enum fan_out_policy policy;
+    pthread_t* workers;
+    size_t num_workers;
+    // workers that have not exited yet, the last one out closes the outputs or forwards PIPELINE_END
+    atomic_size_t live_workers;
+};
+
+static char end_marker;
+void* const PIPELINE_END = &end_marker;
+
+// Closes a channel that may already have been closed by someone else
+static void close_quietly(channel_t* channel)
+{
+    enum channel_status status = channel_close(channel);
+    assert(status == SUCCESS || status == CLOSED_ERROR);
+    (void)status;
+}
+
+// Sends to a channel that may already have been closed by someone else
+static void send_quietly(channel_t* channel, void* data)
+{
+    enum channel_status status = channel_send(channel, data);
+    assert(status == SUCCESS || status == CLOSED_ERROR);
+    (void)status;
+}
+
+// Hands messages the stage could not deliver to its release function
+static void stage_release(pipeline_stage_t* stage, void** data, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (stage->release != NULL && data[i] != PIPELINE_END) {
+            stage->release(data[i], stage->arg);
+        }
+    }
+}
+
+// ended tells whether the worker stopped on PIPELINE_END rather than a closed channel
+// A worker that saw the marker but is not the last one out puts it back into the input for the next
+// worker; everything a worker received before the marker has been sent by the time it gets here, so the
+// last worker can forward the marker knowing nothing is still in flight inside the stage
+static void stage_worker_exit(pipeline_stage_t* stage, bool ended)
+{
+    if (atomic_fetch_sub(&stage->live_workers, 1) == 1) {
+        for (size_t i = 0; i < stage->num_outs; i++) {
+            if (ended) {
+                send_quietly(stage->outs[i], PIPELINE_END);
+            } else {
+                close_quietly(stage->outs[i]);
+            }
+        }
+    } else if (ended) {
+        send_quietly(stage->ins[0], PIPELINE_END);
+    }
+}
+
+// Output went away underneath us: stop the input too so the stages feeding us shut down
+static void stage_abort_upstream(pipeline_stage_t* stage)
+{
+    for (size_t i = 0; i < stage->num_ins; i++) {
+        close_quietly(stage->ins[i]);
+    }
+}
+
+static void* map_filter_worker(void* arg)
+{
+    pipeline_stage_t* stage = arg;
+    void* batch[PIPELINE_BATCH_SIZE];
+    bool ended = false;
+    while (!ended) {
+        size_t count = 0;
+        if (channel_receive_batch(stage->ins[0], batch, PIPELINE_BATCH_SIZE, &count) != SUCCESS) {
+            break;
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (batch[i] == PIPELINE_END) {
+                // nothing is sent after the marker, so it is the last message of the batch
+                ended = true;
+            } else if (stage->kind == STAGE_MAP) {
+                batch[kept++] = stage->map(batch[i], stage->arg);
+            } else if (stage->filter(batch[i], stage->arg)) {
+                batch[kept++] = batch[i];
+            } else {
+                stage_release(stage, &batch[i], 1);
+            }
+        }
+        size_t sent = 0;
+        if (kept > 0 && channel_send_batch(stage->outs[0], batch, kept, &sent) != SUCCESS) {
+            stage_release(stage, &batch[sent], kept - sent);
+            stage_abort_upstream(stage);
+            ended = false;
+            break;
+        }
+    }
+    stage_worker_exit(stage, ended);
+    return NULL;
+}
+
+static void* fan_out_worker(void* arg)
+{
+    pipeline_stage_t* stage = arg;
+    void* batch[PIPELINE_BATCH_SIZE];
+    select_t* select_list = malloc(sizeof(select_t) * stage->num_outs);
+    assert(select_list != NULL);
+    for (size_t i = 0; i < stage->num_outs; i++) {
+        select_list[i].channel = stage->outs[i];
+        select_list[i].dir = SEND;
+    }
+    size_t next = 0;
+    bool running = true;
+    bool ended = false;
+    while (running && !ended) {
+        size_t count = 0;
+        if (channel_receive_batch(stage->ins[0], batch, PIPELINE_BATCH_SIZE, &count) != SUCCESS) {
+            break;
+        }
+        for (size_t i = 0; i < count && running && !ended; i++) {
+            enum channel_status status = SUCCESS;
+            size_t delivered = 0;
+            if (batch[i] == PIPELINE_END) {
+                ended = true;
+            } else if (stage->policy == FAN_OUT_ROUND_ROBIN) {
+                status = channel_send(stage->outs[next], batch[i]);
+                next = (next + 1) % stage->num_outs;
+            } else if (stage->policy == FAN_OUT_BROADCAST) {
+                for (size_t out = 0; out < stage->num_outs && status == SUCCESS; out++) {
+                    status = channel_send(stage->outs[out], batch[i]);
+                    delivered += status == SUCCESS;
+                }
+            } else {
+                size_t selected_index;
+                for (size_t out = 0; out < stage->num_outs; out++) {
+                    select_list[out].data = batch[i];
+                }
+                status = channel_select(select_list, stage->num_outs, &selected_index);
+            }
+            if (status != SUCCESS) {
+                // a broadcast message that reached some outputs is theirs now
+                size_t first = delivered == 0 ? i : i + 1;
+                stage_release(stage, &batch[first], count - first);
+                stage_abort_upstream(stage);
+                running = false;
+            }
+        }
+    }
+    free(select_list);
+    stage_worker_exit(stage, running && ended);
+    return NULL;
+}
+
+static void* fan_in_worker(void* arg)
+{
+    pipeline_stage_t* stage = arg;
+    void* batch[PIPELINE_BATCH_SIZE];
+    select_t* select_list = malloc(sizeof(select_t) * stage->num_ins);
+    assert(select_list != NULL);
+    for (size_t i = 0; i < stage->num_ins; i++) {
+        select_list[i].channel = stage->ins[i];
+        select_list[i].dir = RECV;
+        select_list[i].data = NULL;
+    }
+    size_t select_count = stage->num_ins;
+    size_t ended = 0;
+    bool running = true;
+    while (running && select_count > 0) {
+        size_t selected_index;
+        enum channel_status status = channel_select(select_list, select_count, &selected_index);
+        bool input_done = status != SUCCESS;
+        size_t count = 0;
+        if (!input_done) {
+            // pick up whatever else that input already has buffered, up to its end marker
+            void* data = select_list[selected_index].data;
+            while (true) {
+                if (data == PIPELINE_END) {
+                    input_done = true;
+                    ended++;
+                    break;
+                }
+                batch[count++] = data;
+                if (count == PIPELINE_BATCH_SIZE ||
+                    channel_non_blocking_receive(select_list[selected_index].channel, &data) != SUCCESS) {
+                    break;
+                }
+            }
+        }
+        size_t sent = 0;
+        if (count > 0 && channel_send_batch(stage->outs[0], batch, count, &sent) != SUCCESS) {
+            stage_release(stage, &batch[sent], count - sent);
+            stage_abort_upstream(stage);
+            running = false;
+        } else if (input_done) {
+            // input closed or ended: drop it from the select by swapping in the last entry
+            select_count--;
+            select_list[selected_index] = select_list[select_count];
+        }
+    }
+    free(select_list);
+    // an input that was closed rather than ended may have lost messages, so only a clean end is forwarded
+    stage_worker_exit(stage, running && ended == stage->num_ins);
+    return NULL;
+}
+
+static pipeline_stage_t* stage_create(enum pipeline_stage_kind kind, channel_t** ins, size_t num_ins,
+                                      channel_t** outs, size_t num_outs, size_t workers)
+{
+    pipeline_stage_t* stage = malloc(sizeof(pipeline_stage_t));
+    assert(stage != NULL);
+    stage->kind = kind;
+    stage->ins = malloc(sizeof(channel_t*) * num_ins);
+    assert(stage->ins != NULL);
+    memcpy(stage->ins, ins, sizeof(channel_t*) * num_ins);
+    stage->num_ins = num_ins;
+    stage->outs = malloc(sizeof(channel_t*) * num_outs);
+    assert(stage->outs != NULL);
+    memcpy(stage->outs, outs, sizeof(channel_t*) * num_outs);
+    stage->num_outs = num_outs;
+    stage->map = NULL;
+    stage->filter = NULL;
+    stage->release = NULL;
+    stage->arg = NULL;
+    stage->policy = FAN_OUT_ROUND_ROBIN;
+    stage->workers = malloc(sizeof(pthread_t) * workers);
+    assert(stage->workers != NULL);
+    stage->num_workers = workers;
+    atomic_init(&stage->live_workers, workers);
+    return stage;
+}
+
+static void stage_start(pipeline_stage_t* stage, void* (*worker)(void*))
+{
+    for (size_t i = 0; i < stage->num_workers; i++) {
+        int pthread_status = pthread_create(&stage->workers[i], NULL, worker, stage);
+        assert(pthread_status == 0);
+        (void)pthread_status;
+    }
+}
+
+pipeline_stage_t* pipeline_map(channel_t* in, channel_t* out, pipeline_map_fn fn, pipeline_release_fn release,
+                               void* arg, size_t workers)
+{
+    if (in == NULL || out == NULL || fn == NULL || workers == 0) {
+        return NULL;
+    }
+    pipeline_stage_t* stage = stage_create(STAGE_MAP, &in, 1, &out, 1, workers);
+    stage->map = fn;
+    stage->release = release;
+    stage->arg = arg;
+    stage_start(stage, map_filter_worker);
+    return stage;
+}
+
+pipeline_stage_t* pipeline_filter(channel_t* in, channel_t* out, pipeline_filter_fn fn, pipeline_release_fn release,
+                                  void* arg, size_t workers)
+{
+    if (in == NULL || out == NULL || fn == NULL || workers == 0) {
+        return NULL;
+    }
+    pipeline_stage_t* stage = stage_create(STAGE_FILTER, &in, 1, &out, 1, workers);
+    stage->filter = fn;
+    stage->release = release;
+    stage->arg = arg;
+    stage_start(stage, map_filter_worker);
+    return stage;
+}
+
+pipeline_stage_t* fan_out(channel_t* in, channel_t** outs, size_t count, enum fan_out_policy policy,
+                          pipeline_release_fn release, void* arg)
+{
+    if (in == NULL || outs == NULL || count == 0) {
+        return NULL;
+    }
+    pipeline_stage_t* stage = stage_create(STAGE_FAN_OUT, &in, 1, outs, count, 1);
+    stage->policy = policy;
+    stage->release = release;
+    stage->arg = arg;
+    stage_start(stage, fan_out_worker);
+    return stage;
+}
+
+pipeline_stage_t* fan_in(channel_t** ins, size_t count, channel_t* out, pipeline_release_fn release, void* arg)
+{
+    if (ins == NULL || count == 0 || out == NULL) {
+        return NULL;
+    }
+    pipeline_stage_t* stage = stage_create(STAGE_FAN_IN, ins, count, &out, 1, 1);
+    stage->release = release;
+    stage->arg = arg;
+    stage_start(stage, fan_in_worker);
+    return stage;
+}
+
+void pipeline_stage_join(pipeline_stage_t* stage)
+{
+    for (size_t i = 0; i < stage->num_workers; i++) {
+        pthread_join(stage->workers[i], NULL);
+    }
+    free(stage->workers);
+    free(stage->ins);
+    free(stage->outs);
+    free(stage);
+}
@@ -0,0 +1,76 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "channel.h"
+
+// Number of messages a stage worker moves per channel operation
+#define PIPELINE_BATCH_SIZE 32
+
+// Transforms one message into the message forwarded downstream
+typedef void* (*pipeline_map_fn)(void* data, void* arg);
+
+// Returns true if the message should be forwarded downstream
+// Rejected messages are handed to the stage's release function
+typedef bool (*pipeline_filter_fn)(void* data, void* arg);
+
+// Releases a message the stage drops: one rejected by a filter, or one it could not deliver because its
+// output was closed
+// May be NULL if messages own nothing that needs releasing
+typedef void (*pipeline_release_fn)(void* data, void* arg);
+
+// End-of-stream marker; never passed to map, filter or release functions
+// Sending it into the head of a pipeline after the last message shuts the pipeline down without losing
+// anything: each stage forwards every message it received before the marker and then the marker itself,
+// so the marker comes out of the tail after everything else
+extern void* const PIPELINE_END;
+
+// Defines how fan_out distributes messages over its output channels
+enum fan_out_policy {
+    FAN_OUT_ROUND_ROBIN, // each message goes to the next output in turn
+    FAN_OUT_BROADCAST,   // each message (the same pointer) goes to every output
+    FAN_OUT_FIRST_READY, // each message goes to whichever output has room first
+};
+
+// Handle for a running stage and its worker threads
+typedef struct pipeline_stage pipeline_stage_t;
+
+// Every stage runs until its input is closed or it receives PIPELINE_END
+// On close the last worker to exit closes the stage's output(s), so closing the head of a pipeline shuts
+// down every stage after it; as with channel_close, messages still buffered in a channel are not delivered
+// On PIPELINE_END the last worker forwards the marker instead, leaving the channels open for the caller
+// If an output is closed first, the stage closes its input as well so upstream stages stop too
+// Stages with more than one worker do not preserve message order
+
+// Starts workers threads that receive from in, apply fn and send the result to out
+// fn, release and arg are shared by all workers; release gets fn's result for messages that could not be sent
+// Returns NULL on invalid arguments
+pipeline_stage_t* pipeline_map(channel_t* in, channel_t* out, pipeline_map_fn fn, pipeline_release_fn release,
+                               void* arg, size_t workers);
+
+// Starts workers threads that forward messages from in to out for which fn returns true
+// Returns NULL on invalid arguments
+pipeline_stage_t* pipeline_filter(channel_t* in, channel_t* out, pipeline_filter_fn fn, pipeline_release_fn release,
+                                  void* arg, size_t workers);
+
+// Starts a thread that distributes messages from in over the count channels in outs according to policy
+// PIPELINE_END is forwarded to every output whatever the policy
+// A broadcast message is only released if no output received it
+// outs is copied, so the caller may release it after the call
+// Returns NULL on invalid arguments
+pipeline_stage_t* fan_out(channel_t* in, channel_t** outs, size_t count, enum fan_out_policy policy,
+                          pipeline_release_fn release, void* arg);
+
+// Starts a thread that merges messages from the count channels in ins into out
+// out is closed once every input has been closed, and gets PIPELINE_END once every input has sent it
+// ins is copied, so the caller may release it after the call
+// Returns NULL on invalid arguments
+pipeline_stage_t* fan_in(channel_t** ins, size_t count, channel_t* out, pipeline_release_fn release, void* arg);
+
+// Waits for all workers of the stage to exit and frees the stage
+// Does not close or destroy any channel; call it after closing the pipeline's input or after PIPELINE_END
+// came out of its tail
+void pipeline_stage_join(pipeline_stage_t* stage);
+
+#endif // PIPELINE_H
@@ -2,31 +2,121 @@
 #include <pthread.h>
 #include <assert.h>
 #include <stdio.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "apsp.h"
 #include "channel.h"
+#include "minplus.h"
+#include "partition.h"
 #include "stress.h"
+#include "timer.h"
+#include "topology.h"
+
+// Deltas of more than num_channel / DELTA_MAX_FRACTION entries are broadcast as the whole vector instead,
+// which receivers relax with one minplus_relax rather than one scattered entry at a time
+#define DELTA_MAX_FRACTION 8
+#define DELTA_FULL SIZE_MAX
 
-typedef unsigned int distance_t;
 typedef struct {
     size_t src;
     size_t epoch;
+    size_t generation; // how many times the routers have started over, see control_t
+    // the entries of dist that shrank since the previous broadcast, or DELTA_FULL to relax through all of dist
+    // distances only ever shrink and every neighbor receives every broadcast in order, so relaxing through
+    // the changed entries alone gives the same result as relaxing through the whole vector
+    size_t num_changed;
+    uint32_t* changed;
     distance_t dist[0];
 } distance_vector_t;
 
-static const distance_t inf_distance = 0x7fffffff;
-static distance_t* topology;
+// Messages from run_stress_config rather than from a neighbor, told apart from distance vectors by src
+// A link update is sent to the routers at both of its ends, and only once both have the new cost and gone
+// quiet are they sent what to do about it: a cheaper link takes CONTROL_BROADCAST to both, so each relaxes all
+// of the other's distances through it; a dearer one takes CONTROL_RESET to every router, to start over from
+// its links in the next generation, since distances only ever shrink within one
+// Vectors from an older generation never arrive, as the routers are quiet whenever a new one starts
+#define CONTROL_SRC SIZE_MAX
+
+enum control_kind {
+    CONTROL_LINK,      // the link from the router to neighbor now costs cost
+    CONTROL_BROADCAST, // broadcast the whole vector
+    CONTROL_RESET,     // start over in generation, unless a neighbor's vector already made the router do so
+};
+
+typedef struct {
+    size_t src; // CONTROL_SRC
+    enum control_kind kind;
+    size_t neighbor;
+    distance_t cost;
+    size_t generation;
+} control_t;
+
+// What each router did, written by the router as it exits
+typedef struct {
+    uint64_t messages; // distance vectors sent
+    uint64_t deltas;   // those of them sent as deltas
+    uint64_t local;    // those of them relaxed through by a router on the same worker, without a channel
+    uint64_t entries;  // distances relaxed through from received vectors
+    uint64_t selects;  // channel_select calls, made by the worker instead when routers share one
+} router_stats_t;
+
+// One router's distance vectors, in whichever thread runs it
+typedef struct {
+    size_t index;
+    bool changed; // next_state has shrunk since curr_state was made the one to broadcast
+    bool rescan;  // a whole vector was relaxed through, so next's changes are found by comparing with curr
+    bool full;    // next must be broadcast whole, since a link changed or the router started over
+    size_t generation;
+    distance_t* costs; // the current costs of its links, in topology order
+    distance_vector_t* curr_state;
+    distance_vector_t* next_state;
+    distance_vector_t** history; // the num_history vectors broadcast before curr_state, oldest first from oldest
+    size_t oldest;
+    router_stats_t stats;
+    // with workers: the neighbors on other workers, the first num_unsent of them not yet sent curr_state
+    uint32_t* remote;
+    size_t num_remote;
+    size_t num_unsent;
+    bool queued; // in its worker's ready queue
+} router_t;
+
+// A thread running several routers
+typedef struct {
+    uint32_t id;
+    size_t num_routers;
+    const uint32_t* members; // the routers' indexes
+    router_t* routers;
+    router_t** ready;        // routers with changes and nothing left to send, to broadcast next
+    size_t num_ready;
+    uint64_t selects;
+} worker_t;
+
+static topology_t* topology;
 static distance_t* solution;
 static size_t num_channel;
 static channel_t** channels;
 static channel_t* done_channel;
 static channel_t* completed_channel;
+static size_t delta_capacity; // most entries a delta may carry
+// A neighbor's channel holds at most main_buffer_size of a router's vectors, and the neighbor relaxes through
+// one more it took out before them; a router only starts writing a vector again once it has finished sending
+// main_buffer_size + 1 newer ones, so none of those can still be read
+static size_t num_history;
+// Termination detection by message counting: distance vectors broadcast but not yet relaxed through by their
+// receiver, plus routers holding changes they have not broadcast yet
+// Both are counted before the events that end them can happen, so this reaches 0 only once the routers have
+// converged and nothing is left in flight, and then stays there
+static atomic_size_t pending;
+static router_stats_t* router_stats;
+// with workers: each router's worker
+static uint32_t* placement;
+// where each router is kept, on its thread's stack or in its worker's array, for checking between updates
+static router_t** router_table;
 
 distance_t get_link_distance(size_t src, size_t dst) {
-    return topology[src * num_channel + dst];
-}
-
-void set_link_distance(size_t src, size_t dst, distance_t distance) {
-    topology[src * num_channel + dst] = distance;
+    return topology_link(topology, src, dst);
 }
 
 distance_t get_solution_distance(size_t src, size_t dst) {
@@ -39,16 +129,8 @@ void set_solution_distance(size_t src, size_t dst, distance_t distance) {
 
 void floyd_warshall()
 {
-    memcpy(solution, topology, sizeof(distance_t) * num_channel * num_channel);
-    for (size_t intermediate = 0; intermediate < num_channel; intermediate++) {
-        for (size_t src = 0; src < num_channel; src++) {
-            for (size_t dst = 0; dst < num_channel; dst++) {
-                if (get_solution_distance(src, intermediate) + get_solution_distance(intermediate, dst) < get_solution_distance(src, dst)) {
-                    set_solution_distance(src, dst, get_solution_distance(src, intermediate) + get_solution_distance(intermediate, dst));
-                }
-            }
-        }
-    }
+    topology_to_matrix(topology, solution);
+    apsp_floyd_warshall(solution, num_channel, 0);
 }
 
 void print_graph()
@@ -85,76 +167,282 @@ void print_solution()
 
 bool create_topology(const char* filename)
 {
-    FILE* file = fopen(filename, "r");
-    if (file == NULL) {
+    topology = topology_load(filename, 0);
+    if (topology == NULL) {
         printf("Could not open topology file: %s\n", filename);
         return false;
     }
-    int num_scanned = fscanf(file, "%zu", &num_channel);
-    assert(num_scanned == 1);
-    assert(num_channel > 0);
-    topology = malloc(sizeof(distance_t) * num_channel * num_channel);
-    assert(topology != NULL);
+    num_channel = topology->num_nodes;
     solution = malloc(sizeof(distance_t) * num_channel * num_channel);
     assert(solution != NULL);
-    // populate topology
-    for (size_t src = 0; src < num_channel; src++) {
-        for (size_t dst = 0; dst < num_channel; dst++) {
-            distance_t distance;
-            num_scanned = fscanf(file, "%d", (int*)&distance);
-            assert(num_scanned == 1);
-            // negative values get converted to inf_distance
-            if (distance > inf_distance) {
-                distance = inf_distance;
-            }
-            set_link_distance(src, dst, distance);
-        }
+    if (topology->solution != NULL) {
+        // binary topologies can carry the solution, computed when they were converted
+        memcpy(solution, topology->solution, sizeof(distance_t) * num_channel * num_channel);
+    } else {
+        // calculate solution using Floyd-Warshall algorithm
+        floyd_warshall();
     }
-    fclose(file);
-    // calculate solution using Floyd-Warshall algorithm
-    floyd_warshall();
     return true;
 }
 
 void destroy_topology()
 {
-    free(topology);
+    topology_free(topology);
     free(solution);
 }
 
-void* router(void* arg)
+static distance_vector_t* create_state(size_t index, size_t epoch)
 {
-    bool changed = false;
-    size_t index = (size_t)arg;
-    size_t selected_index;
-    distance_vector_t* prev_prev_state = malloc(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel);
-    assert(prev_prev_state != NULL);
-    distance_vector_t* prev_state = malloc(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel);
-    assert(prev_state != NULL);
-    distance_vector_t* curr_state = malloc(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel);
-    assert(curr_state != NULL);
-    distance_vector_t* next_state = malloc(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel);
-    assert(next_state != NULL);
-    prev_prev_state->src = index;
-    prev_state->src = index;
-    curr_state->src = index;
-    next_state->src = index;
-    prev_prev_state->epoch = 0;
-    prev_state->epoch = 1;
-    curr_state->epoch = 2;
-    next_state->epoch = 3;
-    for (size_t i = 0; i < num_channel; i++) {
-        prev_prev_state->dist[i] = get_link_distance(index, i);
-        prev_state->dist[i] = get_link_distance(index, i);
-        curr_state->dist[i] = get_link_distance(index, i);
-        next_state->dist[i] = get_link_distance(index, i);
+    distance_vector_t* state = malloc(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel);
+    assert(state != NULL);
+    state->src = index;
+    state->epoch = epoch;
+    state->generation = 0;
+    state->num_changed = 0;
+    state->changed = malloc(sizeof(uint32_t) * (delta_capacity > 0 ? delta_capacity : 1));
+    assert(state->changed != NULL);
+    return state;
+}
+
+static void destroy_state(distance_vector_t* state)
+{
+    free(state->changed);
+    free(state);
+}
+
+// Adds entry i to the delta of next, which turns into the whole vector once it would be too long
+static inline void append_change(distance_vector_t* next, size_t i)
+{
+    if (next->num_changed == delta_capacity) {
+        next->num_changed = DELTA_FULL;
+    } else {
+        next->changed[next->num_changed++] = (uint32_t)i;
     }
-    size_t total_select_count = 2;
+}
+
+// Records that entry i of next is about to shrink, unless it already had since next started as a copy of curr
+static inline void record_change(distance_vector_t* next, const distance_vector_t* curr, size_t i)
+{
+    if (next->num_changed != DELTA_FULL && next->dist[i] == curr->dist[i]) {
+        append_change(next, i);
+    }
+}
+
+// Ends one unit of pending work, telling run_stress if it was the last
+static void finish_pending(void)
+{
+    if (atomic_fetch_sub(&pending, 1) == 1) {
+        enum channel_status status = channel_send(completed_channel, NULL);
+        assert(status == SUCCESS);
+        (void)status;
+    }
+}
+
+// Fills dist with the router's links alone, as in its first vector of each generation
+static void router_links(const router_t* router, distance_t* dist)
+{
     for (size_t i = 0; i < num_channel; i++) {
-        if ((i != index) && get_link_distance(index, i) != inf_distance) {
-            total_select_count++;
+        dist[i] = inf_distance;
+    }
+    dist[router->index] = 0;
+    size_t first = topology->offsets[router->index];
+    for (size_t link = first; link < topology->offsets[router->index + 1]; link++) {
+        dist[topology->targets[link]] = router->costs[link - first];
+    }
+}
+
+static void router_init(router_t* router, size_t index)
+{
+    router->index = index;
+    router->changed = false;
+    router->rescan = false;
+    router->full = false;
+    router->generation = 0;
+    size_t degree = topology_degree(topology, index);
+    router->costs = malloc(sizeof(distance_t) * (degree > 0 ? degree : 1));
+    assert(router->costs != NULL);
+    memcpy(router->costs, &topology->costs[topology->offsets[index]], sizeof(distance_t) * degree);
+    router->history = malloc(sizeof(distance_vector_t*) * num_history);
+    assert(router->history != NULL);
+    for (size_t i = 0; i < num_history; i++) {
+        router->history[i] = create_state(index, i);
+    }
+    router->oldest = 0;
+    router->curr_state = create_state(index, num_history);
+    router->next_state = create_state(index, num_history + 1);
+    // start from the links leaving this router, straight from its row of the topology
+    distance_vector_t* next_state = router->next_state;
+    router_links(router, next_state->dist);
+    memcpy(router->curr_state->dist, next_state->dist, sizeof(distance_t) * num_channel);
+    router->curr_state->num_changed = DELTA_FULL;
+    memset(&router->stats, 0, sizeof(router->stats));
+}
+
+// Returns the current cost of the link from the router to neighbor
+static distance_t router_cost(const router_t* router, size_t neighbor)
+{
+    size_t link = topology_find(topology, router->index, neighbor);
+    assert(link != SIZE_MAX);
+    return router->costs[link - topology->offsets[router->index]];
+}
+
+// Throws the router's distances away for its links alone, in a newer generation
+static void router_restart(router_t* router, size_t generation)
+{
+    assert(generation > router->generation);
+    router->generation = generation;
+    router_links(router, router->next_state->dist);
+    router->full = true;
+    router->rescan = false;
+    if (!router->changed) {
+        router->changed = true;
+        atomic_fetch_add(&pending, 1);
+    }
+}
+
+// Relaxes the router's next vector through a neighbor's broadcast
+static void router_receive(router_t* router, const distance_vector_t* neighbor_state)
+{
+    if (neighbor_state->generation > router->generation) {
+        // the neighbor got its CONTROL_RESET first
+        router_restart(router, neighbor_state->generation);
+    }
+    assert(neighbor_state->generation == router->generation);
+    distance_t neighbor_dist = router_cost(router, neighbor_state->src);
+    if (neighbor_dist == inf_distance) {
+        // the link is down, or not up yet
+        finish_pending();
+        return;
+    }
+    bool was_changed = router->changed;
+    distance_vector_t* next_state = router->next_state;
+    if (neighbor_state->num_changed == DELTA_FULL) {
+        router->stats.entries += num_channel;
+        if (minplus_relax(next_state->dist, neighbor_state->dist, neighbor_dist, num_channel)) {
+            router->changed = true;
+            router->rescan = true;
+        }
+    } else {
+        router->stats.entries += neighbor_state->num_changed;
+        for (size_t k = 0; k < neighbor_state->num_changed; k++) {
+            size_t i = neighbor_state->changed[k];
+            distance_t through = neighbor_dist + neighbor_state->dist[i];
+            if (through < next_state->dist[i]) {
+                if (!router->rescan) {
+                    record_change(next_state, router->curr_state, i);
+                }
+                next_state->dist[i] = through;
+                router->changed = true;
+            }
+        }
+    }
+    if (router->changed && !was_changed) {
+        // this router now owes its neighbors a broadcast
+        atomic_fetch_add(&pending, 1);
+    }
+    finish_pending();
+}
+
+// Applies a message from run_stress_config
+static void router_control(router_t* router, const control_t* control)
+{
+    if (control->kind == CONTROL_LINK) {
+        size_t link = topology_find(topology, router->index, control->neighbor);
+        assert(link != SIZE_MAX);
+        router->costs[link - topology->offsets[router->index]] = control->cost;
+    } else if (control->kind == CONTROL_BROADCAST) {
+        router->full = true;
+        if (!router->changed) {
+            router->changed = true;
+            atomic_fetch_add(&pending, 1);
         }
+    } else if (control->generation > router->generation) {
+        router_restart(router, control->generation);
     }
+    finish_pending();
+}
+
+// Handles whatever arrived on the router's channel
+static void router_message(router_t* router, const void* message)
+{
+    if (((const distance_vector_t*)message)->src == CONTROL_SRC) {
+        router_control(router, message);
+    } else {
+        router_receive(router, message);
+    }
+}
+
+// Makes the changed next vector the one to broadcast, once the previous broadcast has gone to every neighbor
+static void router_cycle(router_t* router)
+{
+    assert(router->changed);
+    distance_vector_t* next_state = router->next_state;
+    if (router->full) {
+        next_state->num_changed = DELTA_FULL;
+        router->full = false;
+        router->rescan = false;
+    } else if (router->rescan) {
+        next_state->num_changed = 0;
+        for (size_t i = 0; i < num_channel && next_state->num_changed != DELTA_FULL; i++) {
+            if (next_state->dist[i] != router->curr_state->dist[i]) {
+                append_change(next_state, i);
+            }
+        }
+        router->rescan = false;
+    }
+    next_state->generation = router->generation;
+    // the oldest vector in the history is free to write again
+    router->next_state = router->history[router->oldest];
+    router->history[router->oldest] = router->curr_state;
+    router->oldest = (router->oldest + 1) % num_history;
+    router->curr_state = next_state;
+    router->next_state->epoch = router->curr_state->epoch + 1;
+    router->next_state->num_changed = 0;
+    memcpy(router->next_state->dist, router->curr_state->dist, sizeof(distance_t) * num_channel);
+    router->changed = false;
+    atomic_fetch_add(&pending, topology_degree(topology, router->index));
+    finish_pending();
+}
+
+// Counts one send of the router's current vector
+static inline void router_sent(router_t* router)
+{
+    router->stats.messages++;
+    router->stats.deltas += router->curr_state->num_changed != DELTA_FULL;
+}
+
+// Checks that the router has converged to the solution
+static void router_check(const router_t* router)
+{
+    assert(router->changed == false);
+    for (size_t dst = 0; dst < num_channel; dst++) {
+        assert(router->curr_state->dist[dst] == get_solution_distance(router->index, dst));
+    }
+}
+
+// Checks the converged router against the solution and frees it
+static void router_finish(router_t* router)
+{
+    router_check(router);
+    router_stats[router->index] = router->stats;
+    for (size_t i = 0; i < num_history; i++) {
+        destroy_state(router->history[i]);
+    }
+    free(router->history);
+    destroy_state(router->curr_state);
+    destroy_state(router->next_state);
+    free(router->costs);
+}
+
+// One thread per router, broadcasting to each neighbor's channel
+void* router(void* arg)
+{
+    router_t self;
+    router_init(&self, (size_t)arg);
+    size_t index = self.index;
+    router_table[index] = &self;
+    size_t selected_index;
+    size_t total_select_count = 2 + topology_degree(topology, index);
     select_t* select_list = malloc(sizeof(select_t) * total_select_count);
     assert(select_list != NULL);
     size_t select_count = 0;
@@ -166,38 +454,23 @@ void* router(void* arg)
     select_list[select_count].dir = RECV;
     select_list[select_count].data = NULL;
     select_count++;
-    for (size_t i = 0; i < num_channel; i++) {
-        if ((i != index) && get_link_distance(index, i) != inf_distance) {
-            select_list[select_count].channel = channels[i];
-            select_list[select_count].dir = SEND;
-            select_list[select_count].data = curr_state;
-            select_count++;
-        }
+    for (size_t link = topology->offsets[index]; link < topology->offsets[index + 1]; link++) {
+        select_list[select_count].channel = channels[topology->targets[link]];
+        select_list[select_count].dir = SEND;
+        select_list[select_count].data = self.curr_state;
+        select_count++;
     }
     while (true) {
         enum channel_status status = channel_select(select_list, select_count, &selected_index);
+        self.stats.selects++;
         if (status == SUCCESS) {
             assert(selected_index != 0);
             if (selected_index == 1) {
-                if (select_list[selected_index].data) {
-                    // update next_state with new data
-                    distance_vector_t* neighbor_state = select_list[selected_index].data;
-                    distance_t neighbor_dist = get_link_distance(index, neighbor_state->src);
-                    assert(neighbor_dist != inf_distance);
-                    for (size_t i = 0; i < num_channel; i++) {
-                        distance_t new_dist = neighbor_dist + neighbor_state->dist[i];
-                        if (new_dist < next_state->dist[i]) {
-                            next_state->dist[i] = new_dist;
-                            changed = true;
-                        }
-                    }
-                } else {
-                    // special message sent to test convergence
-                    bool converged = (select_count == 2) && !changed;
-                    status = channel_send(completed_channel, converged ? curr_state : NULL);
-                    assert(status == SUCCESS);
-                }
+                // update next_state with new data
+                assert(select_list[selected_index].data != NULL);
+                router_message(&self, select_list[selected_index].data);
             } else {
+                router_sent(&self);
                 select_count--;
                 // swap last element and selected element
                 channel_t* temp = select_list[select_count].channel;
@@ -207,106 +480,248 @@ void* router(void* arg)
             // check if we've sent to everyone
             if (select_count == 2) {
                 // check if we want to reset
-                if (changed) {
-                    // cycle triple buffer
-                    distance_vector_t* temp_state = curr_state;
-                    curr_state = next_state;
-                    next_state = prev_prev_state;
-                    prev_prev_state = prev_state;
-                    prev_state = temp_state;
-                    next_state->epoch = curr_state->epoch + 1;
-                    for (size_t i = 0; i < num_channel; i++) {
-                        next_state->dist[i] = curr_state->dist[i];
-                    }
+                if (self.changed) {
+                    router_cycle(&self);
                     // reset to broadcast again
                     select_count = total_select_count;
                     for (size_t i = 2; i < select_count; i++) {
-                        select_list[i].data = curr_state;
+                        select_list[i].data = self.curr_state;
                     }
-                    changed = false;
                 }
             }
         } else {
             assert(status == CLOSED_ERROR);
             assert(selected_index == 0);
-            assert(changed == false);
             break;
         }
     }
+    router_finish(&self);
     free(select_list);
-    free(prev_prev_state);
-    free(prev_state);
-    free(curr_state);
-    free(next_state);
     return NULL;
 }
 
-bool check_done()
+// Hands a router to its worker's ready queue once it has changes and nothing left to send
+static void worker_ready(worker_t* worker, router_t* router)
 {
-    bool valid = true;
-    enum channel_status status;
-    distance_vector_t** completed = malloc(sizeof(distance_vector_t*) * num_channel);
-    assert(completed != NULL);
-    // validate by sending special NULL message to flush channels
-    for (size_t i = 0; i < num_channel; i++) {
-        status = channel_send(channels[i], NULL);
-        assert(status == SUCCESS);
+    if (router->changed && router->num_unsent == 0 && !router->queued) {
+        router->queued = true;
+        worker->ready[worker->num_ready++] = router;
     }
-    // receive special response
-    for (size_t i = 0; i < num_channel; i++) {
-        void* data = NULL;
-        status = channel_receive(completed_channel, &data);
-        assert(status == SUCCESS);
-        if (data == NULL) {
-            valid = false;
-        } else {
-            distance_vector_t* new_data = (distance_vector_t*)data;
-            size_t index = new_data->src;
-            completed[index] = new_data;
+}
+
+// Starts a broadcast of the router's current vector: routers on the same worker relax through it at once,
+// the others are sent it over their channels
+static void worker_broadcast(worker_t* worker, router_t* router)
+{
+    for (size_t link = topology->offsets[router->index]; link < topology->offsets[router->index + 1]; link++) {
+        size_t neighbor = topology->targets[link];
+        if (placement[neighbor] == worker->id) {
+            router_sent(router);
+            router->stats.local++;
+            router_receive(router_table[neighbor], router->curr_state);
+            worker_ready(worker, router_table[neighbor]);
         }
     }
-    if (valid) {
-        // ensure epoch hasn't changed since first validation
-        for (size_t i = 0; i < num_channel; i++) {
-            status = channel_send(channels[i], NULL);
-            assert(status == SUCCESS);
+    router->num_unsent = router->num_remote;
+}
+
+// Receives and sends whatever can go ahead on the worker's channels without blocking
+// Returns whether anything did, and channel_select is needed only when nothing did
+static bool worker_poll(worker_t* worker)
+{
+    bool progress = false;
+    for (size_t k = 0; k < worker->num_routers; k++) {
+        router_t* router = &worker->routers[k];
+        void* data;
+        if (channel_non_blocking_receive(channels[router->index], &data) == SUCCESS) {
+            assert(data != NULL);
+            router_message(router, data);
+            progress = true;
         }
-        // receive special response
-        for (size_t i = 0; i < num_channel; i++) {
-            void* data = NULL;
-            status = channel_receive(completed_channel, &data);
-            assert(status == SUCCESS);
-            if (data == NULL) {
-                valid = false;
+        for (size_t u = 0; u < router->num_unsent;) {
+            if (channel_non_blocking_send(channels[router->remote[u]], router->curr_state) == SUCCESS) {
+                router_sent(router);
+                uint32_t temp = router->remote[u];
+                router->remote[u] = router->remote[router->num_unsent - 1];
+                router->remote[router->num_unsent - 1] = temp;
+                router->num_unsent--;
+                progress = true;
             } else {
-                distance_vector_t* new_data = (distance_vector_t*)data;
-                size_t index = new_data->src;
-                if (completed[index]->epoch != new_data->epoch) {
-                    valid = false;
-                }
+                u++;
             }
         }
-        if (valid) {
-            // check results
-            for (size_t src = 0; src < num_channel; src++) {
-                for (size_t dst = 0; dst < num_channel; dst++) {
-                    assert(completed[src]->dist[dst] == get_solution_distance(src, dst));
-                }
+        worker_ready(worker, router);
+    }
+    return progress;
+}
+
+// Several routers per thread, polling their channels and sends still to go and blocking in one channel_select
+// over all of them once none can go ahead
+void* worker(void* arg)
+{
+    worker_t* worker = arg;
+    size_t capacity = 1 + worker->num_routers;
+    for (size_t k = 0; k < worker->num_routers; k++) {
+        router_t* router = &worker->routers[k];
+        router_init(router, worker->members[k]);
+        router->queued = false;
+        router->num_remote = 0;
+        router->remote = malloc(sizeof(uint32_t) * (topology_degree(topology, router->index) + 1));
+        assert(router->remote != NULL);
+        for (size_t link = topology->offsets[router->index]; link < topology->offsets[router->index + 1]; link++) {
+            if (placement[topology->targets[link]] != worker->id) {
+                router->remote[router->num_remote++] = topology->targets[link];
             }
         }
+        capacity += router->num_remote;
+        router_table[router->index] = router;
     }
-    free(completed);
-    return valid;
+    worker->ready = malloc(sizeof(router_t*) * (worker->num_routers + 1));
+    select_t* select_list = malloc(sizeof(select_t) * capacity);
+    router_t** select_router = malloc(sizeof(router_t*) * capacity); // whose channel or send each entry is
+    size_t* select_remote = malloc(sizeof(size_t) * capacity);       // which of its remote neighbors, for sends
+    assert(worker->ready != NULL && select_list != NULL && select_router != NULL && select_remote != NULL);
+    worker->num_ready = 0;
+    for (size_t k = 0; k < worker->num_routers; k++) {
+        worker_broadcast(worker, &worker->routers[k]);
+    }
+    while (true) {
+        // broadcast whatever the last message made ready, which may make more routers ready here
+        while (worker->num_ready > 0) {
+            router_t* router = worker->ready[--worker->num_ready];
+            router->queued = false;
+            if (router->changed && router->num_unsent == 0) {
+                router_cycle(router);
+                worker_broadcast(worker, router);
+            }
+        }
+        if (worker_poll(worker)) {
+            continue;
+        }
+        size_t select_count = 0;
+        select_list[select_count].channel = done_channel;
+        select_list[select_count].dir = RECV;
+        select_count++;
+        for (size_t k = 0; k < worker->num_routers; k++) {
+            select_list[select_count].channel = channels[worker->routers[k].index];
+            select_list[select_count].dir = RECV;
+            select_router[select_count] = &worker->routers[k];
+            select_count++;
+        }
+        for (size_t k = 0; k < worker->num_routers; k++) {
+            router_t* router = &worker->routers[k];
+            for (size_t u = 0; u < router->num_unsent; u++) {
+                select_list[select_count].channel = channels[router->remote[u]];
+                select_list[select_count].dir = SEND;
+                select_list[select_count].data = router->curr_state;
+                select_router[select_count] = router;
+                select_remote[select_count] = u;
+                select_count++;
+            }
+        }
+        size_t selected_index;
+        enum channel_status status = channel_select(select_list, select_count, &selected_index);
+        worker->selects++;
+        if (status != SUCCESS) {
+            assert(status == CLOSED_ERROR);
+            assert(selected_index == 0);
+            break;
+        }
+        assert(selected_index != 0);
+        router_t* router = select_router[selected_index];
+        if (select_list[selected_index].dir == RECV) {
+            assert(select_list[selected_index].data != NULL);
+            router_message(router, select_list[selected_index].data);
+        } else {
+            router_sent(router);
+            // swap the neighbor sent to behind the ones still to go
+            size_t u = select_remote[selected_index];
+            uint32_t temp = router->remote[u];
+            router->remote[u] = router->remote[router->num_unsent - 1];
+            router->remote[router->num_unsent - 1] = temp;
+            router->num_unsent--;
+        }
+        worker_ready(worker, router);
+    }
+    for (size_t k = 0; k < worker->num_routers; k++) {
+        router_finish(&worker->routers[k]);
+        free(worker->routers[k].remote);
+    }
+    free(select_list);
+    free(select_router);
+    free(select_remote);
+    free(worker->ready);
+    return NULL;
+}
+
+// Makes room in the topology for every link the updates bring up, down until they do
+static void add_update_links(const stress_link_update_t* updates, size_t num_updates)
+{
+    uint32_t* src = malloc(sizeof(uint32_t) * 2 * num_updates);
+    uint32_t* dst = malloc(sizeof(uint32_t) * 2 * num_updates);
+    assert(src != NULL && dst != NULL);
+    for (size_t u = 0; u < num_updates; u++) {
+        assert(updates[u].a != updates[u].b && updates[u].a < num_channel && updates[u].b < num_channel);
+        src[2 * u] = dst[2 * u + 1] = updates[u].a;
+        dst[2 * u] = src[2 * u + 1] = updates[u].b;
+    }
+    topology_t* with_links = topology_with_links(topology, src, dst, 2 * num_updates);
+    topology_free(topology);
+    topology = with_links;
+    free(src);
+    free(dst);
+}
+
+static void send_control(size_t index, control_t* control)
+{
+    enum channel_status status = channel_send(channels[index], control);
+    assert(status == SUCCESS);
+    (void)status;
+}
+
+// Waits until the routers have gone quiet, with no messages or broadcasts left
+static void wait_quiet(void)
+{
+    void* data;
+    enum channel_status status = channel_receive(completed_channel, &data);
+    assert(status == SUCCESS);
+    (void)status;
 }
 
 void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename)
 {
-    assert(main_buffer_size <= 1); // only support up to a buffer size of 1
-    assert(secondary_buffer_size <= 1); // only support up to a buffer size of 1
+    run_stress_report(main_buffer_size, secondary_buffer_size, filename, NULL);
+}
+
+void run_stress_report(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename,
+                       stress_report_t* report)
+{
+    stress_config_t config = {main_buffer_size, secondary_buffer_size, false, 0, STRESS_PARTITIONED};
+    run_stress_config(filename, &config, report);
+}
+
+void run_stress_config(const char* filename, const stress_config_t* config, stress_report_t* report)
+{
+    size_t main_buffer_size = config->main_buffer_size;
+    size_t secondary_buffer_size = config->secondary_buffer_size;
+    // a channel without room for a message never completes a send
+    assert(main_buffer_size > 0 && secondary_buffer_size > 0);
     int pthread_status;
     enum channel_status status;
+    uint64_t setup_start_ns = timer_now_ns();
     bool initialized = create_topology(filename);
     assert(initialized);
+    size_t num_links = topology->num_links;
+    distance_t* links = NULL; // the current link costs, for apsp_update_link
+    if (config->num_updates > 0) {
+        add_update_links(config->updates, config->num_updates);
+        links = malloc(sizeof(distance_t) * num_channel * num_channel);
+        assert(links != NULL);
+        topology_to_matrix(topology, links);
+    }
+    uint64_t setup_ns = timer_now_ns() - setup_start_ns;
+    delta_capacity = config->full_vectors ? 0 : num_channel / DELTA_MAX_FRACTION;
+    num_history = main_buffer_size + 1;
     channels = malloc(sizeof(channel_t*) * num_channel);
     assert(channels != NULL);
     for (size_t i = 0; i < num_channel; i++) {
@@ -318,25 +733,155 @@ void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const cha
     completed_channel = channel_create(secondary_buffer_size);
     assert(completed_channel != NULL);
 
-    pthread_t* pid = malloc(sizeof(pthread_t) * num_channel);
+    router_stats = calloc(num_channel, sizeof(router_stats_t));
+    assert(router_stats != NULL);
+    router_table = malloc(sizeof(router_t*) * num_channel);
+    assert(router_table != NULL);
+    // with workers, place the routers and list each worker's routers in order of their workers
+    size_t num_workers = config->num_workers < num_channel ? config->num_workers : num_channel;
+    size_t cut_links = topology->num_links;
+    worker_t* workers = NULL;
+    uint32_t* members = NULL;
+    if (num_workers > 0) {
+        placement = malloc(sizeof(uint32_t) * num_channel);
+        members = malloc(sizeof(uint32_t) * num_channel);
+        workers = calloc(num_workers, sizeof(worker_t));
+        assert(placement != NULL && members != NULL && workers != NULL);
+        if (config->placement == STRESS_ROUND_ROBIN) {
+            for (size_t i = 0; i < num_channel; i++) {
+                placement[i] = (uint32_t)(i % num_workers);
+            }
+            cut_links = partition_cut(topology, placement);
+        } else {
+            cut_links = partition_topology(topology, num_workers, placement);
+        }
+        // counting sort by worker, the first router of each worker after the last one of the one before
+        size_t* first = calloc(num_workers + 1, sizeof(size_t));
+        assert(first != NULL);
+        for (size_t i = 0; i < num_channel; i++) {
+            first[placement[i] + 1]++;
+        }
+        for (size_t w = 0; w < num_workers; w++) {
+            first[w + 1] += first[w];
+            workers[w].id = (uint32_t)w;
+            workers[w].members = &members[first[w]];
+            workers[w].num_routers = first[w + 1] - first[w];
+            workers[w].routers = malloc(sizeof(router_t) * workers[w].num_routers);
+            assert(workers[w].routers != NULL);
+        }
+        for (size_t i = 0; i < num_channel; i++) {
+            members[first[placement[i]]++] = (uint32_t)i;
+        }
+        free(first);
+    }
+    size_t num_threads = num_workers > 0 ? num_workers : num_channel;
+    pthread_t* pid = malloc(sizeof(pthread_t) * num_threads);
     assert(pid != NULL);
-    for (size_t i = 0; i < num_channel; i++) {
-        pthread_status = pthread_create(&pid[i], NULL, router, (void*)i);
+    // every router starts out broadcasting its links to its neighbors
+    atomic_store(&pending, topology->num_links);
+    uint64_t converge_start_ns = timer_now_ns();
+    for (size_t i = 0; i < num_threads; i++) {
+        if (num_workers > 0) {
+            pthread_status = pthread_create(&pid[i], NULL, worker, &workers[i]);
+        } else {
+            pthread_status = pthread_create(&pid[i], NULL, router, (void*)i);
+        }
         assert(pthread_status == 0);
     }
 
-    // wait for convergence
-    while (!check_done()) {
-        usleep(1000);
+    // wait for convergence, announced by the router finishing the last pending work
+    if (topology->num_links > 0) {
+        wait_quiet();
+    }
+    uint64_t converge_ns = timer_now_ns() - converge_start_ns;
+
+    uint64_t reconverge_ns = 0;
+    uint64_t verify_ns = 0;
+    size_t resets = 0;
+    size_t recomputed_rows = 0;
+    size_t generation = 0;
+    for (size_t u = 0; u < config->num_updates; u++) {
+        const stress_link_update_t* update = &config->updates[u];
+        assert(update->cost <= inf_distance);
+        size_t a = update->a;
+        size_t b = update->b;
+        distance_t old_ab = links[a * num_channel + b];
+        distance_t old_ba = links[b * num_channel + a];
+        control_t updates[2] = {{CONTROL_SRC, CONTROL_LINK, b, update->cost, 0},
+                                {CONTROL_SRC, CONTROL_LINK, a, update->cost, 0}};
+        uint64_t update_start_ns = timer_now_ns();
+        atomic_fetch_add(&pending, 2);
+        send_control(a, &updates[0]);
+        send_control(b, &updates[1]);
+        wait_quiet();
+        if (update->cost > old_ab || update->cost > old_ba) {
+            control_t reset = {CONTROL_SRC, CONTROL_RESET, 0, 0, ++generation};
+            atomic_fetch_add(&pending, num_channel);
+            for (size_t i = 0; i < num_channel; i++) {
+                send_control(i, &reset);
+            }
+            resets++;
+            wait_quiet();
+        } else if (update->cost < old_ab || update->cost < old_ba) {
+            control_t broadcast = {CONTROL_SRC, CONTROL_BROADCAST, 0, 0, 0};
+            atomic_fetch_add(&pending, 2);
+            send_control(a, &broadcast);
+            send_control(b, &broadcast);
+            wait_quiet();
+        }
+        reconverge_ns += timer_now_ns() - update_start_ns;
+
+        uint64_t verify_start_ns = timer_now_ns();
+        links[a * num_channel + b] = update->cost;
+        recomputed_rows += apsp_update_link(solution, links, num_channel, a, b, old_ab);
+        links[b * num_channel + a] = update->cost;
+        recomputed_rows += apsp_update_link(solution, links, num_channel, b, a, old_ba);
+        verify_ns += timer_now_ns() - verify_start_ns;
+
+        // quiet routers are blocked waiting for work, and everything they wrote happened before the last of
+        // them finished its pending work, so their vectors can be read here
+        for (size_t i = 0; i < num_channel; i++) {
+            router_check(router_table[i]);
+        }
     }
 
     // stop threads
     status = channel_close(done_channel);
     assert(status == SUCCESS);
     // join threads
-    for (size_t i = 0; i < num_channel; i++) {
+    for (size_t i = 0; i < num_threads; i++) {
         pthread_join(pid[i], NULL);
     }
+    if (report != NULL) {
+        report->num_nodes = num_channel;
+        report->num_links = num_links;
+        report->setup_seconds = (double)setup_ns / 1e9;
+        report->topology_bytes = topology->file_bytes;
+        report->load_seconds = topology->load_seconds;
+        report->converge_seconds = (double)converge_ns / 1e9;
+        report->num_threads = num_threads;
+        report->cut_links = cut_links;
+        report->messages = 0;
+        report->delta_messages = 0;
+        report->local_messages = 0;
+        report->entries = 0;
+        report->selects = 0;
+        for (size_t i = 0; i < num_channel; i++) {
+            report->messages += router_stats[i].messages;
+            report->delta_messages += router_stats[i].deltas;
+            report->local_messages += router_stats[i].local;
+            report->entries += router_stats[i].entries;
+            report->selects += router_stats[i].selects;
+        }
+        for (size_t w = 0; w < num_workers; w++) {
+            report->selects += workers[w].selects;
+        }
+        report->updates = config->num_updates;
+        report->resets = resets;
+        report->reconverge_seconds = (double)reconverge_ns / 1e9;
+        report->verify_seconds = (double)verify_ns / 1e9;
+        report->recomputed_rows = recomputed_rows;
+    }
     // cleanup
     status = channel_destroy(done_channel);
     assert(status == SUCCESS);
@@ -352,5 +897,16 @@ void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const cha
     }
     free(pid);
     free(channels);
+    free(router_stats);
+    free(links);
+    if (num_workers > 0) {
+        for (size_t w = 0; w < num_workers; w++) {
+            free(workers[w].routers);
+        }
+        free(workers);
+        free(members);
+        free(placement);
+    }
+    free(router_table);
     destroy_topology();
 }
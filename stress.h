@@ -1,6 +1,78 @@
 #ifndef STRESS_H
 #define STRESS_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "apsp.h"
+
+// What one router stress run did, from loading the topology to confirmed convergence
+typedef struct {
+    size_t num_nodes;
+    size_t num_links;        // directed links between distinct nodes
+    size_t num_threads;      // threads running routers, one per router unless they share workers
+    size_t cut_links;        // links between routers on different threads
+    double setup_seconds;    // loading the topology and computing the reference solution
+    size_t topology_bytes;   // size of the topology file
+    double load_seconds;     // the part of setup_seconds spent loading the topology file
+    double converge_seconds; // from starting the routers until the last of them went quiet
+    uint64_t messages;       // distance vectors sent from router to router
+    uint64_t delta_messages; // those of them carrying only the distances changed since the sender's last one
+    uint64_t local_messages; // those of them between routers on the same worker, which skip the channels
+    uint64_t entries;        // distances the receivers relaxed through, num_nodes for each whole vector
+    uint64_t selects;        // channel_select calls made by the routers
+    size_t updates;            // link updates applied after the first convergence
+    size_t resets;             // those of them that made every router start over
+    double reconverge_seconds; // from sending each update to the routers until they went quiet again, summed
+    double verify_seconds;     // bringing the reference solution up to date after each update, summed
+    size_t recomputed_rows;    // rows of the reference solution that took a Dijkstra run to update
+} stress_report_t;
+
+// A new cost for the link between routers a and b, both ways: inf_distance takes the link down, and a link
+// the topology does not have comes up
+typedef struct {
+    uint32_t a;
+    uint32_t b;
+    distance_t cost;
+} stress_link_update_t;
+
+// How routers are assigned to workers when they share them
+enum stress_placement {
+    STRESS_PARTITIONED, // by partition_topology (partition.h), to keep as many links as it can within workers
+    STRESS_ROUND_ROBIN, // router i on worker i % num_workers, for comparison
+};
+
+typedef struct {
+    size_t main_buffer_size;      // capacity of each router's channel, at least 1
+    size_t secondary_buffer_size; // capacity of the channels stopping the routers and announcing convergence
+    bool full_vectors;            // always send whole distance vectors instead of deltas where they are shorter
+    size_t num_workers;           // threads to run the routers on, or 0 for one thread per router
+    enum stress_placement placement;
+    const stress_link_update_t* updates; // applied one at a time once the routers have converged
+    size_t num_updates;
+} stress_config_t;
+
+// Runs one router per node of the topology in filename until their distance vectors match the shortest paths
+// Each router keeps main_buffer_size + 3 distance vectors, since neighbors can still be reading that many of
+// its recent broadcasts out of their channels
+// The file is either a node count followed by a matrix of link costs (-1 for none) or an edge list, see
+// topogen.h, or the binary format of topology.h, whose precomputed solution is used if it has one
 void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename);
 
+// Same run as run_stress, also filling report unless it is NULL
+void run_stress_report(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename,
+                       stress_report_t* report);
+
+// Same run with the options in config, filling report unless it is NULL
+// Routers send each distance vector as the entries that changed since their previous one when that is less
+// than an eighth of the vector, unless config->full_vectors
+// With workers, routers on the same worker relax through each other's vectors directly, and each worker
+// makes one channel_select over the channels of all its routers and all their sends to other workers, which
+// locks all of those channels at once
+// Each update goes to the routers at both ends of its link as a message, and every router checks its final
+// distances against a reference solution brought up to date with apsp_update_link (apsp.h) after each one
+// A cheaper or new link makes both ends broadcast their whole vectors; a dearer or removed one makes every
+// router start over from its links, because routers keep no neighbor's vector to fall back on
+void run_stress_config(const char* filename, const stress_config_t* config, stress_report_t* report);
+
 #endif // STRESS_H
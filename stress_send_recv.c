@@ -4,13 +4,22 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdatomic.h>
+#include <stdlib.h>
 #include "channel.h"
 #include "stress_send_recv.h"
+#include "timer.h"
+
+// how often the ring occupancy is sampled while the test runs
+#define OCCUPANCY_SAMPLE_USEC 1000
 
 static size_t num_channel;
 static channel_t** channels;
 static atomic_bool done;
 static channel_t* main_channel;
+// times each message was passed along the ring, indexed by message; only the thread holding a message writes it
+static size_t* msg_hops;
+// messages each worker passed along the ring, written by the worker as it exits
+static uint64_t* worker_hops;
 
 void* worker_thread(void* arg)
 {
@@ -22,6 +31,7 @@ void* worker_thread(void* arg)
     channel_t* my_channel = channels[index];
     channel_t* next_channel = channels[next_index];
     bool start = true;
+    uint64_t hops = 0;
     enum channel_status status;
     while (true) {
         void* data = NULL;
@@ -47,14 +57,36 @@ void* worker_thread(void* arg)
             assert(status == SUCCESS);
         } else {
             // Pass along message to next thread in ring
+            msg_hops[(size_t)data]++;
+            hops++;
             status = channel_send(next_channel, data);
             assert(status == SUCCESS);
         }
     }
+    worker_hops[index] = hops;
     return NULL;
 }
 
+// Returns the messages sitting in the ring channels' buffers
+static size_t ring_buffered(void)
+{
+    size_t buffered = 0;
+    for (size_t i = 0; i < num_channel; i++) {
+        // occupancy is filled in even when the counters are compiled out
+        channel_stats_t stats;
+        channel_get_stats(channels[i], &stats);
+        buffered += stats.occupancy;
+    }
+    return buffered;
+}
+
 void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec)
+{
+    run_stress_send_recv_report(buffer_size, num_threads, load, duration_usec, NULL);
+}
+
+void run_stress_send_recv_report(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec,
+                                 stress_send_recv_report_t* report)
 {
     enum channel_status status;
     // setup
@@ -63,6 +95,9 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
     size_t num_msgs = (size_t)(((double)(num_channel * (buffer_size + 1))) * load);
     bool* msg_check = calloc(num_msgs + 1, sizeof(bool));
     assert(msg_check != NULL);
+    msg_hops = calloc(num_msgs + 1, sizeof(size_t));
+    worker_hops = calloc(num_channel, sizeof(uint64_t));
+    assert(msg_hops != NULL && worker_hops != NULL);
 
     channels = malloc(sizeof(channel_t*) * num_channel);
     assert(channels != NULL);
@@ -81,6 +116,7 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
     }
 
     // start test
+    uint64_t start_ns = timer_now_ns();
     for (size_t msg = 1; msg <= num_msgs; msg++) {
         // insert data into threads
         status = channel_send(main_channel, (void*)msg);
@@ -92,11 +128,23 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
         assert(status == SUCCESS);
     }
 
-    // wait for duration
-    usleep(duration_usec);
+    // wait for duration, sampling how full the ring buffers are when reporting
+    double occupancy_sum = 0;
+    size_t occupancy_samples = 0;
+    if (report == NULL || buffer_size == 0) {
+        usleep(duration_usec);
+    } else {
+        uint64_t end_ns = start_ns + (uint64_t)duration_usec * 1000;
+        while (timer_now_ns() < end_ns) {
+            usleep(OCCUPANCY_SAMPLE_USEC);
+            occupancy_sum += (double)ring_buffered() / (double)(num_channel * buffer_size);
+            occupancy_samples++;
+        }
+    }
 
     // stop test
     atomic_store(&done, true);
+    uint64_t elapsed_ns = timer_now_ns() - start_ns;
     for (size_t msg = 1; msg <= num_msgs; msg++) {
         // pull data from threads
         size_t data = 0;
@@ -119,6 +167,29 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
         pthread_join(pid[i], NULL);
     }
 
+    if (report != NULL) {
+        report->num_threads = num_threads;
+        report->buffer_size = buffer_size;
+        report->load = load;
+        report->messages = num_msgs;
+        report->seconds = (double)elapsed_ns / 1e9;
+        report->hops = 0;
+        report->thread_hops = malloc(sizeof(uint64_t) * num_channel);
+        assert(report->thread_hops != NULL);
+        for (size_t i = 0; i < num_channel; i++) {
+            report->thread_hops[i] = worker_hops[i];
+            report->hops += worker_hops[i];
+        }
+        report->hops_per_sec = (double)report->hops / report->seconds;
+        report->min_message_hops = num_msgs > 0 ? SIZE_MAX : 0;
+        report->max_message_hops = 0;
+        for (size_t msg = 1; msg <= num_msgs; msg++) {
+            report->min_message_hops = msg_hops[msg] < report->min_message_hops ? msg_hops[msg] : report->min_message_hops;
+            report->max_message_hops = msg_hops[msg] > report->max_message_hops ? msg_hops[msg] : report->max_message_hops;
+        }
+        report->occupancy = occupancy_samples > 0 ? occupancy_sum / (double)occupancy_samples : 0;
+    }
+
     // cleanup
     status = channel_close(main_channel);
     assert(status == SUCCESS);
@@ -131,6 +202,24 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
         assert(status == SUCCESS);
     }
     free(msg_check);
+    free(msg_hops);
+    free(worker_hops);
     free(pid);
     free(channels);
 }
+
+void stress_send_recv_report_print(FILE* out, const stress_send_recv_report_t* report)
+{
+    fprintf(out, "ring: %zu threads, buffer %zu, load %.2f, %zu messages, %.3f s\n", report->num_threads,
+            report->buffer_size, report->load, report->messages, report->seconds);
+    fprintf(out, "ring:   %llu hops, %.0f hops/s, %.1f hops per message (min %zu, max %zu)\n",
+            (unsigned long long)report->hops, report->hops_per_sec,
+            report->messages > 0 ? (double)report->hops / (double)report->messages : 0.0, report->min_message_hops,
+            report->max_message_hops);
+    fprintf(out, "ring:   %.1f%% of buffer slots occupied on average\n", report->occupancy * 100);
+    fprintf(out, "ring:   hops per thread:");
+    for (size_t i = 0; i < report->num_threads; i++) {
+        fprintf(out, " %llu", (unsigned long long)report->thread_hops[i]);
+    }
+    fprintf(out, "\n");
+}
@@ -1,6 +1,32 @@
 #ifndef STRESS_SEND_RECV_H
 #define STRESS_SEND_RECV_H
 
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// What one run of the ring did; a hop is one worker passing a message on to the next channel in the ring
+typedef struct {
+    size_t num_threads;
+    size_t buffer_size;
+    double load;
+    size_t messages;         // messages circulating in the ring
+    double seconds;          // from the first message sent to the stop
+    uint64_t hops;           // total over all messages
+    double hops_per_sec;
+    size_t min_message_hops; // hops of the least and most travelled message
+    size_t max_message_hops;
+    double occupancy;        // mean fraction of the ring channels' buffer slots holding a message, 0 to 1
+    uint64_t* thread_hops;   // num_threads entries, hops made by each worker; the caller frees it
+} stress_send_recv_report_t;
+
 void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec);
 
+// Same run as run_stress_send_recv, also filling report unless it is NULL
+void run_stress_send_recv_report(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec,
+                                 stress_send_recv_report_t* report);
+
+// Writes a human readable summary of a run, including the hops made by every thread
+void stress_send_recv_report_print(FILE* out, const stress_send_recv_report_t* report);
+
 #endif // STRESS_SEND_RECV_H
@@ -10,6 +10,19 @@
 #include <stdbool.h>
 #include "stress.h"
 #include "stress_send_recv.h"
+#include "pipeline.h"
+#include "timer.h"
+#include "trace.h"
+#include "channel_registry.h"
+#include "watchdog.h"
+#include "loadgen.h"
+#include "topogen.h"
+#include "apsp.h"
+#include "minplus.h"
+#include "partition.h"
+#include "topology.h"
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #define mu_str_(text) #text
 #define mu_str(text) mu_str_(text)
@@ -1627,6 +1640,1532 @@ char* test_select_with_duplicate_channel_size1() {
     return test_select_with_duplicate_channel(1);
 }
 
+char* test_select_many_channels() {
+    print_test_details(__func__, "Testing select over an empty list and over more channels than fit on the stack");
+
+    size_t idx = 0;
+    mu_assert("test_select_many_channels: Empty select accepted", channel_select(NULL, 0, &idx) == GENERIC_ERROR);
+
+    /* every channel appears twice, so the sorted copy also has duplicates to skip */
+    size_t CHANNELS = 40;
+    channel_t* channel[CHANNELS];
+    select_t list[CHANNELS * 2];
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel[i] = channel_create(1);
+        list[i].channel = channel[i];
+        list[i].dir = RECV;
+        list[CHANNELS + i].channel = channel[i];
+        list[CHANNELS + i].dir = RECV;
+    }
+    mu_assert("test_select_many_channels: Send failed", channel_send(channel[37], "Message") == SUCCESS);
+    mu_assert("test_select_many_channels: Select failed", channel_select(list, CHANNELS * 2, &idx) == SUCCESS);
+    mu_assert("test_select_many_channels: Wrong case selected", idx == 37);
+    mu_assert("test_select_many_channels: Wrong message", strcmp(list[idx].data, "Message") == 0);
+
+    /* a blocked select has to be woken through any of its channels */
+    sem_t done;
+    sem_init(&done, 0, 0);
+    pthread_t pid;
+    select_args args;
+    init_object_for_select_api(&args, list, CHANNELS * 2, &done);
+    pthread_create(&pid, NULL, (void *)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_select_many_channels: It isn't blocked as expected", args.out == GENERIC_ERROR);
+    channel_send(channel[5], "Message");
+    sem_wait(&done);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_many_channels: Wrong case selected", args.out == SUCCESS && args.index == 5);
+
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel_close(channel[i]);
+        channel_destroy(channel[i]);
+    }
+    sem_destroy(&done);
+    return NULL;
+}
+
+
+typedef struct {
+    channel_t *channel;
+    void **data;
+    size_t count;
+    size_t sent;
+    enum channel_status out;
+} batch_send_args;
+
+void* helper_send_batch(batch_send_args *myargs) {
+    myargs->out = channel_send_batch(myargs->channel, myargs->data, myargs->count, &myargs->sent);
+    return NULL;
+}
+
+char* test_send_receive_batch() {
+    print_test_details(__func__, "Testing batched send and receive");
+
+    /* A batch larger than the capacity has to be delivered in several rounds while a receiver drains it */
+    size_t capacity = 4;
+    size_t MESSAGES = 10;
+    channel_t* channel = channel_create(capacity);
+    void* messages[MESSAGES];
+    for (size_t i = 0; i < MESSAGES; i++) {
+        messages[i] = (void*)(i + 1);
+    }
+
+    size_t sent = 0;
+    mu_assert("test_send_receive_batch: Batch did not fit the free space", channel_send_batch(channel, messages, 3, &sent) == SUCCESS);
+    mu_assert("test_send_receive_batch: Wrong number of messages sent", sent == 3);
+
+    void* received[MESSAGES];
+    size_t count = 0;
+    mu_assert("test_send_receive_batch: Receive batch failed", channel_receive_batch(channel, received, MESSAGES, &count) == SUCCESS);
+    mu_assert("test_send_receive_batch: Did not drain the buffered messages", count == 3);
+    for (size_t i = 0; i < count; i++) {
+        mu_assert("test_send_receive_batch: Messages out of order", received[i] == messages[i]);
+    }
+
+    pthread_t pid;
+    batch_send_args batch_args = {channel, messages, MESSAGES, 0, GENERIC_ERROR};
+    pthread_create(&pid, NULL, (void *)helper_send_batch, &batch_args);
+    size_t total = 0;
+    while (total < MESSAGES) {
+        mu_assert("test_send_receive_batch: Receive batch failed", channel_receive_batch(channel, received, 3, &count) == SUCCESS);
+        mu_assert("test_send_receive_batch: Batch larger than requested", count >= 1 && count <= 3);
+        for (size_t i = 0; i < count; i++) {
+            mu_assert("test_send_receive_batch: Large batch out of order", received[i] == messages[total + i]);
+        }
+        total += count;
+    }
+    pthread_join(pid, NULL);
+    mu_assert("test_send_receive_batch: Large batch failed", batch_args.out == SUCCESS);
+    mu_assert("test_send_receive_batch: Large batch incomplete", batch_args.sent == MESSAGES);
+    mu_assert("test_send_receive_batch: Lost messages", total == MESSAGES);
+
+    mu_assert("test_send_receive_batch: Zero sized receive should fail", channel_receive_batch(channel, received, 0, &count) == GENERIC_ERROR);
+    channel_close(channel);
+    mu_assert("test_send_receive_batch: Send on closed channel", channel_send_batch(channel, messages, 1, &sent) == CLOSED_ERROR);
+    mu_assert("test_send_receive_batch: Receive on closed channel", channel_receive_batch(channel, received, 1, &count) == CLOSED_ERROR);
+    channel_destroy(channel);
+    return NULL;
+}
+
+void* pipeline_double(void* data, void* arg) {
+    (void)arg;
+    return (void*)((size_t)data * 2);
+}
+
+bool pipeline_multiple_of_four(void* data, void* arg) {
+    (void)arg;
+    return ((size_t)data % 4) == 0;
+}
+
+char* test_pipeline() {
+    print_test_details(__func__, "Testing pipeline stages and close propagation");
+
+    /* source -> map(x2) -> filter(%4) -> fan_out -> 2 branches -> fan_in -> sink */
+    size_t MESSAGES = 1000;
+    channel_t* source = channel_create(8);
+    channel_t* doubled = channel_create(8);
+    channel_t* filtered = channel_create(8);
+    channel_t* branches[2] = {channel_create(4), channel_create(4)};
+    channel_t* sink = channel_create(8);
+
+    pipeline_stage_t* map_stage = pipeline_map(source, doubled, pipeline_double, NULL, NULL, 4);
+    pipeline_stage_t* filter_stage = pipeline_filter(doubled, filtered, pipeline_multiple_of_four, NULL, NULL, 2);
+    pipeline_stage_t* fan_out_stage = fan_out(filtered, branches, 2, FAN_OUT_ROUND_ROBIN, NULL, NULL);
+    pipeline_stage_t* fan_in_stage = fan_in(branches, 2, sink, NULL, NULL);
+    mu_assert("test_pipeline: Could not create stages", map_stage && filter_stage && fan_out_stage && fan_in_stage);
+    mu_assert("test_pipeline: Invalid stage accepted", pipeline_map(source, sink, pipeline_double, NULL, NULL, 0) == NULL);
+
+    bool seen[MESSAGES * 2 + 1];
+    memset(seen, 0, sizeof(seen));
+    for (size_t i = 1; i <= MESSAGES; i++) {
+        mu_assert("test_pipeline: Send failed", channel_send(source, (void*)i) == SUCCESS);
+        /* keep the sink drained so the pipeline never fills up */
+        void* data;
+        while (channel_non_blocking_receive(sink, &data) == SUCCESS) {
+            mu_assert("test_pipeline: Duplicated message", !seen[(size_t)data]);
+            seen[(size_t)data] = true;
+        }
+    }
+    size_t expected = MESSAGES / 2;
+    size_t received = 0;
+    for (size_t i = 1; i <= MESSAGES * 2; i++) {
+        received += seen[i];
+    }
+    while (received < expected) {
+        void* data;
+        mu_assert("test_pipeline: Receive failed", channel_receive(sink, &data) == SUCCESS);
+        mu_assert("test_pipeline: Duplicated message", !seen[(size_t)data]);
+        seen[(size_t)data] = true;
+        received++;
+    }
+    for (size_t i = 1; i <= MESSAGES * 2; i++) {
+        mu_assert("test_pipeline: Wrong message set", seen[i] == (i % 4 == 0));
+    }
+
+    /* closing the source has to shut down every stage and finally close the sink */
+    channel_close(source);
+    void* data;
+    mu_assert("test_pipeline: Sink was not closed", channel_receive(sink, &data) == CLOSED_ERROR);
+    pipeline_stage_join(map_stage);
+    pipeline_stage_join(filter_stage);
+    pipeline_stage_join(fan_out_stage);
+    pipeline_stage_join(fan_in_stage);
+    mu_assert("test_pipeline: Intermediate channel left open", channel_close(doubled) == CLOSED_ERROR);
+    mu_assert("test_pipeline: Intermediate channel left open", channel_close(filtered) == CLOSED_ERROR);
+
+    channel_destroy(source);
+    channel_destroy(doubled);
+    channel_destroy(filtered);
+    channel_destroy(branches[0]);
+    channel_destroy(branches[1]);
+    channel_destroy(sink);
+    return NULL;
+}
+
+typedef struct {
+    channel_t* channel;
+    size_t count;
+} pipeline_feed_args;
+
+void* pipeline_feed(void* arg) {
+    pipeline_feed_args* args = arg;
+    for (size_t i = 1; i <= args->count; i++) {
+        channel_send(args->channel, (void*)i);
+    }
+    channel_send(args->channel, PIPELINE_END);
+    return NULL;
+}
+
+void pipeline_mark_released(void* data, void* arg) {
+    /* only ever called with the doubled value of an input */
+    bool* released = arg;
+    released[(size_t)data / 2] = true;
+}
+
+char* test_pipeline_drain() {
+    print_test_details(__func__, "Testing that PIPELINE_END shuts a loaded pipeline down without losing messages");
+
+    /* same shape as test_pipeline but with small channels, so every stage is backed up when the end is sent */
+    size_t MESSAGES = 2000;
+    channel_t* source = channel_create(2);
+    channel_t* doubled = channel_create(2);
+    channel_t* filtered = channel_create(2);
+    channel_t* branches[2] = {channel_create(1), channel_create(1)};
+    channel_t* sink = channel_create(1);
+
+    bool* released = calloc(MESSAGES + 1, sizeof(bool));
+    bool* seen = calloc(MESSAGES + 1, sizeof(bool));
+    pipeline_stage_t* map_stage = pipeline_map(source, doubled, pipeline_double, NULL, NULL, 4);
+    pipeline_stage_t* filter_stage = pipeline_filter(doubled, filtered, pipeline_multiple_of_four,
+                                                     pipeline_mark_released, released, 3);
+    pipeline_stage_t* fan_out_stage = fan_out(filtered, branches, 2, FAN_OUT_ROUND_ROBIN, NULL, NULL);
+    pipeline_stage_t* fan_in_stage = fan_in(branches, 2, sink, NULL, NULL);
+    mu_assert("test_pipeline_drain: Could not create stages", map_stage && filter_stage && fan_out_stage && fan_in_stage);
+
+    pipeline_feed_args args = {source, MESSAGES};
+    pthread_t feeder;
+    pthread_create(&feeder, NULL, pipeline_feed, &args);
+
+    /* everything sent before the marker has to come out of the tail ahead of it */
+    void* data;
+    while (true) {
+        mu_assert("test_pipeline_drain: Sink was closed", channel_receive(sink, &data) == SUCCESS);
+        if (data == PIPELINE_END) {
+            break;
+        }
+        size_t input = (size_t)data / 2;
+        mu_assert("test_pipeline_drain: Unexpected message", input >= 1 && input <= MESSAGES && !seen[input]);
+        seen[input] = true;
+    }
+    pthread_join(feeder, NULL);
+    for (size_t i = 1; i <= MESSAGES; i++) {
+        mu_assert("test_pipeline_drain: Message lost", seen[i] != released[i]);
+        mu_assert("test_pipeline_drain: Wrong message set", seen[i] == (i % 2 == 0));
+    }
+
+    /* the stages have exited and left their channels open and empty */
+    pipeline_stage_join(map_stage);
+    pipeline_stage_join(filter_stage);
+    pipeline_stage_join(fan_out_stage);
+    pipeline_stage_join(fan_in_stage);
+    mu_assert("test_pipeline_drain: Channel left with messages", channel_non_blocking_receive(source, &data) == CHANNEL_EMPTY);
+    mu_assert("test_pipeline_drain: Channel left with messages", channel_non_blocking_receive(doubled, &data) == CHANNEL_EMPTY);
+    mu_assert("test_pipeline_drain: Channel left with messages", channel_non_blocking_receive(filtered, &data) == CHANNEL_EMPTY);
+    mu_assert("test_pipeline_drain: Channel left with messages", channel_non_blocking_receive(sink, &data) == CHANNEL_EMPTY);
+
+    /* a map stage whose output is gone hands what it could not send to its release function */
+    bool* undelivered = calloc(MESSAGES + 1, sizeof(bool));
+    map_stage = pipeline_map(source, doubled, pipeline_double, pipeline_mark_released, undelivered, 1);
+    channel_close(doubled);
+    channel_send(source, (void*)1);
+    pipeline_stage_join(map_stage);
+    mu_assert("test_pipeline_drain: Undeliverable message not released", undelivered[1]);
+    mu_assert("test_pipeline_drain: Input not closed", channel_send(source, (void*)2) == CLOSED_ERROR);
+
+    channel_close(filtered);
+    channel_close(branches[0]);
+    channel_close(branches[1]);
+    channel_close(sink);
+    channel_destroy(source);
+    channel_destroy(doubled);
+    channel_destroy(filtered);
+    channel_destroy(branches[0]);
+    channel_destroy(branches[1]);
+    channel_destroy(sink);
+    free(released);
+    free(seen);
+    free(undelivered);
+    return NULL;
+}
+
+
+char* test_timer_channels() {
+    print_test_details(__func__, "Testing timer channels (after, deadline, ticker) with select");
+
+    /* an after channel in a select with an idle data channel has to be the one that fires */
+    channel_t* data_channel = channel_create(1);
+    uint64_t start = getTime();
+    channel_t* timeout = channel_after(20 * 1000000ull);
+    select_t list[2];
+    list[0].channel = data_channel;
+    list[0].dir = RECV;
+    list[1].channel = timeout;
+    list[1].dir = RECV;
+    size_t index = 2;
+    mu_assert("test_timer_channels: Select failed", channel_select(list, 2, &index) == SUCCESS);
+    uint64_t elapsed = getTime() - start;
+    mu_assert("test_timer_channels: Wrong channel selected", index == 1);
+    mu_assert("test_timer_channels: Timer fired early", elapsed >= 20 * 1000000ull);
+    mu_assert("test_timer_channels: Timer fired far too late", elapsed < 2000 * 1000000ull);
+    mu_assert("test_timer_channels: Fire time not delivered", (uint64_t)(uintptr_t)list[1].data >= start + 20 * 1000000ull);
+    void* data = NULL;
+    mu_assert("test_timer_channels: One-shot timer fired twice", channel_non_blocking_receive(timeout, &data) == CHANNEL_EMPTY);
+    channel_timer_release(timeout);
+
+    /* a deadline in the past fires right away */
+    channel_t* deadline = channel_deadline(timer_now_ns() - 1000000ull);
+    mu_assert("test_timer_channels: Past deadline did not fire", channel_receive(deadline, &data) == SUCCESS);
+    channel_timer_release(deadline);
+
+    /* the i-th tick never fires before i periods have passed */
+    uint64_t period = 5 * 1000000ull;
+    uint64_t ticker_start = timer_now_ns();
+    channel_t* ticker = channel_ticker(period);
+    uint64_t last = 0;
+    for (size_t i = 0; i < 3; i++) {
+        mu_assert("test_timer_channels: Ticker receive failed", channel_receive(ticker, &data) == SUCCESS);
+        uint64_t fired = (uint64_t)(uintptr_t)data;
+        mu_assert("test_timer_channels: Tick too early", fired >= ticker_start + (i + 1) * period);
+        mu_assert("test_timer_channels: Ticks out of order", fired > last);
+        last = fired;
+    }
+    channel_timer_release(ticker);
+
+    /* a released timer never fires and does not keep the thread busy */
+    channel_t* released = channel_after(10 * 1000000ull);
+    channel_timer_release(released);
+    channel_t* pending = channel_after(3600 * NS_PER_SEC);
+    channel_timer_shutdown();
+    mu_assert("test_timer_channels: Pending timer fired", channel_non_blocking_receive(pending, &data) == CHANNEL_EMPTY);
+    channel_timer_release(pending);
+
+    channel_close(data_channel);
+    channel_destroy(data_channel);
+    return NULL;
+}
+
+
+char* test_channel_stats() {
+    print_test_details(__func__, "Testing per-channel statistics counters");
+
+    channel_stats_t stats;
+    channel_t* channel = channel_create(2);
+#if CHANNEL_STATS
+    mu_assert("test_channel_stats: Could not read stats", channel_get_stats(channel, &stats) == SUCCESS);
+    mu_assert("test_channel_stats: Counters not zeroed", stats.sends == 0 && stats.receives == 0 && stats.peak_occupancy == 0);
+
+    channel_send(channel, "Message1");
+    channel_non_blocking_send(channel, "Message2");
+    channel_get_stats(channel, &stats);
+    mu_assert("test_channel_stats: Wrong send count", stats.sends == 2);
+    mu_assert("test_channel_stats: Wrong occupancy", stats.occupancy == 2 && stats.peak_occupancy == 2);
+    mu_assert("test_channel_stats: Nothing should have blocked", stats.blocked_sends == 0 && stats.blocked_ns == 0);
+
+    /* a third send has to block until a receive frees a slot */
+    pthread_t pid;
+    sem_t done;
+    sem_init(&done, 0, 0);
+    send_args data_send;
+    init_object_for_send_api(&data_send, channel, "Message3", &done);
+    pthread_create(&pid, NULL, (void *)helper_send, &data_send);
+    usleep(10000);
+    void* data = NULL;
+    channel_receive(channel, &data);
+    sem_wait(&done);
+    pthread_join(pid, NULL);
+    channel_get_stats(channel, &stats);
+    mu_assert("test_channel_stats: Blocked send not counted", stats.blocked_sends == 1);
+    mu_assert("test_channel_stats: Blocked time not counted", stats.blocked_ns >= 5000000);
+    mu_assert("test_channel_stats: Wakeup not counted", stats.wakeups >= 1 && stats.spurious_wakeups < stats.wakeups);
+    mu_assert("test_channel_stats: Wrong totals", stats.sends == 3 && stats.receives == 1 && stats.peak_occupancy == 2);
+
+    /* a blocked select registers itself on every channel it waits for */
+    channel_t* other = channel_create(1);
+    select_t list[1];
+    list[0].channel = other;
+    list[0].dir = RECV;
+    select_args args;
+    init_object_for_select_api(&args, list, 1, &done);
+    pthread_create(&pid, NULL, (void *)helper_select, &args);
+    usleep(10000);
+    channel_send(other, "Message4");
+    sem_wait(&done);
+    pthread_join(pid, NULL);
+    channel_get_stats(other, &stats);
+    mu_assert("test_channel_stats: Select registration not counted", stats.select_registrations >= 1);
+    mu_assert("test_channel_stats: Select receive not counted", stats.sends == 1 && stats.receives == 1);
+
+    channel_close(other);
+    channel_destroy(other);
+    sem_destroy(&done);
+#else
+    channel_send(channel, "Message1");
+    mu_assert("test_channel_stats: Stats should be compiled out", channel_get_stats(channel, &stats) == GENERIC_ERROR);
+    mu_assert("test_channel_stats: Occupancy missing without the counters", stats.occupancy == 1 && stats.sends == 0);
+#endif
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+
+typedef struct {
+    channel_t* channel;
+    size_t count;
+} latency_load_args;
+
+void* helper_latency_producer(latency_load_args* myargs) {
+    for (size_t i = 1; i <= myargs->count; i++) {
+        channel_send(myargs->channel, (void*)i);
+    }
+    return NULL;
+}
+
+char* test_latency_histogram() {
+    print_test_details(__func__, "Testing enqueue to dequeue latency histograms");
+
+    /* the histogram itself: exact for small values, within one sub-bucket for large ones */
+    latency_hist_t hist;
+    latency_hist_init(&hist);
+    mu_assert("test_latency_histogram: Empty histogram percentile", latency_hist_percentile(&hist, 50.0) == 0);
+    for (uint64_t value = 1; value <= 1000; value++) {
+        latency_hist_record(&hist, value * 1000);
+    }
+    mu_assert("test_latency_histogram: Wrong count", hist.count == 1000 && hist.min == 1000 && hist.max == 1000000);
+    uint64_t p50 = latency_hist_percentile(&hist, 50.0);
+    uint64_t p99 = latency_hist_percentile(&hist, 99.0);
+    uint64_t p999 = latency_hist_percentile(&hist, 99.9);
+    mu_assert("test_latency_histogram: p50 out of bucket precision", p50 >= 500000 && p50 <= 500000 + 500000 / LATENCY_HIST_SUB_BUCKETS);
+    mu_assert("test_latency_histogram: p99 out of bucket precision", p99 >= 990000 && p99 <= 990000 + 990000 / LATENCY_HIST_SUB_BUCKETS);
+    mu_assert("test_latency_histogram: Percentiles not ordered", p50 <= p99 && p99 <= p999 && p999 <= hist.max);
+    mu_assert("test_latency_histogram: p100 is not the max", latency_hist_percentile(&hist, 100.0) == hist.max);
+    latency_hist_t small;
+    latency_hist_init(&small);
+    latency_hist_record(&small, 3);
+    latency_hist_merge(&hist, &small);
+    mu_assert("test_latency_histogram: Merge lost values", hist.count == 1001 && hist.min == 3);
+
+    /* a channel under load records one latency per received message */
+    size_t MESSAGES = 20000;
+    channel_t* channel = channel_create(16);
+    mu_assert("test_latency_histogram: Disabled channel has latency", channel_get_latency(channel, &hist) == GENERIC_ERROR);
+    mu_assert("test_latency_histogram: Could not enable latency", channel_latency_enable(channel) == SUCCESS);
+    latency_load_args args = {channel, MESSAGES};
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_latency_producer, &args);
+    void* batch[4];
+    size_t received = 0;
+    while (received < MESSAGES) {
+        size_t count = 0;
+        if (received % 2 == 0) {
+            mu_assert("test_latency_histogram: Receive failed", channel_receive(channel, batch) == SUCCESS);
+            count = 1;
+        } else {
+            mu_assert("test_latency_histogram: Receive failed", channel_receive_batch(channel, batch, 4, &count) == SUCCESS);
+        }
+        received += count;
+    }
+    pthread_join(pid, NULL);
+    mu_assert("test_latency_histogram: Could not read latency", channel_get_latency(channel, &hist) == SUCCESS);
+    mu_assert("test_latency_histogram: Not every message was recorded", hist.count == MESSAGES);
+    mu_assert("test_latency_histogram: Percentiles not ordered",
+              latency_hist_percentile(&hist, 50.0) <= latency_hist_percentile(&hist, 99.0) &&
+              latency_hist_percentile(&hist, 99.0) <= latency_hist_percentile(&hist, 99.9) &&
+              latency_hist_percentile(&hist, 99.9) <= hist.max);
+    latency_hist_print(stdout, "test_latency_histogram: capacity 16", &hist);
+
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+
+char* test_lock_profile() {
+    print_test_details(__func__, "Testing channel_lock contention profiling");
+
+    channel_lock_profile_t profile;
+    channel_t* channel = channel_create(1);
+#if CHANNEL_LOCK_PROFILE
+    /* two producers fight over a single slot while a select waits on the channel */
+    size_t MESSAGES = 2000;
+    latency_load_args args = {channel, MESSAGES};
+    pthread_t producers[2];
+    for (size_t i = 0; i < 2; i++) {
+        pthread_create(&producers[i], NULL, (void *)helper_latency_producer, &args);
+    }
+    select_t list[1];
+    list[0].channel = channel;
+    list[0].dir = RECV;
+    size_t selected_index = 0;
+    void* data = NULL;
+    for (size_t received = 0; received < 2 * MESSAGES; received++) {
+        if (received % 8 == 0) {
+            mu_assert("test_lock_profile: Select failed", channel_select(list, 1, &selected_index) == SUCCESS);
+        } else {
+            mu_assert("test_lock_profile: Receive failed", channel_receive(channel, &data) == SUCCESS);
+        }
+    }
+    for (size_t i = 0; i < 2; i++) {
+        pthread_join(producers[i], NULL);
+    }
+    channel_close(channel);
+
+    mu_assert("test_lock_profile: Could not read profile", channel_get_lock_profile(channel, &profile) == SUCCESS);
+    channel_lock_op_profile_t* send = &profile.ops[CHANNEL_LOCK_SEND];
+    channel_lock_op_profile_t* receive = &profile.ops[CHANNEL_LOCK_RECEIVE];
+    channel_lock_op_profile_t* select = &profile.ops[CHANNEL_LOCK_SELECT];
+    mu_assert("test_lock_profile: Send acquisitions not counted", send->acquisitions >= 2 * MESSAGES);
+    mu_assert("test_lock_profile: Receive acquisitions not counted", receive->acquisitions >= 2 * MESSAGES - 2 * MESSAGES / 8);
+    mu_assert("test_lock_profile: Select acquisitions not counted", select->acquisitions >= 2 * MESSAGES / 8);
+    mu_assert("test_lock_profile: Close not counted", profile.ops[CHANNEL_LOCK_CLOSE].acquisitions == 1);
+    mu_assert("test_lock_profile: Hold time not counted", send->hold_ns > 0 && receive->hold_ns > 0 && select->hold_ns > 0);
+    mu_assert("test_lock_profile: Max hold exceeds total", send->max_hold_ns <= send->hold_ns);
+    mu_assert("test_lock_profile: More contention than acquisitions", send->contended <= send->acquisitions);
+    mu_assert("test_lock_profile: Contention without wait time", send->contended == 0 || send->wait_ns > 0);
+    channel_lock_profile_print(stdout, "test_lock_profile:", &profile);
+#else
+    mu_assert("test_lock_profile: Profiling should be compiled out", channel_get_lock_profile(channel, &profile) == GENERIC_ERROR);
+    channel_close(channel);
+#endif
+    channel_destroy(channel);
+    return NULL;
+}
+
+
+// Returns the contents of a file written by the trace exporter
+static char* read_whole_file(FILE* file) {
+    long size = ftell(file);
+    rewind(file);
+    char* contents = malloc((size_t)size + 1);
+    size_t length = fread(contents, 1, (size_t)size, file);
+    contents[length] = '\0';
+    return contents;
+}
+
+char* test_trace() {
+    print_test_details(__func__, "Testing the channel event trace and its Chrome trace export");
+
+    channel_t* channel = channel_create(1);
+    channel_t* other = channel_create(1);
+    trace_start(1);
+
+    /* a receiver blocks until the main thread sends */
+    pthread_t receiver;
+    sem_t done;
+    sem_init(&done, 0, 0);
+    receive_args data_receive;
+    init_object_for_receive_api(&data_receive, channel, &done);
+    pthread_create(&receiver, NULL, (void *)helper_receive, &data_receive);
+    usleep(10000);
+    mu_assert("test_trace: Send failed", channel_send(channel, "Message1") == SUCCESS);
+    sem_wait(&done);
+    pthread_join(receiver, NULL);
+
+    /* a select registers itself, blocks and is woken by a close */
+    pthread_t selector;
+    select_t list[1];
+    list[0].channel = other;
+    list[0].dir = RECV;
+    select_args data_select;
+    init_object_for_select_api(&data_select, list, 1, &done);
+    pthread_create(&selector, NULL, (void *)helper_select, &data_select);
+    usleep(10000);
+    channel_close(other);
+    sem_wait(&done);
+    pthread_join(selector, NULL);
+    trace_stop();
+
+    FILE* file = tmpfile();
+    size_t written = trace_write_chrome_json(file);
+    char* json = read_whole_file(file);
+    fclose(file);
+#if CHANNEL_TRACE
+    mu_assert("test_trace: Too few events", written >= 12);
+    mu_assert("test_trace: Missing operation slices", strstr(json, "\"name\":\"receive\",\"ph\":\"B\"") != NULL &&
+                                                       strstr(json, "\"name\":\"send\",\"ph\":\"E\"") != NULL &&
+                                                       strstr(json, "\"name\":\"select\",\"ph\":\"E\"") != NULL);
+    mu_assert("test_trace: Missing block/wake", strstr(json, "\"name\":\"block\"") != NULL && strstr(json, "\"name\":\"wake\"") != NULL);
+    mu_assert("test_trace: Missing select registration", strstr(json, "\"name\":\"select_register\"") != NULL &&
+                                                         strstr(json, "\"name\":\"select_unregister\"") != NULL);
+    mu_assert("test_trace: Missing close", strstr(json, "\"name\":\"close\"") != NULL);
+#else
+    mu_assert("test_trace: Tracing should be compiled out", written == 0);
+#endif
+    free(json);
+
+    /* with sampling only one in four operations is recorded, begin and end */
+    channel_t* big = channel_create(200);
+    trace_start(4);
+    for (size_t i = 0; i < 100; i++) {
+        channel_non_blocking_send(big, "Message2");
+    }
+    trace_stop();
+    file = tmpfile();
+    written = trace_write_chrome_json(file);
+    fclose(file);
+    mu_assert("test_trace: Sampling not applied", written == (CHANNEL_TRACE ? 50 : 0));
+    mu_assert("test_trace: Events dropped", trace_dropped_events() == 0);
+    trace_free();
+
+    channel_close(channel);
+    channel_destroy(channel);
+    channel_destroy(other);
+    channel_close(big);
+    channel_destroy(big);
+    sem_destroy(&done);
+    return NULL;
+}
+
+
+// Returns the value of the sample of the given metric for the channel named name in an OpenMetrics dump, -1 if missing
+static long metric_value(const char* dump, const char* metric, const char* name) {
+    char prefix[128];
+    snprintf(prefix, sizeof(prefix), "\n%s{channel=\"%s\",", metric, name);
+    const char* line = strstr(dump, prefix);
+    if (line == NULL) {
+        return -1;
+    }
+    const char* value = strstr(line, "} ");
+    return value == NULL ? -1 : atol(value + 2);
+}
+
+// Generates a topology and writes it as an edge list to a per-process path, for run_stress to check the
+// routers' results against Floyd-Warshall on it
+// Returns 0 on success; graph, unless NULL, then holds the generated graph and the caller frees it
+static int write_generated_topology(char* path, size_t size, const topogen_config_t* config, topogen_graph_t* graph) {
+    snprintf(path, size, "/tmp/channel_topology_%d.txt", (int)getpid());
+    topogen_graph_t generated;
+    if (topogen_generate(config, &generated) != 0) {
+        return -1;
+    }
+    FILE* file = fopen(path, "w");
+    int status = file == NULL ? -1 : topogen_write_edges(file, &generated);
+    if (file != NULL) {
+        fclose(file);
+    }
+    if (status == 0 && graph != NULL) {
+        *graph = generated;
+    } else {
+        topogen_free(&generated);
+    }
+    return status;
+}
+
+char* test_channel_registry() {
+    print_test_details(__func__, "Testing the registry of live channels and its OpenMetrics dump");
+
+    size_t initial = channel_registry_count();
+    channel_t* requests = channel_create(2);
+    channel_t* replies = channel_create(1);
+    channel_set_name(requests, "requests");
+    channel_set_name(replies, "replies");
+    mu_assert("test_channel_registry: Channels not registered", channel_registry_count() == initial + 2);
+
+    /* requests is full with a blocked sender and a blocked select, replies has a blocked receiver */
+    channel_send(requests, "Message1");
+    channel_send(requests, "Message2");
+    pthread_t pid[3];
+    send_args data_send;
+    init_object_for_send_api(&data_send, requests, "Message3", NULL);
+    pthread_create(&pid[0], NULL, (void *)helper_send, &data_send);
+    select_t list[1];
+    list[0].channel = requests;
+    list[0].dir = SEND;
+    list[0].data = "Message4";
+    select_args data_select;
+    init_object_for_select_api(&data_select, list, 1, NULL);
+    pthread_create(&pid[1], NULL, (void *)helper_select, &data_select);
+    receive_args data_receive;
+    init_object_for_receive_api(&data_receive, replies, NULL);
+    pthread_create(&pid[2], NULL, (void *)helper_receive, &data_receive);
+    usleep(20000);
+
+    channel_info_t infos[64];
+    size_t count = channel_registry_snapshot(infos, 64);
+    mu_assert("test_channel_registry: Snapshot missed channels", count >= 2 && count < 64);
+    channel_info_t* replies_info = &infos[count - 1];
+    channel_info_t* requests_info = &infos[count - 2];
+    mu_assert("test_channel_registry: Not in creation order", requests_info->channel == requests && replies_info->channel == replies);
+    mu_assert("test_channel_registry: Wrong name", strcmp(requests_info->name, "requests") == 0);
+    mu_assert("test_channel_registry: Wrong depth", requests_info->capacity == 2 && requests_info->depth == 2);
+    mu_assert("test_channel_registry: Blocked sender not seen", requests_info->blocked_senders == 1 && requests_info->select_senders == 1);
+    mu_assert("test_channel_registry: Blocked receiver not seen", replies_info->blocked_receivers == 1 && replies_info->depth == 0);
+
+    FILE* file = tmpfile();
+    mu_assert("test_channel_registry: Dump missed channels", channel_registry_dump(file) >= 2);
+    char* dump = read_whole_file(file);
+    fclose(file);
+    mu_assert("test_channel_registry: Dump not terminated", strstr(dump, "# EOF\n") != NULL);
+    mu_assert("test_channel_registry: Wrong depth in dump", metric_value(dump, "channel_depth", "requests") == 2);
+    mu_assert("test_channel_registry: Wrong blocked senders in dump", metric_value(dump, "channel_blocked_senders", "requests") == 1);
+    mu_assert("test_channel_registry: Wrong select senders in dump", metric_value(dump, "channel_select_senders", "requests") == 1);
+    mu_assert("test_channel_registry: Wrong blocked receivers in dump", metric_value(dump, "channel_blocked_receivers", "replies") == 1);
+    mu_assert("test_channel_registry: Wrong closed state in dump", metric_value(dump, "channel_closed", "replies") == 0);
+    free(dump);
+
+    /* the same dump is served on a Unix socket */
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/channel_registry_%d.sock", (int)getpid());
+    mu_assert("test_channel_registry: Could not serve", channel_registry_serve(path) == 0);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    mu_assert("test_channel_registry: Could not connect", connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0);
+    char served[16384];
+    size_t length = 0;
+    ssize_t got;
+    while (length < sizeof(served) - 1 && (got = read(fd, served + length, sizeof(served) - 1 - length)) > 0) {
+        length += (size_t)got;
+    }
+    served[length] = '\0';
+    close(fd);
+    channel_registry_serve_stop();
+    mu_assert("test_channel_registry: Served dump incomplete", strstr(served, "# EOF\n") != NULL);
+    mu_assert("test_channel_registry: Wrong depth in served dump", metric_value(served, "channel_depth", "requests") == 2);
+
+    channel_close(requests);
+    channel_close(replies);
+    for (size_t i = 0; i < 3; i++) {
+        pthread_join(pid[i], NULL);
+    }
+    count = channel_registry_snapshot(infos, 64);
+    mu_assert("test_channel_registry: Closed state not seen", infos[count - 1].closed && infos[count - 2].closed &&
+                                                              infos[count - 2].blocked_senders == 0);
+    channel_destroy(requests);
+    channel_destroy(replies);
+    mu_assert("test_channel_registry: Channels not unregistered", channel_registry_count() == initial);
+    return NULL;
+}
+
+
+typedef struct {
+    channel_t* own;   // channel this thread sends on first
+    channel_t* other; // channel it then blocks receiving from
+    sem_t* sent;
+    sem_t* go;
+} deadlock_args;
+
+void* helper_deadlock(deadlock_args* myargs) {
+    channel_send(myargs->own, "Message");
+    sem_post(myargs->sent);
+    sem_wait(myargs->go);
+    void* data = NULL;
+    channel_receive(myargs->other, &data);
+    return NULL;
+}
+
+char* test_watchdog() {
+    print_test_details(__func__, "Testing the stall and deadlock watchdog");
+
+    uint64_t THRESHOLD = 5000000;
+    mu_assert("test_watchdog: Could not start", watchdog_start(THRESHOLD, 1000000000ull, NULL) == 0);
+    mu_assert("test_watchdog: Started twice", watchdog_start(THRESHOLD, 1000000000ull, NULL) == -1);
+
+    /* a receiver on a channel nobody ever sent on is stalled, but not deadlocked */
+    channel_t* idle = channel_create(1);
+    channel_set_name(idle, "idle");
+    pthread_t pid[2];
+    receive_args data_receive;
+    init_object_for_receive_api(&data_receive, idle, NULL);
+    pthread_create(&pid[0], NULL, (void *)helper_receive, &data_receive);
+    usleep(20000);
+    FILE* file = tmpfile();
+    watchdog_report_t report = watchdog_check(file, THRESHOLD);
+    char* output = read_whole_file(file);
+    fclose(file);
+    mu_assert("test_watchdog: Stall not seen", report.blocked == 1 && report.stalled == 1 && report.deadlocked == 0);
+    mu_assert("test_watchdog: Stall not reported", strstr(output, "in receive on 1 channel") != NULL &&
+                                                   strstr(output, "receive from \"idle\"") != NULL &&
+                                                   strstr(output, "an unknown sender") != NULL);
+    free(output);
+    channel_close(idle);
+    pthread_join(pid[0], NULL);
+    report = watchdog_check(NULL, 0);
+    mu_assert("test_watchdog: Woken thread still blocked", report.blocked == 0);
+
+    /* two threads each wait for a message only the other one ever sends */
+    channel_t* left = channel_create(1);
+    channel_t* right = channel_create(1);
+    sem_t sent, go;
+    sem_init(&sent, 0, 0);
+    sem_init(&go, 0, 0);
+    deadlock_args args[2] = {{left, right, &sent, &go}, {right, left, &sent, &go}};
+    for (size_t i = 0; i < 2; i++) {
+        pthread_create(&pid[i], NULL, (void *)helper_deadlock, &args[i]);
+    }
+    void* data = NULL;
+    for (size_t i = 0; i < 2; i++) {
+        sem_wait(&sent);
+    }
+    channel_receive(left, &data);
+    channel_receive(right, &data);
+    for (size_t i = 0; i < 2; i++) {
+        sem_post(&go);
+    }
+    usleep(20000);
+    file = tmpfile();
+    report = watchdog_check(file, THRESHOLD);
+    output = read_whole_file(file);
+    fclose(file);
+    mu_assert("test_watchdog: Deadlock not detected", report.stalled == 2 && report.deadlocked == 2);
+    mu_assert("test_watchdog: Deadlock cycle not reported", strstr(output, "watchdog: deadlock: thread") != NULL);
+    free(output);
+
+    /* closing the channels releases both threads */
+    channel_close(left);
+    channel_close(right);
+    for (size_t i = 0; i < 2; i++) {
+        pthread_join(pid[i], NULL);
+    }
+    watchdog_stop();
+    channel_destroy(idle);
+    channel_destroy(left);
+    channel_destroy(right);
+    sem_destroy(&sent);
+    sem_destroy(&go);
+    return NULL;
+}
+
+char* test_stress_send_recv_report() {
+    print_test_details(__func__, "Testing hop counting and occupancy reporting of the send/recv ring");
+
+    size_t thread_counts[] = {1, 4};
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+        stress_send_recv_report_t report;
+        run_stress_send_recv_report(4, thread_counts[t], 0.5, 100000, &report);
+        mu_assert("test_stress_send_recv_report: Wrong run parameters",
+                  report.num_threads == thread_counts[t] && report.buffer_size == 4 && report.messages == thread_counts[t] * 5 / 2);
+        mu_assert("test_stress_send_recv_report: No messages passed along the ring", report.hops > 0 && report.hops_per_sec > 0);
+
+        /* every hop is made by exactly one thread and carries exactly one message */
+        uint64_t thread_total = 0;
+        uint64_t fewest = UINT64_MAX;
+        uint64_t most = 0;
+        for (size_t i = 0; i < report.num_threads; i++) {
+            thread_total += report.thread_hops[i];
+            fewest = report.thread_hops[i] < fewest ? report.thread_hops[i] : fewest;
+            most = report.thread_hops[i] > most ? report.thread_hops[i] : most;
+        }
+        mu_assert("test_stress_send_recv_report: Thread hops do not add up", thread_total == report.hops);
+        mu_assert("test_stress_send_recv_report: Message hops do not add up",
+                  report.min_message_hops * report.messages <= report.hops && report.hops <= report.max_message_hops * report.messages);
+        /* messages visit the threads in ring order, so no thread can fall more than one lap per message behind */
+        mu_assert("test_stress_send_recv_report: Threads out of step", most - fewest <= report.messages);
+        mu_assert("test_stress_send_recv_report: Occupancy out of range", report.occupancy >= 0 && report.occupancy <= 1);
+
+        FILE* out = tmpfile();
+        mu_assert("test_stress_send_recv_report: tmpfile failed", out != NULL);
+        stress_send_recv_report_print(out, &report);
+        char* output = read_whole_file(out);
+        fclose(out);
+        mu_assert("test_stress_send_recv_report: Summary missing hops per thread", strstr(output, "hops per thread:") != NULL);
+        free(output);
+        free(report.thread_hops);
+    }
+    return NULL;
+}
+
+char* test_loadgen() {
+    print_test_details(__func__, "Testing the open-loop load generator");
+
+    loadgen_report_t report;
+    loadgen_config_t invalid = {LOADGEN_CONSTANT, 0, 100000000, 0, 0, 16, 1, 0, 1};
+    mu_assert("test_loadgen: Zero rate accepted", loadgen_run(&invalid, &report) == -1);
+    invalid.rate = 1000;
+    invalid.arrival = LOADGEN_BURSTY;
+    mu_assert("test_loadgen: Bursty without on period accepted", loadgen_run(&invalid, &report) == -1);
+    invalid.arrival = LOADGEN_CONSTANT;
+    invalid.buffer_size = 0;
+    mu_assert("test_loadgen: Unbuffered channel accepted", loadgen_run(&invalid, &report) == -1);
+
+    /* constant arrivals: exactly rate * duration messages, every one measured */
+    loadgen_config_t config = {LOADGEN_CONSTANT, 10000, 100000000, 0, 0, 16, 1, 0, 1};
+    mu_assert("test_loadgen: Constant run failed", loadgen_run(&config, &report) == 0);
+    mu_assert("test_loadgen: Wrong number of constant arrivals", report.sent == 1000);
+    mu_assert("test_loadgen: Not every message measured", report.latency.count == report.sent);
+
+    /* Poisson arrivals: about rate * duration messages, reproducible from the seed */
+    config.arrival = LOADGEN_POISSON;
+    mu_assert("test_loadgen: Poisson run failed", loadgen_run(&config, &report) == 0);
+    size_t poisson_sent = report.sent;
+    mu_assert("test_loadgen: Poisson rate far off", poisson_sent > 800 && poisson_sent < 1200);
+    mu_assert("test_loadgen: Poisson run failed", loadgen_run(&config, &report) == 0);
+    mu_assert("test_loadgen: Same seed gave a different schedule", report.sent == poisson_sent);
+
+    /* bursty arrivals keep the mean rate: 10 ms on, 10 ms off over 100 ms */
+    config.arrival = LOADGEN_BURSTY;
+    config.burst_on_ns = 10000000;
+    config.burst_off_ns = 10000000;
+    mu_assert("test_loadgen: Bursty run failed", loadgen_run(&config, &report) == 0);
+    mu_assert("test_loadgen: Wrong number of bursty arrivals", report.sent == 1000);
+
+    /* overload: arrivals every 100 us against 400 us of service, so the backlog and the latency keep growing
+     * even though the generator itself only ever waits for space in the channel */
+    config.arrival = LOADGEN_CONSTANT;
+    config.rate = 10000;
+    config.duration_ns = 50000000;
+    config.buffer_size = 4;
+    config.service_ns = 400000;
+    mu_assert("test_loadgen: Overload run failed", loadgen_run(&config, &report) == 0);
+    mu_assert("test_loadgen: Wrong number of overload arrivals", report.sent == 500);
+    mu_assert("test_loadgen: Generator did not fall behind", report.max_lag_ns > 10000000);
+    mu_assert("test_loadgen: Queueing delay not counted", report.latency.max > 100000000);
+    mu_assert("test_loadgen: Achieved rate above capacity", report.achieved_rate < 3000);
+
+    FILE* out = tmpfile();
+    mu_assert("test_loadgen: tmpfile failed", out != NULL);
+    loadgen_report_print(out, "overload", &report);
+    char* output = read_whole_file(out);
+    fclose(out);
+    mu_assert("test_loadgen: Summary missing rates", strstr(output, "overload: 500 messages, offered") != NULL);
+    free(output);
+    return NULL;
+}
+
+char* test_topogen() {
+    print_test_details(__func__, "Testing the synthetic topology generator");
+
+    topogen_graph_t graph;
+    topogen_config_t config = {TOPOGEN_RING, 0, 4, 1, 1};
+    mu_assert("test_topogen: Empty graph accepted", topogen_generate(&config, &graph) == -1);
+    config.num_nodes = 10;
+    config.max_cost = 0;
+    mu_assert("test_topogen: Zero max cost accepted", topogen_generate(&config, &graph) == -1);
+    config.max_cost = 5;
+
+    size_t expected_edges[] = {2 * 10, 2 * 13, 0, 2 * (6 + 4 * 6), 10 * 9};
+    for (size_t kind = 0; kind < TOPOGEN_KIND_COUNT; kind++) {
+        config.kind = (enum topogen_kind)kind;
+        mu_assert("test_topogen: Kind name does not round trip",
+                  topogen_kind_from_name(topogen_kind_name(config.kind)) == config.kind);
+        mu_assert("test_topogen: Generation failed", topogen_generate(&config, &graph) == 0);
+        mu_assert("test_topogen: Wrong node count", graph.num_nodes == 10);
+        if (config.kind != TOPOGEN_GEOMETRIC) {
+            mu_assert("test_topogen: Wrong link count", graph.num_edges == expected_edges[kind]);
+        }
+        for (size_t i = 0; i < graph.num_edges; i++) {
+            topogen_edge_t* edge = &graph.edges[i];
+            mu_assert("test_topogen: Bad link", edge->src != edge->dst && edge->dst < 10 && edge->cost >= 1 && edge->cost <= 5);
+            mu_assert("test_topogen: Links not sorted", i == 0 || edge->src > edge[-1].src || (edge->src == edge[-1].src && edge->dst > edge[-1].dst));
+            /* every link exists in both directions with the same cost */
+            bool reverse = false;
+            for (size_t j = 0; j < graph.num_edges; j++) {
+                reverse = reverse || (graph.edges[j].src == edge->dst && graph.edges[j].dst == edge->src && graph.edges[j].cost == edge->cost);
+            }
+            mu_assert("test_topogen: Link not symmetric", reverse);
+        }
+        topogen_free(&graph);
+    }
+    mu_assert("test_topogen: Unknown kind accepted", topogen_kind_from_name("torus") == TOPOGEN_KIND_COUNT);
+
+    /* the same seed gives the same graph */
+    config.kind = TOPOGEN_GEOMETRIC;
+    config.num_nodes = 200;
+    topogen_graph_t again;
+    mu_assert("test_topogen: Generation failed", topogen_generate(&config, &graph) == 0);
+    mu_assert("test_topogen: Generation failed", topogen_generate(&config, &again) == 0);
+    mu_assert("test_topogen: Same seed gave a different graph", graph.num_edges == again.num_edges &&
+              memcmp(graph.edges, again.edges, sizeof(topogen_edge_t) * graph.num_edges) == 0);
+    topogen_free(&again);
+
+    FILE* out = tmpfile();
+    mu_assert("test_topogen: tmpfile failed", out != NULL);
+    mu_assert("test_topogen: Writing edges failed", topogen_write_edges(out, &graph) == 0);
+    char* output = read_whole_file(out);
+    fclose(out);
+    char header[64];
+    snprintf(header, sizeof(header), "edges 200 %zu\n", graph.num_edges);
+    mu_assert("test_topogen: Wrong edge list header", strncmp(output, header, strlen(header)) == 0);
+    free(output);
+    topogen_free(&graph);
+    return NULL;
+}
+
+char* test_stress_report() {
+    print_test_details(__func__, "Testing router stress reporting on generated topologies in both file formats");
+
+    stress_report_t report;
+    run_stress_report(1, 1, "topology.txt", &report);
+    mu_assert("test_stress_report: Wrong topology size", report.num_nodes == 10 && report.num_links == 20);
+    mu_assert("test_stress_report: No distance vectors sent", report.messages >= report.num_links);
+    mu_assert("test_stress_report: Fewer selects than messages", report.selects >= report.messages);
+    mu_assert("test_stress_report: Missing timings", report.converge_seconds > 0 && report.setup_seconds > 0);
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/channel_topology_%d.txt", (int)getpid());
+    for (size_t kind = 0; kind < TOPOGEN_KIND_COUNT; kind++) {
+        for (int edges = 0; edges <= 1; edges++) {
+            topogen_config_t config = {(enum topogen_kind)kind, 24, 3, 9, kind + 1};
+            topogen_graph_t graph;
+            mu_assert("test_stress_report: Generation failed", topogen_generate(&config, &graph) == 0);
+            FILE* file = fopen(path, "w");
+            mu_assert("test_stress_report: Could not write topology", file != NULL);
+            int status = edges ? topogen_write_edges(file, &graph) : topogen_write_matrix(file, &graph);
+            fclose(file);
+            mu_assert("test_stress_report: Writing topology failed", status == 0);
+            run_stress_report(1, 1, path, &report);
+            mu_assert("test_stress_report: Wrong generated topology", report.num_nodes == 24 && report.num_links == graph.num_edges);
+            topogen_free(&graph);
+        }
+    }
+
+    /* routers without links are converged from the start, and must not wait for a message that never comes */
+    FILE* file = fopen(path, "w");
+    mu_assert("test_stress_report: Could not write topology", file != NULL);
+    fprintf(file, "2\n0 -1\n-1 0\n");
+    fclose(file);
+    run_stress_report(1, 1, path, &report);
+    mu_assert("test_stress_report: Messages without links", report.num_links == 0 && report.messages == 0);
+    unlink(path);
+    return NULL;
+}
+
+char* test_floyd_warshall() {
+    print_test_details(__func__, "Testing that the blocked parallel Floyd-Warshall matches the reference bit for bit");
+
+    /* sizes around the tile edge, random links including missing ones and costs near inf_distance */
+    size_t sizes[] = {1, 2, 7, APSP_TILE - 1, APSP_TILE, APSP_TILE + 1, 3 * APSP_TILE + 5};
+    size_t thread_counts[] = {1, 3, 0};
+    unsigned int seed = 12345;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        distance_t* links = malloc(sizeof(distance_t) * n * n);
+        distance_t* expected = malloc(sizeof(distance_t) * n * n);
+        distance_t* actual = malloc(sizeof(distance_t) * n * n);
+        mu_assert("test_floyd_warshall: malloc failed", links != NULL && expected != NULL && actual != NULL);
+        for (size_t i = 0; i < n * n; i++) {
+            unsigned int r = (unsigned int)rand_r(&seed);
+            if (i / n == i % n) {
+                links[i] = 0;
+            } else if (r % 4 != 0) {
+                links[i] = inf_distance;
+            } else {
+                links[i] = r % 8 == 0 ? inf_distance - 1 - (r % 100) : 1 + r % 1000;
+            }
+        }
+        memcpy(expected, links, sizeof(distance_t) * n * n);
+        apsp_floyd_warshall_reference(expected, n);
+        for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+            memcpy(actual, links, sizeof(distance_t) * n * n);
+            apsp_floyd_warshall(actual, n, thread_counts[t]);
+            mu_assert("test_floyd_warshall: Blocked result differs from the reference",
+                      memcmp(actual, expected, sizeof(distance_t) * n * n) == 0);
+        }
+        free(links);
+        free(expected);
+        free(actual);
+    }
+    return NULL;
+}
+
+char* test_apsp_update() {
+    print_test_details(__func__, "Testing that incremental shortest path updates match Floyd-Warshall from scratch");
+
+    /* links getting cheaper, dearer, going down and coming up, on a graph sparse enough to have no path at times */
+    size_t n = 50;
+    distance_t* links = malloc(sizeof(distance_t) * n * n);
+    distance_t* expected = malloc(sizeof(distance_t) * n * n);
+    distance_t* actual = malloc(sizeof(distance_t) * n * n);
+    mu_assert("test_apsp_update: malloc failed", links != NULL && expected != NULL && actual != NULL);
+    unsigned int seed = 4242;
+    for (size_t i = 0; i < n * n; i++) {
+        unsigned int r = (unsigned int)rand_r(&seed);
+        links[i] = i / n == i % n ? 0 : r % 16 == 0 ? 1 + r % 100 : inf_distance;
+    }
+    memcpy(actual, links, sizeof(distance_t) * n * n);
+    apsp_floyd_warshall_reference(actual, n);
+    size_t recomputed = 0;
+    for (size_t step = 0; step < 300; step++) {
+        unsigned int r = (unsigned int)rand_r(&seed);
+        size_t src = (size_t)rand_r(&seed) % n;
+        size_t dst = (size_t)rand_r(&seed) % n;
+        if (src == dst) {
+            continue;
+        }
+        distance_t old_cost = links[src * n + dst];
+        links[src * n + dst] = r % 4 == 0 ? inf_distance : 1 + r % 100;
+        size_t rows = apsp_update_link(actual, links, n, src, dst, old_cost);
+        mu_assert("test_apsp_update: Rows recomputed for a cheaper link", links[src * n + dst] > old_cost || rows == 0);
+        recomputed += rows;
+        memcpy(expected, links, sizeof(distance_t) * n * n);
+        apsp_floyd_warshall_reference(expected, n);
+        mu_assert("test_apsp_update: Distances differ from a full recomputation",
+                  memcmp(actual, expected, sizeof(distance_t) * n * n) == 0);
+    }
+    mu_assert("test_apsp_update: Dearer links never recomputed anything", recomputed > 0);
+    mu_assert("test_apsp_update: Every row recomputed every time", recomputed < 300 * n / 4);
+    free(links);
+    free(expected);
+    free(actual);
+    return NULL;
+}
+
+char* test_minplus() {
+    print_test_details(__func__, "Testing every min-plus kernel this CPU supports against the scalar definition");
+
+    enum minplus_impl detected = minplus_current();
+    mu_assert("test_minplus: Scalar kernel not available", minplus_use(MINPLUS_SCALAR) == 0);
+    mu_assert("test_minplus: Unknown kernel accepted", minplus_use(MINPLUS_IMPL_COUNT) == -1);
+    unsigned int seed = 777;
+    distance_t dist[80];
+    distance_t through[80];
+    distance_t expected[80];
+    for (int impl = MINPLUS_SCALAR; impl < MINPLUS_IMPL_COUNT; impl++) {
+        if (minplus_use((enum minplus_impl)impl) != 0) {
+            continue; /* not supported here */
+        }
+        mu_assert("test_minplus: Kernel not selected", minplus_current() == (enum minplus_impl)impl);
+        /* every length and misalignment around the vector widths, with unreachable entries and offsets */
+        for (size_t count = 0; count <= 40; count++) {
+            for (size_t start = 0; start < 8; start++) {
+                distance_t offset = rand_r(&seed) % 5 == 0 ? inf_distance : (distance_t)(rand_r(&seed) % 50);
+                for (size_t i = 0; i < 80; i++) {
+                    dist[i] = rand_r(&seed) % 4 == 0 ? inf_distance : (distance_t)(rand_r(&seed) % 100);
+                    through[i] = rand_r(&seed) % 4 == 0 ? inf_distance : (distance_t)(rand_r(&seed) % 100);
+                }
+                bool expected_changed = false;
+                memcpy(expected, dist, sizeof(dist));
+                for (size_t i = start; i < start + count; i++) {
+                    if (offset + through[i] < expected[i]) {
+                        expected[i] = offset + through[i];
+                        expected_changed = true;
+                    }
+                }
+                bool changed = minplus_relax(&dist[start], &through[start], offset, count);
+                mu_assert("test_minplus: Wrong distances", memcmp(dist, expected, sizeof(dist)) == 0);
+                mu_assert("test_minplus: Wrong change flag", changed == expected_changed);
+                /* relaxing again through the same vector changes nothing */
+                mu_assert("test_minplus: Change reported on a fixpoint", !minplus_relax(&dist[start], &through[start], offset, count));
+            }
+        }
+        /* in place, as Floyd-Warshall does on row k: a zero offset leaves everything as it is */
+        memcpy(expected, dist, sizeof(dist));
+        mu_assert("test_minplus: In-place relaxation changed something", !minplus_relax(dist, dist, 0, 80));
+        mu_assert("test_minplus: In-place relaxation wrote something", memcmp(dist, expected, sizeof(dist)) == 0);
+    }
+    mu_assert("test_minplus: Could not restore kernel", minplus_use(detected) == 0);
+    return NULL;
+}
+
+char* test_topology() {
+    print_test_details(__func__, "Testing the parallel sparse topology loader and binary topologies against hand-written and generated files");
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/channel_topology_%d.txt", (int)getpid());
+    mu_assert("test_topology: Missing file loaded", topology_load("/nonexistent/topology.txt", 0) == NULL);
+
+    /* dense matrix: negative entries mean no link and the diagonal is ignored */
+    FILE* file = fopen(path, "w");
+    mu_assert("test_topology: Could not write topology", file != NULL);
+    fprintf(file, "3\n5 2 -1\n-1 0 7\n4 -3 9\n");
+    fclose(file);
+    topology_t* topology = topology_load(path, 1);
+    mu_assert("test_topology: Matrix not loaded", topology != NULL && topology->num_nodes == 3 && topology->num_links == 3);
+    mu_assert("test_topology: Wrong matrix links",
+              topology_link(topology, 0, 1) == 2 && topology_link(topology, 0, 2) == inf_distance &&
+              topology_link(topology, 1, 0) == inf_distance && topology_link(topology, 1, 2) == 7 &&
+              topology_link(topology, 2, 0) == 4 && topology_link(topology, 2, 1) == inf_distance);
+    mu_assert("test_topology: Wrong self distance", topology_link(topology, 0, 0) == 0 && topology_link(topology, 2, 2) == 0);
+    mu_assert("test_topology: Wrong degrees",
+              topology_degree(topology, 0) == 1 && topology_degree(topology, 1) == 1 && topology_degree(topology, 2) == 1);
+    topology_free(topology);
+
+    /* edge list: lines in any order, the last line for a link wins even when it removes the link */
+    file = fopen(path, "w");
+    mu_assert("test_topology: Could not write topology", file != NULL);
+    fprintf(file, "edges 4 7\n3 0 6\n0 2 5\n0 1 9\n0 2 1\n1 1 3\n3 0 -1\n2 3 8\n");
+    fclose(file);
+    topology = topology_load(path, 1);
+    mu_assert("test_topology: Edge list not loaded", topology != NULL && topology->num_nodes == 4 && topology->num_links == 3);
+    mu_assert("test_topology: Wrong edge list links",
+              topology_link(topology, 0, 1) == 9 && topology_link(topology, 0, 2) == 1 && topology_link(topology, 2, 3) == 8 &&
+              topology_link(topology, 3, 0) == inf_distance && topology_link(topology, 1, 1) == 0);
+    mu_assert("test_topology: Targets not sorted", topology->targets[0] == 1 && topology->targets[1] == 2);
+    mu_assert("test_topology: Wrong offsets", topology->offsets[1] == 2 && topology->offsets[2] == 2 && topology->offsets[4] == 3);
+    topology_free(topology);
+
+    /* any whitespace between integers, signs, and no newline at the end */
+    file = fopen(path, "w");
+    mu_assert("test_topology: Could not write topology", file != NULL);
+    fprintf(file, "  2\r\n\t0   +3\r\n-0 -17");
+    fclose(file);
+    topology = topology_load(path, 1);
+    mu_assert("test_topology: Odd spacing not loaded", topology != NULL && topology->num_nodes == 2 && topology->num_links == 2);
+    mu_assert("test_topology: Wrong odd spacing links", topology_link(topology, 0, 1) == 3 && topology_link(topology, 1, 0) == 0);
+    mu_assert("test_topology: Wrong file size", topology->file_bytes == 20);
+    topology_free(topology);
+
+    /* files large enough to be split between threads give the same topology whatever the split */
+    for (int edges = 0; edges <= 1; edges++) {
+        topogen_config_t config = {TOPOGEN_GEOMETRIC, 500, 40, 1000000, 99};
+        topogen_graph_t graph;
+        mu_assert("test_topology: Generation failed", topogen_generate(&config, &graph) == 0);
+        file = fopen(path, "w");
+        mu_assert("test_topology: Could not write topology", file != NULL);
+        int status = edges ? topogen_write_edges(file, &graph) : topogen_write_matrix(file, &graph);
+        fclose(file);
+        mu_assert("test_topology: Writing topology failed", status == 0);
+        size_t thread_counts[] = {1, 2, 3, 8, 0};
+        topology_t* single = NULL;
+        for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+            topology = topology_load(path, thread_counts[t]);
+            mu_assert("test_topology: Split topology not loaded", topology != NULL && topology->num_links == graph.num_edges);
+            mu_assert("test_topology: File too small to split", topology->file_bytes > 8 * TOPOLOGY_PARSE_CHUNK || edges);
+            if (single == NULL) {
+                single = topology;
+                continue;
+            }
+            mu_assert("test_topology: Split changed the topology",
+                      memcmp(single->offsets, topology->offsets, sizeof(size_t) * 501) == 0 &&
+                      memcmp(single->targets, topology->targets, sizeof(uint32_t) * graph.num_edges) == 0 &&
+                      memcmp(single->costs, topology->costs, sizeof(distance_t) * graph.num_edges) == 0);
+            topology_free(topology);
+        }
+        for (size_t i = 0; i < graph.num_edges; i++) {
+            mu_assert("test_topology: Split topology lost a link",
+                      topology_link(single, graph.edges[i].src, graph.edges[i].dst) == graph.edges[i].cost);
+        }
+        topology_free(single);
+        topogen_free(&graph);
+    }
+
+    /* both formats of every generated kind load to the same links, and the matrix matches topology_link */
+    for (size_t kind = 0; kind < TOPOGEN_KIND_COUNT; kind++) {
+        topogen_config_t config = {(enum topogen_kind)kind, 40, 3, 50, kind + 7};
+        topogen_graph_t graph;
+        mu_assert("test_topology: Generation failed", topogen_generate(&config, &graph) == 0);
+        topology_t* loaded[2];
+        for (int edges = 0; edges <= 1; edges++) {
+            file = fopen(path, "w");
+            mu_assert("test_topology: Could not write topology", file != NULL);
+            int status = edges ? topogen_write_edges(file, &graph) : topogen_write_matrix(file, &graph);
+            fclose(file);
+            mu_assert("test_topology: Writing topology failed", status == 0);
+            loaded[edges] = topology_load(path, 0);
+            mu_assert("test_topology: Generated topology not loaded", loaded[edges] != NULL);
+            mu_assert("test_topology: Wrong generated size",
+                      loaded[edges]->num_nodes == 40 && loaded[edges]->num_links == graph.num_edges);
+        }
+        mu_assert("test_topology: Formats disagree on offsets",
+                  memcmp(loaded[0]->offsets, loaded[1]->offsets, sizeof(size_t) * 41) == 0);
+        mu_assert("test_topology: Formats disagree on links",
+                  memcmp(loaded[0]->targets, loaded[1]->targets, sizeof(uint32_t) * graph.num_edges) == 0 &&
+                  memcmp(loaded[0]->costs, loaded[1]->costs, sizeof(distance_t) * graph.num_edges) == 0);
+        distance_t* dist = malloc(sizeof(distance_t) * 40 * 40);
+        mu_assert("test_topology: malloc failed", dist != NULL);
+        topology_to_matrix(loaded[1], dist);
+        for (size_t src = 0; src < 40; src++) {
+            for (size_t dst = 0; dst < 40; dst++) {
+                mu_assert("test_topology: Matrix differs from the links", dist[src * 40 + dst] == topology_link(loaded[1], src, dst));
+            }
+        }
+        for (size_t i = 0; i < graph.num_edges; i++) {
+            mu_assert("test_topology: Generated link missing",
+                      topology_link(loaded[1], graph.edges[i].src, graph.edges[i].dst) == graph.edges[i].cost);
+        }
+        free(dist);
+        topology_free(loaded[0]);
+        topology_free(loaded[1]);
+        topogen_free(&graph);
+    }
+
+    /* binary files map back to the same arrays, with the solution when it was written, and run_stress uses them */
+    char binary_path[64];
+    snprintf(binary_path, sizeof(binary_path), "/tmp/channel_topology_%d.bin", (int)getpid());
+    topology = topology_load(path, 0);
+    mu_assert("test_topology: Generated topology not loaded", topology != NULL);
+    distance_t* solution = malloc(sizeof(distance_t) * 40 * 40);
+    mu_assert("test_topology: malloc failed", solution != NULL);
+    topology_to_matrix(topology, solution);
+    apsp_floyd_warshall(solution, 40, 1);
+    for (int solved = 0; solved <= 1; solved++) {
+        file = fopen(binary_path, "wb");
+        mu_assert("test_topology: Could not write binary topology", file != NULL);
+        int status = topology_write_binary(file, topology, solved ? solution : NULL);
+        fclose(file);
+        mu_assert("test_topology: Writing binary topology failed", status == 0);
+        topology_t* mapped = topology_load(binary_path, 0);
+        mu_assert("test_topology: Binary topology not loaded", mapped != NULL && mapped->mapping != NULL);
+        mu_assert("test_topology: Wrong binary size", mapped->num_nodes == 40 && mapped->num_links == topology->num_links);
+        mu_assert("test_topology: Binary topology differs",
+                  memcmp(mapped->offsets, topology->offsets, sizeof(size_t) * 41) == 0 &&
+                  memcmp(mapped->targets, topology->targets, sizeof(uint32_t) * topology->num_links) == 0 &&
+                  memcmp(mapped->costs, topology->costs, sizeof(distance_t) * topology->num_links) == 0);
+        mu_assert("test_topology: Wrong binary solution",
+                  solved ? mapped->solution != NULL && memcmp(mapped->solution, solution, sizeof(distance_t) * 40 * 40) == 0
+                         : mapped->solution == NULL);
+        topology_free(mapped);
+        stress_report_t report;
+        run_stress_report(1, 1, binary_path, &report);
+        mu_assert("test_topology: Wrong binary stress run", report.num_nodes == 40 && report.num_links == topology->num_links);
+    }
+
+    /* malformed binary files are rejected rather than trusted */
+    file = fopen(binary_path, "wb");
+    mu_assert("test_topology: Could not write binary topology", file != NULL);
+    mu_assert("test_topology: Writing binary topology failed", topology_write_binary(file, topology, solution) == 0);
+    fclose(file);
+    file = fopen(binary_path, "rb");
+    fseek(file, 0, SEEK_END);
+    size_t binary_size = (size_t)ftell(file);
+    rewind(file);
+    char* good = malloc(binary_size);
+    char* bad = malloc(binary_size);
+    mu_assert("test_topology: Could not read binary topology", fread(good, 1, binary_size, file) == binary_size);
+    fclose(file);
+    size_t* offsets = (size_t*)(bad + sizeof(topology_header_t));
+    uint32_t* targets = (uint32_t*)(offsets + 41);
+    distance_t* costs = (distance_t*)(targets + topology->num_links);
+    distance_t* stored_solution = costs + topology->num_links;
+    size_t busy = 0;
+    while (topology->offsets[busy + 1] - topology->offsets[busy] < 2) {
+        busy++;
+    }
+    /* a self-link replacing the largest target below busy (or its first) keeps the row sorted */
+    size_t self = topology->offsets[busy];
+    for (size_t k = topology->offsets[busy]; k < topology->offsets[busy + 1] && topology->targets[k] < busy; k++) {
+        self = k;
+    }
+    for (int corruption = 0; corruption < 8; corruption++) {
+        memcpy(bad, good, binary_size);
+        size_t bad_size = binary_size;
+        topology_header_t* header = (topology_header_t*)bad;
+        if (corruption == 0) {
+            bad_size--;
+        } else if (corruption == 1) {
+            /* the solution size overflows size_t */
+            header->num_nodes = UINT32_MAX;
+            header->flags |= TOPOLOGY_HAS_SOLUTION;
+        } else if (corruption == 2) {
+            offsets[1] = topology->num_links + 1;
+        } else if (corruption == 3) {
+            targets[0] = 40;
+        } else if (corruption == 4) {
+            uint32_t first = targets[topology->offsets[busy]];
+            targets[topology->offsets[busy]] = targets[topology->offsets[busy] + 1];
+            targets[topology->offsets[busy] + 1] = first;
+        } else if (corruption == 5) {
+            targets[self] = (uint32_t)busy;
+        } else if (corruption == 6) {
+            /* costs and solution entries above inf_distance would wrap when added */
+            costs[topology->num_links - 1] = inf_distance + 1;
+        } else {
+            stored_solution[40 * 40 - 1] = inf_distance + 1;
+        }
+        file = fopen(binary_path, "wb");
+        mu_assert("test_topology: Could not write binary topology", fwrite(bad, 1, bad_size, file) == bad_size);
+        fclose(file);
+        mu_assert("test_topology: Malformed binary topology loaded", topology_load(binary_path, 0) == NULL);
+    }
+    free(good);
+    free(bad);
+    free(solution);
+    topology_free(topology);
+    unlink(binary_path);
+    unlink(path);
+    return NULL;
+}
+
+char* test_stress_deltas() {
+    print_test_details(__func__, "Testing that delta distance vectors converge like whole ones with less to relax");
+
+    char path[64];
+    topogen_config_t topogen = {TOPOGEN_GEOMETRIC, 160, 4, 20, 3};
+    mu_assert("test_stress_deltas: Writing topology failed", write_generated_topology(path, sizeof(path), &topogen, NULL) == 0);
+
+    stress_config_t config = {1, 1, true, 0, STRESS_PARTITIONED};
+    stress_report_t full;
+    run_stress_config(path, &config, &full);
+    mu_assert("test_stress_deltas: Delta sent in full mode", full.delta_messages == 0);
+    mu_assert("test_stress_deltas: Whole vectors not relaxed", full.entries == full.messages * full.num_nodes);
+    config.full_vectors = false;
+    stress_report_t delta;
+    run_stress_config(path, &config, &delta);
+    mu_assert("test_stress_deltas: No deltas sent", delta.delta_messages > 0 && delta.delta_messages < delta.messages);
+    mu_assert("test_stress_deltas: Deltas did not save work", delta.entries < delta.messages * delta.num_nodes);
+    unlink(path);
+    return NULL;
+}
+
+char* test_partition() {
+    print_test_details(__func__, "Testing that partitioned routers cut fewer links than round robin, evenly");
+
+    char path[64];
+    topogen_config_t topogen = {TOPOGEN_GRID, 144, 0, 20, 5};
+    mu_assert("test_partition: Writing topology failed", write_generated_topology(path, sizeof(path), &topogen, NULL) == 0);
+    topology_t* topology = topology_load(path, 1);
+    mu_assert("test_partition: Load failed", topology != NULL);
+
+    uint32_t part[144];
+    size_t parts[] = {1, 2, 4, 7};
+    for (size_t p = 0; p < sizeof(parts) / sizeof(parts[0]); p++) {
+        size_t cut = partition_topology(topology, parts[p], part);
+        mu_assert("test_partition: Cut miscounted", cut == partition_cut(topology, part));
+        size_t sizes[7] = {0};
+        for (size_t node = 0; node < 144; node++) {
+            mu_assert("test_partition: Node without a part", part[node] < parts[p]);
+            sizes[part[node]]++;
+        }
+        size_t max_size = (144 + parts[p] - 1) / parts[p] + 144 / parts[p] / 16;
+        for (size_t i = 0; i < parts[p]; i++) {
+            mu_assert("test_partition: Unbalanced part", sizes[i] > 0 && sizes[i] <= max_size);
+        }
+        uint32_t round_robin[144];
+        for (size_t node = 0; node < 144; node++) {
+            round_robin[node] = (uint32_t)(node % parts[p]);
+        }
+        if (parts[p] == 1) {
+            mu_assert("test_partition: Single part cuts links", cut == 0);
+        } else {
+            mu_assert("test_partition: No better than round robin", cut * 2 < partition_cut(topology, round_robin));
+        }
+    }
+    topology_free(topology);
+    unlink(path);
+    return NULL;
+}
+
+char* test_stress_workers() {
+    print_test_details(__func__, "Testing that routers sharing worker threads converge to the same distances");
+
+    char path[64];
+    /* small enough that a worker's select stays within the locks ThreadSanitizer can track at once */
+    topogen_config_t topogen = {TOPOGEN_SCALE_FREE, 40, 2, 20, 7};
+    mu_assert("test_stress_workers: Writing topology failed", write_generated_topology(path, sizeof(path), &topogen, NULL) == 0);
+
+    stress_config_t config = {1, 1, false, 1, STRESS_PARTITIONED};
+    stress_report_t report;
+    run_stress_config(path, &config, &report);
+    mu_assert("test_stress_workers: Wrong thread count", report.num_threads == 1 && report.cut_links == 0);
+    mu_assert("test_stress_workers: Channel used by one worker", report.local_messages == report.messages);
+    size_t local_partitioned = 0;
+    enum stress_placement placements[] = {STRESS_PARTITIONED, STRESS_ROUND_ROBIN};
+    for (size_t p = 0; p < 2; p++) {
+        config.num_workers = 3;
+        config.placement = placements[p];
+        run_stress_config(path, &config, &report);
+        mu_assert("test_stress_workers: Wrong thread count", report.num_threads == 3);
+        mu_assert("test_stress_workers: No links cut", report.cut_links > 0 && report.cut_links < report.num_links);
+        mu_assert("test_stress_workers: Nothing local", report.local_messages > 0);
+        mu_assert("test_stress_workers: Nothing remote", report.local_messages < report.messages);
+        if (placements[p] == STRESS_PARTITIONED) {
+            local_partitioned = report.local_messages * 100 / report.messages;
+        } else {
+            mu_assert("test_stress_workers: Partitioning kept fewer messages local",
+                      local_partitioned > report.local_messages * 100 / report.messages);
+        }
+    }
+    /* more workers than routers leaves one router on each */
+    config.num_workers = 1000;
+    run_stress_config(path, &config, &report);
+    mu_assert("test_stress_workers: Workers not capped", report.num_threads == report.num_nodes);
+    mu_assert("test_stress_workers: Local message between threads", report.local_messages == 0);
+    unlink(path);
+    return NULL;
+}
+
+
+char* test_stress_updates() {
+    print_test_details(__func__, "Testing that routers reconverge after link costs change under them");
+
+    char path[64];
+    topogen_config_t topogen = {TOPOGEN_SCALE_FREE, 40, 2, 20, 11};
+    topogen_graph_t graph;
+    mu_assert("test_stress_updates: Writing topology failed", write_generated_topology(path, sizeof(path), &topogen, &graph) == 0);
+    /* a link that is not there yet: node 0's first missing neighbor */
+    uint32_t missing = 1;
+    for (size_t e = 0; e < graph.num_edges && graph.edges[e].src == 0; e++) {
+        if (graph.edges[e].dst == missing) {
+            missing++;
+        }
+    }
+    stress_link_update_t updates[] = {
+        {graph.edges[0].src, graph.edges[0].dst, 1},     /* cheaper */
+        {0, missing, 2},                                 /* comes up */
+        {graph.edges[4].src, graph.edges[4].dst, 500},   /* dearer */
+        {graph.edges[graph.num_edges - 1].src, graph.edges[graph.num_edges - 1].dst, inf_distance}, /* goes down */
+        {0, missing, 3},                                 /* dearer again */
+    };
+    size_t num_updates = sizeof(updates) / sizeof(updates[0]);
+    size_t num_links = graph.num_edges;
+    topogen_free(&graph);
+
+    /* run_stress checks every router against the updated solution after each update */
+    stress_config_t config = {1, 1, false, 0, STRESS_PARTITIONED, updates, num_updates};
+    stress_report_t report;
+    run_stress_config(path, &config, &report);
+    mu_assert("test_stress_updates: Updates not counted", report.updates == num_updates);
+    mu_assert("test_stress_updates: Reconvergence not timed", report.reconverge_seconds > 0);
+    mu_assert("test_stress_updates: Wrong number of restarts", report.resets == 3);
+    mu_assert("test_stress_updates: Link yet to come up counted", report.num_links == num_links);
+    config.num_workers = 3;
+    run_stress_config(path, &config, &report);
+    mu_assert("test_stress_updates: Wrong number of restarts with workers", report.resets == 3);
+    config.full_vectors = true;
+    run_stress_config(path, &config, &report);
+    unlink(path);
+    return NULL;
+}
+
+char* test_stress_buffers() {
+    print_test_details(__func__, "Testing that routers converge over channels buffering several vectors");
+
+    char path[64];
+    topogen_config_t topogen = {TOPOGEN_SCALE_FREE, 40, 2, 20, 13};
+    topogen_graph_t graph;
+    mu_assert("test_stress_buffers: Writing topology failed", write_generated_topology(path, sizeof(path), &topogen, &graph) == 0);
+    stress_link_update_t updates[] = {{graph.edges[0].src, graph.edges[0].dst, 1},
+                                      {graph.edges[2].src, graph.edges[2].dst, 300}};
+    topogen_free(&graph);
+
+    /* a vector recycled while still buffered would give wrong distances, or a race under ThreadSanitizer */
+    size_t buffer_sizes[] = {2, 5, 32};
+    for (size_t b = 0; b < sizeof(buffer_sizes) / sizeof(buffer_sizes[0]); b++) {
+        stress_config_t config = {buffer_sizes[b], buffer_sizes[b], false, 0, STRESS_PARTITIONED, updates, 2};
+        stress_report_t report;
+        run_stress_config(path, &config, &report);
+        mu_assert("test_stress_buffers: No vectors sent", report.messages > 0 && report.resets == 1);
+        config.num_workers = 3;
+        run_stress_config(path, &config, &report);
+        config.full_vectors = true;
+        run_stress_config(path, &config, &report);
+        mu_assert("test_stress_buffers: Delta sent in full mode", report.delta_messages == 0);
+    }
+    unlink(path);
+    return NULL;
+}
 
 typedef char* (*test_fn_t)();
 typedef struct {
@@ -1656,11 +3195,35 @@ test_t tests[] = {{"test_initialization", test_initialization},
                   {"test_select_with_same_channel_size1", test_select_with_same_channel_size1},
                   {"test_select_with_send_receive_on_same_channel_size1", test_select_with_send_receive_on_same_channel_size1},
                   {"test_select_with_duplicate_channel_size1", test_select_with_duplicate_channel_size1},
+                  {"test_select_many_channels", test_select_many_channels},
                   {"test_stress", test_stress},
                   {"test_select_response_time", test_select_response_time},
                   {"test_cpu_utilization_select", test_cpu_utilization_select},
                   {"test_cpu_utilization_overall", test_cpu_utilization_overall},
                   {"test_for_too_many_wakeups", test_for_too_many_wakeups},
+                  {"test_send_receive_batch", test_send_receive_batch},
+                  {"test_pipeline", test_pipeline},
+                  {"test_pipeline_drain", test_pipeline_drain},
+                  {"test_timer_channels", test_timer_channels},
+                  {"test_channel_stats", test_channel_stats},
+                  {"test_latency_histogram", test_latency_histogram},
+                  {"test_lock_profile", test_lock_profile},
+                  {"test_trace", test_trace},
+                  {"test_channel_registry", test_channel_registry},
+                  {"test_watchdog", test_watchdog},
+                  {"test_stress_send_recv_report", test_stress_send_recv_report},
+                  {"test_loadgen", test_loadgen},
+                  {"test_topogen", test_topogen},
+                  {"test_stress_report", test_stress_report},
+                  {"test_floyd_warshall", test_floyd_warshall},
+                  {"test_apsp_update", test_apsp_update},
+                  {"test_minplus", test_minplus},
+                  {"test_topology", test_topology},
+                  {"test_stress_deltas", test_stress_deltas},
+                  {"test_partition", test_partition},
+                  {"test_stress_workers", test_stress_workers},
+                  {"test_stress_updates", test_stress_updates},
+                  {"test_stress_buffers", test_stress_buffers},
 };
 
 size_t num_tests = sizeof(tests)/sizeof(tests[0]);
@@ -1682,9 +3245,27 @@ char* all_tests(size_t iters) {
     return NULL;
 }
 
+// Traces the whole run when CHANNEL_TRACE_FILE is set, sampling one in CHANNEL_TRACE_SAMPLE operations
+static void trace_run_start(void) {
+    if (getenv("CHANNEL_TRACE_FILE") != NULL) {
+        const char* sample = getenv("CHANNEL_TRACE_SAMPLE");
+        trace_start(sample != NULL ? (uint32_t)atoi(sample) : 1);
+    }
+}
+
+static void trace_run_finish(void) {
+    const char* path = getenv("CHANNEL_TRACE_FILE");
+    if (path != NULL) {
+        trace_stop();
+        long written = trace_write_chrome_json_path(path);
+        printf("Wrote %ld trace events to %s\n", written, path);
+    }
+}
+
 int main(int argc, char** argv) {
     char* result = NULL;
     size_t iters = 1;
+    trace_run_start();
     if (argc == 1) {
         result = all_tests(iters);
         if (result != NULL) {
@@ -1694,6 +3275,7 @@ int main(int argc, char** argv) {
         }
 
         printf("Tests run: %d\n", tests_run);
+        trace_run_finish();
  
         return result != NULL;
     } else if (argc == 3) {
@@ -1718,6 +3300,7 @@ int main(int argc, char** argv) {
     }
 
     printf("Tests run: %d\n", tests_run);
+    trace_run_finish();
 
     return result != NULL;
 }
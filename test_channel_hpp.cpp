@@ -0,0 +1,170 @@
+// Tests for the C++20 wrapper in channel.hpp: make test_hpp
+
+#include "channel.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <exception>
+
+static int failures = 0;
+
+#define CHECK(message, test)                                                 \
+    do {                                                                     \
+        if (!(test)) {                                                       \
+            std::printf("FAILED %s:%d: %s\n", __func__, __LINE__, message); \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+// Fire-and-forget coroutine: starts running immediately and frees itself when it returns
+struct task {
+    struct promise_type {
+        task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Does not fit in a pointer, so it takes the boxed payload path
+struct big {
+    long values[4];
+};
+
+static_assert(chan::payload<int>::is_inline);
+static_assert(!chan::payload<big>::is_inline);
+
+static void test_inline_payload()
+{
+    chan::Channel<int, 2> ch;
+    CHECK("try_send failed", ch.try_send(-7) == SUCCESS);
+    CHECK("blocking_send failed", ch.blocking_send(42) == SUCCESS);
+    CHECK("try_send on full channel succeeded", ch.try_send(1) == CHANNEL_FULL);
+    auto first = ch.blocking_recv();
+    CHECK("wrong first value", first && *first.value == -7);
+    auto second = ch.try_recv();
+    CHECK("wrong second value", second && *second.value == 42);
+    CHECK("try_recv on empty channel succeeded", ch.try_recv().status == CHANNEL_EMPTY);
+    CHECK("close failed", ch.close() == SUCCESS);
+    CHECK("send on closed channel succeeded", ch.try_send(1) == CLOSED_ERROR);
+    CHECK("receive on closed channel succeeded", ch.blocking_recv().status == CLOSED_ERROR);
+}
+
+static void test_boxed_payload()
+{
+    chan::Channel<big, 2> ch;
+    CHECK("send failed", ch.blocking_send(big{{1, 2, 3, 4}}) == SUCCESS);
+    CHECK("send failed", ch.try_send(big{{5, 6, 7, 8}}) == SUCCESS);
+    auto first = ch.try_recv();
+    CHECK("wrong boxed value", first && first.value->values[0] == 1 && first.value->values[3] == 4);
+    // the second value is still buffered when ch goes out of scope and has to be released by the destructor
+    // an awaiter that is never awaited has not encoded its value yet, so dropping it releases nothing
+    auto unused = ch.send(big{{9, 9, 9, 9}});
+    (void)unused;
+}
+
+static task send_task(chan::Channel<big, 1>& ch, big value, std::atomic<int>& resumed, channel_status& status)
+{
+    status = co_await ch.send(value);
+    resumed++;
+}
+
+static task recv_task(chan::Channel<big, 1>& ch, std::atomic<int>& resumed, chan::received<big>& result)
+{
+    result = co_await ch.recv();
+    resumed++;
+}
+
+static void test_suspension()
+{
+    chan::Channel<big, 1> ch;
+    std::atomic<int> resumed{0};
+
+    // a send on a full channel suspends until a receive makes room
+    channel_status send_status = GENERIC_ERROR;
+    CHECK("send failed", ch.blocking_send(big{{1}}) == SUCCESS);
+    send_task(ch, big{{2}}, resumed, send_status);
+    CHECK("send on full channel did not suspend", resumed == 0);
+    CHECK("wrong value", ch.blocking_recv().value->values[0] == 1);
+    CHECK("wrong value", ch.blocking_recv().value->values[0] == 2);
+    while (resumed < 1) {
+        std::this_thread::yield();
+    }
+    CHECK("suspended send failed", send_status == SUCCESS);
+
+    // a receive on an empty channel suspends until a send arrives
+    chan::received<big> result{GENERIC_ERROR, std::nullopt};
+    recv_task(ch, resumed, result);
+    CHECK("receive on empty channel did not suspend", resumed == 1);
+    CHECK("send failed", ch.blocking_send(big{{3}}) == SUCCESS);
+    while (resumed < 2) {
+        std::this_thread::yield();
+    }
+    CHECK("suspended receive got the wrong value", result && result.value->values[0] == 3);
+
+    // many suspended operations share the one waiter thread
+    for (int i = 0; i < 16; i++) {
+        recv_task(ch, resumed, result);
+    }
+    for (long i = 0; i < 16; i++) {
+        CHECK("send failed", ch.blocking_send(big{{i}}) == SUCCESS);
+    }
+    while (resumed < 18) {
+        std::this_thread::yield();
+    }
+
+    // operations still suspended when the channel is destroyed fail instead of hanging
+    std::atomic<int> closed{0};
+    chan::received<big> closed_result{GENERIC_ERROR, std::nullopt};
+    {
+        chan::Channel<big, 1> scoped;
+        recv_task(scoped, closed, closed_result);
+        CHECK("receive on empty channel did not suspend", closed == 0);
+    }
+    CHECK("suspended receive was not failed by the destructor", closed == 1 && closed_result.status == CLOSED_ERROR);
+}
+
+static void test_select()
+{
+    chan::Channel<int, 1> numbers;
+    chan::Channel<big, 1> bigs;
+    CHECK("send failed", bigs.blocking_send(big{{5, 6, 7, 8}}) == SUCCESS);
+
+    // only the ready receive completes
+    auto recv_number = numbers.recv_op();
+    auto recv_big = bigs.recv_op();
+    chan::selected first = chan::select(recv_number, recv_big);
+    CHECK("wrong case selected", first.status == SUCCESS && first.index == 1);
+    CHECK("wrong value", recv_big.value && recv_big.value->values[2] == 7);
+    CHECK("unselected case completed", !recv_number.value);
+
+    // a send case on a full channel is skipped, and an unselected boxed message is released with its case
+    CHECK("send failed", bigs.blocking_send(big{{9}}) == SUCCESS);
+    {
+        auto send_number = numbers.send_op(2);
+        auto send_big = bigs.send_op(big{{10}});
+        chan::selected second = chan::select(send_number, send_big);
+        CHECK("wrong case selected", second.status == SUCCESS && second.index == 0);
+    }
+    CHECK("wrong value", numbers.blocking_recv().value == 2);
+    CHECK("wrong value", bigs.blocking_recv().value->values[0] == 9);
+
+    numbers.close();
+    auto closed = numbers.recv_op();
+    CHECK("select on closed channel succeeded", chan::select(closed).status == CLOSED_ERROR);
+}
+
+int main()
+{
+    test_inline_payload();
+    test_boxed_payload();
+    test_suspension();
+    test_select();
+    if (failures != 0) {
+        std::printf("%d CHECKS FAILED\n", failures);
+        return 1;
+    }
+    std::printf("ALL TESTS PASSED\n");
+    return 0;
+}
@@ -0,0 +1,280 @@
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include "timer.h"
+
+// Hierarchical timing wheel: WHEEL_LEVELS levels of WHEEL_SIZE slots each
+// Level k slot s holds the timers whose expiry tick has bit group k equal to s and that are less than
+// WHEEL_SIZE^(k + 1) ticks away; whenever the level k - 1 wheel wraps around, one slot of level k is
+// cascaded down, so every timer is touched O(WHEEL_LEVELS) times no matter how far away it is
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1u << WHEEL_BITS)
+#define WHEEL_MASK ((uint64_t)WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+// Timers further away than this are parked in the top level and cascaded again until they are in range
+#define WHEEL_RANGE (1ull << (WHEEL_BITS * WHEEL_LEVELS))
+
+typedef struct timer_entry {
+    struct timer_entry* next;
+    struct timer_entry* prev;
+    struct timer_entry** slot; // head of the wheel slot the entry is linked into
+    list_node_t* node;         // node in the list of all pending timers
+    uint64_t expires;          // tick at which the timer fires
+    uint64_t period;           // ticks between fires, 0 for a one-shot timer
+    channel_t* channel;
+} timer_entry_t;
+
+static pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timer_cond;
+static pthread_t timer_thread;
+static bool timer_running = false;
+static bool timer_stopping = false;
+// next tick the wheel has to process
+static uint64_t wheel_tick;
+// tick the timer thread sleeps until, UINT64_MAX when it waits for new timers
+static uint64_t planned_tick;
+static timer_entry_t* wheel[WHEEL_LEVELS][WHEEL_SIZE];
+// all pending timers, so that channel_timer_release can find a timer by its channel
+static list_t* timers;
+
+uint64_t timer_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static void wheel_link(timer_entry_t* entry)
+{
+    uint64_t expires = entry->expires < wheel_tick ? wheel_tick : entry->expires;
+    uint64_t delta = expires - wheel_tick;
+    if (delta >= WHEEL_RANGE) {
+        expires = wheel_tick + WHEEL_RANGE - 1;
+        delta = WHEEL_RANGE - 1;
+    }
+    size_t level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1ull << (WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    timer_entry_t** slot = &wheel[level][(expires >> (WHEEL_BITS * level)) & WHEEL_MASK];
+    entry->slot = slot;
+    entry->prev = NULL;
+    entry->next = *slot;
+    if (*slot != NULL) {
+        (*slot)->prev = entry;
+    }
+    *slot = entry;
+}
+
+static void wheel_unlink(timer_entry_t* entry)
+{
+    if (entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        *entry->slot = entry->next;
+    }
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    }
+    entry->slot = NULL;
+}
+
+// Detaches a whole slot so that its entries can be re-linked (possibly into the same slot)
+static timer_entry_t* wheel_take_slot(size_t level, size_t index)
+{
+    timer_entry_t* head = wheel[level][index];
+    wheel[level][index] = NULL;
+    return head;
+}
+
+static void timer_free(timer_entry_t* entry)
+{
+    list_remove(timers, entry->node);
+    free(entry);
+}
+
+static void wheel_process_tick(void)
+{
+    uint64_t tick = wheel_tick;
+    size_t index = (size_t)(tick & WHEEL_MASK);
+    if (index == 0) {
+        // level 0 wrapped around, pull the next slot of each higher level down while they wrap too
+        for (size_t level = 1; level < WHEEL_LEVELS; level++) {
+            size_t cascade = (size_t)((tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+            timer_entry_t* entry = wheel_take_slot(level, cascade);
+            while (entry != NULL) {
+                timer_entry_t* next = entry->next;
+                wheel_link(entry);
+                entry = next;
+            }
+            if (cascade != 0) {
+                break;
+            }
+        }
+    }
+    timer_entry_t* entry = wheel_take_slot(0, index);
+    if (entry != NULL) {
+        uint64_t now = timer_now_ns();
+        while (entry != NULL) {
+            timer_entry_t* next = entry->next;
+            // a full channel means the previous tick is still pending; drop this one
+            channel_non_blocking_send(entry->channel, (void*)(uintptr_t)now);
+            if (entry->period != 0) {
+                while (entry->expires <= tick) {
+                    entry->expires += entry->period;
+                }
+                wheel_link(entry);
+            } else {
+                timer_free(entry);
+            }
+            entry = next;
+        }
+    }
+    wheel_tick++;
+}
+
+// Returns the next tick at which the wheel has work to do: a non-empty level 0 slot or the next cascade
+static uint64_t wheel_next_tick(void)
+{
+    uint64_t boundary = (wheel_tick | WHEEL_MASK) + 1;
+    for (uint64_t tick = wheel_tick; tick < boundary; tick++) {
+        if (wheel[0][tick & WHEEL_MASK] != NULL) {
+            return tick;
+        }
+    }
+    return boundary;
+}
+
+static void* timer_thread_main(void* arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&timer_lock);
+    while (!timer_stopping) {
+        uint64_t now_tick = timer_now_ns() / TIMER_TICK_NS;
+        while (wheel_tick <= now_tick) {
+            wheel_process_tick();
+        }
+        if (list_count(timers) == 0) {
+            planned_tick = UINT64_MAX;
+            pthread_cond_wait(&timer_cond, &timer_lock);
+        } else {
+            planned_tick = wheel_next_tick();
+            uint64_t wake_ns = planned_tick * TIMER_TICK_NS;
+            struct timespec wake;
+            wake.tv_sec = (time_t)(wake_ns / 1000000000ull);
+            wake.tv_nsec = (long)(wake_ns % 1000000000ull);
+            pthread_cond_timedwait(&timer_cond, &timer_lock, &wake);
+        }
+    }
+    pthread_mutex_unlock(&timer_lock);
+    return NULL;
+}
+
+// Starts the timer thread if needed, assumes timer_lock is held
+static void timer_ensure_running(void)
+{
+    if (timer_running) {
+        return;
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&timer_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    timers = list_create();
+    wheel_tick = timer_now_ns() / TIMER_TICK_NS;
+    planned_tick = UINT64_MAX;
+    timer_stopping = false;
+    int pthread_status = pthread_create(&timer_thread, NULL, timer_thread_main, NULL);
+    assert(pthread_status == 0);
+    (void)pthread_status;
+    timer_running = true;
+}
+
+static channel_t* timer_add(uint64_t deadline_ns, uint64_t period_ns)
+{
+    channel_t* channel = channel_create(1);
+    timer_entry_t* entry = malloc(sizeof(timer_entry_t));
+    assert(entry != NULL);
+    entry->channel = channel;
+    // round up so a timer never fires before its deadline
+    entry->expires = (deadline_ns + TIMER_TICK_NS - 1) / TIMER_TICK_NS;
+    entry->period = period_ns == 0 ? 0 : (period_ns + TIMER_TICK_NS - 1) / TIMER_TICK_NS;
+
+    pthread_mutex_lock(&timer_lock);
+    timer_ensure_running();
+    if (list_count(timers) == 0) {
+        // the wheel is empty and the thread may have been idle for a long time, skip the ticks it missed
+        wheel_tick = timer_now_ns() / TIMER_TICK_NS;
+    }
+    entry->node = list_insert(timers, entry);
+    wheel_link(entry);
+    if (entry->expires < planned_tick) {
+        // the timer thread would oversleep this timer, let it recompute its wake up time
+        pthread_cond_signal(&timer_cond);
+    }
+    pthread_mutex_unlock(&timer_lock);
+    return channel;
+}
+
+channel_t* channel_after(uint64_t ns)
+{
+    return timer_add(timer_now_ns() + ns, 0);
+}
+
+channel_t* channel_deadline(uint64_t deadline_ns)
+{
+    return timer_add(deadline_ns, 0);
+}
+
+channel_t* channel_ticker(uint64_t period_ns)
+{
+    if (period_ns == 0) {
+        return NULL;
+    }
+    return timer_add(timer_now_ns() + period_ns, period_ns);
+}
+
+void channel_timer_release(channel_t* channel)
+{
+    pthread_mutex_lock(&timer_lock);
+    if (timer_running) {
+        for (list_node_t* node = list_head(timers); node != NULL; node = list_next(node)) {
+            timer_entry_t* entry = list_data(node);
+            if (entry->channel == channel) {
+                wheel_unlink(entry);
+                timer_free(entry);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&timer_lock);
+    // the timer thread only sends while holding timer_lock, so nothing can touch the channel any more
+    channel_close(channel);
+    channel_destroy(channel);
+}
+
+void channel_timer_shutdown(void)
+{
+    pthread_mutex_lock(&timer_lock);
+    if (!timer_running) {
+        pthread_mutex_unlock(&timer_lock);
+        return;
+    }
+    timer_stopping = true;
+    pthread_cond_signal(&timer_cond);
+    pthread_mutex_unlock(&timer_lock);
+    pthread_join(timer_thread, NULL);
+
+    pthread_mutex_lock(&timer_lock);
+    while (list_count(timers) != 0) {
+        timer_entry_t* entry = list_data(list_head(timers));
+        wheel_unlink(entry);
+        timer_free(entry);
+    }
+    list_destroy(timers);
+    timers = NULL;
+    pthread_cond_destroy(&timer_cond);
+    timer_running = false;
+    pthread_mutex_unlock(&timer_lock);
+}
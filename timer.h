@@ -0,0 +1,37 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include "channel.h"
+
+// Resolution of the timer wheel; timers never fire early but may fire up to one tick late
+#define TIMER_TICK_NS 1000000ull
+
+// Timer channels are driven by a single timer-wheel thread, started on first use
+// When a timer fires, the current CLOCK_MONOTONIC time in ns is sent on its channel as (void*)(uintptr_t)
+// Timer channels are ordinary channels, so they can be mixed with data channels in channel_select
+
+// Returns the current CLOCK_MONOTONIC time in ns, the time base used by all timers
+uint64_t timer_now_ns(void);
+
+// Returns a channel of capacity 1 that receives one message ns nanoseconds from now
+channel_t* channel_after(uint64_t ns);
+
+// Returns a channel of capacity 1 that receives one message once timer_now_ns() reaches deadline_ns
+// A deadline in the past fires on the next tick
+channel_t* channel_deadline(uint64_t deadline_ns);
+
+// Returns a channel of capacity 1 that receives a message every period_ns nanoseconds
+// Ticks are dropped while the previous tick has not been received yet, so a slow receiver never falls behind
+channel_t* channel_ticker(uint64_t period_ns);
+
+// Stops the timer feeding the channel (if it has not fired yet), then closes and destroys the channel
+// The caller must make sure no other thread still uses the channel, as with channel_destroy
+void channel_timer_release(channel_t* channel);
+
+// Stops the timer thread and drops every pending timer
+// Channels of dropped timers stay valid and must still be released by their owners
+// Creating a new timer afterwards starts the thread again
+void channel_timer_shutdown(void);
+
+#endif // TIMER_H
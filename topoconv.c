@@ -0,0 +1,69 @@
+// Converts a text topology for run_stress into the binary format of topology.h
+// Usage: ./topoconv INPUT OUTPUT [--solve] [--threads N]
+// INPUT is a matrix or edge list as written by topogen; --solve also stores the shortest distances so that
+// stress runs on OUTPUT skip Floyd-Warshall, computed with N threads (one per online CPU by default)
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "apsp.h"
+#include "topology.h"
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s INPUT OUTPUT [--solve] [--threads N]\n", program);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    bool solve = false;
+    size_t num_threads = 0;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--solve") == 0) {
+            solve = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = strtoull(argv[++i], NULL, 10);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    topology_t* topology = topology_load(argv[1], num_threads);
+    if (topology == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    distance_t* solution = NULL;
+    if (solve) {
+        size_t n = topology->num_nodes;
+        solution = malloc(sizeof(distance_t) * n * n);
+        if (solution == NULL) {
+            fprintf(stderr, "Not enough memory for a %zu x %zu solution\n", n, n);
+            topology_free(topology);
+            return 1;
+        }
+        topology_to_matrix(topology, solution);
+        apsp_floyd_warshall(solution, n, num_threads);
+    }
+    FILE* file = fopen(argv[2], "wb");
+    if (file == NULL) {
+        perror(argv[2]);
+        free(solution);
+        topology_free(topology);
+        return 1;
+    }
+    int status = topology_write_binary(file, topology, solution);
+    if (fclose(file) != 0) {
+        status = -1;
+    }
+    fprintf(stderr, "%s: %zu nodes, %zu directed links%s\n", argv[2], topology->num_nodes, topology->num_links,
+            solve ? ", with solution" : "");
+    free(solution);
+    topology_free(topology);
+    return status == 0 ? 0 : 1;
+}
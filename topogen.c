@@ -0,0 +1,236 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "topogen.h"
+
+static const char* kind_names[] = {"ring", "grid", "geometric", "scale-free", "complete"};
+
+// Undirected links collected while generating, with a < b
+typedef struct {
+    topogen_edge_t* links;
+    size_t count;
+    size_t capacity;
+} link_list_t;
+
+// xorshift64*, reproducible from the seed
+static uint64_t next_random(uint64_t* state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+// Returns a uniform double in [0, 1)
+static double next_uniform(uint64_t* state)
+{
+    return (double)(next_random(state) >> 11) / 9007199254740992.0;
+}
+
+static void add_link(link_list_t* list, size_t a, size_t b, unsigned cost)
+{
+    if (a == b) {
+        return;
+    }
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+        list->links = realloc(list->links, sizeof(topogen_edge_t) * list->capacity);
+        assert(list->links != NULL);
+    }
+    topogen_edge_t* link = &list->links[list->count++];
+    link->src = (uint32_t)(a < b ? a : b);
+    link->dst = (uint32_t)(a < b ? b : a);
+    link->cost = cost;
+}
+
+static unsigned random_cost(const topogen_config_t* config, uint64_t* state)
+{
+    return 1 + (unsigned)(next_random(state) % config->max_cost);
+}
+
+static int compare_edges(const void* a, const void* b)
+{
+    const topogen_edge_t* left = a;
+    const topogen_edge_t* right = b;
+    if (left->src != right->src) {
+        return left->src < right->src ? -1 : 1;
+    }
+    if (left->dst != right->dst) {
+        return left->dst < right->dst ? -1 : 1;
+    }
+    return 0;
+}
+
+static void generate_geometric(const topogen_config_t* config, link_list_t* list, uint64_t* state)
+{
+    size_t n = config->num_nodes;
+    double* x = malloc(sizeof(double) * n);
+    double* y = malloc(sizeof(double) * n);
+    assert(x != NULL && y != NULL);
+    for (size_t i = 0; i < n; i++) {
+        x[i] = next_uniform(state);
+        y[i] = next_uniform(state);
+    }
+    // a disc of this radius covers degree / n of the unit square, so it holds about degree other points
+    double radius = sqrt((double)config->degree / (M_PI * (double)n));
+    for (size_t a = 0; a < n; a++) {
+        for (size_t b = a + 1; b < n; b++) {
+            double length = hypot(x[a] - x[b], y[a] - y[b]);
+            if (length < radius) {
+                add_link(list, a, b, 1 + (unsigned)(length / radius * (double)(config->max_cost - 1)));
+            }
+        }
+    }
+    free(x);
+    free(y);
+}
+
+static void generate_scale_free(const topogen_config_t* config, link_list_t* list, uint64_t* state)
+{
+    size_t n = config->num_nodes;
+    size_t m = config->degree;
+    // both endpoints of every link so far, so a uniform pick from it is proportional to degree
+    size_t* endpoints = malloc(sizeof(size_t) * 2 * m * n);
+    size_t* chosen = malloc(sizeof(size_t) * m);
+    assert(endpoints != NULL && chosen != NULL);
+    size_t num_endpoints = 0;
+    size_t seed_nodes = m + 1 < n ? m + 1 : n;
+    for (size_t a = 0; a < seed_nodes; a++) {
+        for (size_t b = a + 1; b < seed_nodes; b++) {
+            add_link(list, a, b, random_cost(config, state));
+            endpoints[num_endpoints++] = a;
+            endpoints[num_endpoints++] = b;
+        }
+    }
+    for (size_t node = seed_nodes; node < n; node++) {
+        size_t num_chosen = 0;
+        while (num_chosen < m) {
+            size_t target = endpoints[next_random(state) % num_endpoints];
+            bool duplicate = false;
+            for (size_t i = 0; i < num_chosen; i++) {
+                duplicate = duplicate || chosen[i] == target;
+            }
+            if (!duplicate) {
+                chosen[num_chosen++] = target;
+            }
+        }
+        for (size_t i = 0; i < m; i++) {
+            add_link(list, node, chosen[i], random_cost(config, state));
+            endpoints[num_endpoints++] = node;
+            endpoints[num_endpoints++] = chosen[i];
+        }
+    }
+    free(chosen);
+    free(endpoints);
+}
+
+const char* topogen_kind_name(enum topogen_kind kind)
+{
+    return kind < TOPOGEN_KIND_COUNT ? kind_names[kind] : "unknown";
+}
+
+enum topogen_kind topogen_kind_from_name(const char* name)
+{
+    for (size_t kind = 0; kind < TOPOGEN_KIND_COUNT; kind++) {
+        if (strcmp(kind_names[kind], name) == 0) {
+            return (enum topogen_kind)kind;
+        }
+    }
+    return TOPOGEN_KIND_COUNT;
+}
+
+int topogen_generate(const topogen_config_t* config, topogen_graph_t* graph)
+{
+    size_t n = config->num_nodes;
+    if (n == 0 || n > UINT32_MAX || config->max_cost == 0 || config->kind >= TOPOGEN_KIND_COUNT ||
+        ((config->kind == TOPOGEN_GEOMETRIC || config->kind == TOPOGEN_SCALE_FREE) && config->degree == 0)) {
+        return -1;
+    }
+    uint64_t state = config->seed != 0 ? config->seed : 0x9e3779b97f4a7c15ull;
+    link_list_t list = {NULL, 0, 0};
+    switch (config->kind) {
+    case TOPOGEN_RING:
+        for (size_t i = 0; i + 1 < n; i++) {
+            add_link(&list, i, i + 1, random_cost(config, &state));
+        }
+        if (n > 2) {
+            add_link(&list, n - 1, 0, random_cost(config, &state));
+        }
+        break;
+    case TOPOGEN_GRID: {
+        size_t columns = (size_t)ceil(sqrt((double)n));
+        for (size_t i = 0; i < n; i++) {
+            if (i % columns + 1 < columns && i + 1 < n) {
+                add_link(&list, i, i + 1, random_cost(config, &state));
+            }
+            if (i + columns < n) {
+                add_link(&list, i, i + columns, random_cost(config, &state));
+            }
+        }
+        break;
+    }
+    case TOPOGEN_GEOMETRIC:
+        generate_geometric(config, &list, &state);
+        break;
+    case TOPOGEN_SCALE_FREE:
+        generate_scale_free(config, &list, &state);
+        break;
+    default:
+        for (size_t a = 0; a < n; a++) {
+            for (size_t b = a + 1; b < n; b++) {
+                add_link(&list, a, b, random_cost(config, &state));
+            }
+        }
+        break;
+    }
+
+    // every generator above adds each link once, so each becomes exactly two directed edges
+    graph->num_nodes = n;
+    graph->num_edges = list.count * 2;
+    graph->edges = malloc(sizeof(topogen_edge_t) * (graph->num_edges > 0 ? graph->num_edges : 1));
+    assert(graph->edges != NULL);
+    for (size_t i = 0; i < list.count; i++) {
+        graph->edges[2 * i] = list.links[i];
+        graph->edges[2 * i + 1] = (topogen_edge_t){list.links[i].dst, list.links[i].src, list.links[i].cost};
+    }
+    qsort(graph->edges, graph->num_edges, sizeof(topogen_edge_t), compare_edges);
+    free(list.links);
+    return 0;
+}
+
+void topogen_free(topogen_graph_t* graph)
+{
+    free(graph->edges);
+    graph->edges = NULL;
+    graph->num_edges = 0;
+}
+
+int topogen_write_matrix(FILE* file, const topogen_graph_t* graph)
+{
+    fprintf(file, "%zu\n", graph->num_nodes);
+    size_t edge = 0;
+    for (size_t src = 0; src < graph->num_nodes; src++) {
+        for (size_t dst = 0; dst < graph->num_nodes; dst++) {
+            long cost = -1;
+            if (src == dst) {
+                cost = 0;
+            } else if (edge < graph->num_edges && graph->edges[edge].src == src && graph->edges[edge].dst == dst) {
+                cost = graph->edges[edge++].cost;
+            }
+            fprintf(file, dst == 0 ? "%ld" : " %ld", cost);
+        }
+        fputc('\n', file);
+    }
+    return ferror(file) ? -1 : 0;
+}
+
+int topogen_write_edges(FILE* file, const topogen_graph_t* graph)
+{
+    fprintf(file, "edges %zu %zu\n", graph->num_nodes, graph->num_edges);
+    for (size_t i = 0; i < graph->num_edges; i++) {
+        fprintf(file, "%u %u %u\n", graph->edges[i].src, graph->edges[i].dst, graph->edges[i].cost);
+    }
+    return ferror(file) ? -1 : 0;
+}
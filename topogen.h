@@ -0,0 +1,59 @@
+#ifndef TOPOGEN_H
+#define TOPOGEN_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Synthetic topologies for the router stress test (stress.c), in either file format run_stress reads:
+// - the dense matrix: the node count, then num_nodes rows of num_nodes link costs, -1 for no link
+// - the sparse edge list: "edges <num_nodes> <num_edges>", then one "<src> <dst> <cost>" line per directed
+//   link; missing links have no cost and every node is at distance 0 from itself
+// All generated links are symmetric, with costs between 1 and max_cost
+
+enum topogen_kind {
+    TOPOGEN_RING,       // node i linked to i - 1 and i + 1
+    TOPOGEN_GRID,       // nodes on a near-square grid, linked to their 4 neighbours
+    TOPOGEN_GEOMETRIC,  // random points in the unit square, linked when close enough for about degree
+                        // neighbours each; costs grow with the length of the link
+    TOPOGEN_SCALE_FREE, // Barabasi-Albert preferential attachment, each new node linking to degree others
+    TOPOGEN_COMPLETE,   // every pair linked
+    TOPOGEN_KIND_COUNT,
+};
+
+typedef struct {
+    enum topogen_kind kind;
+    size_t num_nodes;
+    size_t degree;     // TOPOGEN_GEOMETRIC: mean degree; TOPOGEN_SCALE_FREE: links per new node
+    unsigned max_cost; // at least 1
+    uint64_t seed;     // the same seed gives the same graph
+} topogen_config_t;
+
+typedef struct {
+    uint32_t src;
+    uint32_t dst;
+    unsigned cost;
+} topogen_edge_t;
+
+typedef struct {
+    size_t num_nodes;
+    size_t num_edges;       // directed links, each undirected link counted twice
+    topogen_edge_t* edges;  // sorted by src, then dst
+} topogen_graph_t;
+
+// Returns the name used for kind on the command line, e.g. "scale-free"
+const char* topogen_kind_name(enum topogen_kind kind);
+
+// Returns the kind with the given name, TOPOGEN_KIND_COUNT if there is none
+enum topogen_kind topogen_kind_from_name(const char* name);
+
+// Generates a graph into graph, which must be freed with topogen_free
+// Returns 0, or -1 if the configuration is invalid (no nodes, more than UINT32_MAX nodes, or a zero max_cost)
+int topogen_generate(const topogen_config_t* config, topogen_graph_t* graph);
+
+void topogen_free(topogen_graph_t* graph);
+
+// Write graph in the dense matrix or sparse edge list format; return 0, or -1 on a write error
+int topogen_write_matrix(FILE* file, const topogen_graph_t* graph);
+int topogen_write_edges(FILE* file, const topogen_graph_t* graph);
+
+#endif // TOPOGEN_H
@@ -0,0 +1,67 @@
+// Writes a synthetic topology for run_stress
+// Usage: ./topogen KIND NODES [--degree D] [--max-cost C] [--seed S] [--edges] [-o FILE]
+// KIND is one of ring, grid, geometric, scale-free, complete; the dense matrix format is written unless
+// --edges asks for the sparse edge list, to stdout unless -o names a file
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "topogen.h"
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s KIND NODES [--degree D] [--max-cost C] [--seed S] [--edges] [-o FILE]\n"
+                    "Kinds:", program);
+    for (size_t kind = 0; kind < TOPOGEN_KIND_COUNT; kind++) {
+        fprintf(stderr, " %s", topogen_kind_name((enum topogen_kind)kind));
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    topogen_config_t config = {topogen_kind_from_name(argv[1]), strtoull(argv[2], NULL, 10), 4, 1, 1};
+    bool edges = false;
+    const char* path = NULL;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--degree") == 0 && i + 1 < argc) {
+            config.degree = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--max-cost") == 0 && i + 1 < argc) {
+            config.max_cost = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            config.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--edges") == 0) {
+            edges = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    topogen_graph_t graph;
+    if (topogen_generate(&config, &graph) != 0) {
+        fprintf(stderr, "Invalid topology: %s with %s nodes\n", argv[1], argv[2]);
+        usage(argv[0]);
+        return 1;
+    }
+    FILE* file = path != NULL ? fopen(path, "w") : stdout;
+    if (file == NULL) {
+        perror(path);
+        topogen_free(&graph);
+        return 1;
+    }
+    int status = edges ? topogen_write_edges(file, &graph) : topogen_write_matrix(file, &graph);
+    if (fclose(file) != 0) {
+        status = -1;
+    }
+    fprintf(stderr, "%s: %zu nodes, %zu directed links\n", topogen_kind_name(config.kind), graph.num_nodes,
+            graph.num_edges);
+    topogen_free(&graph);
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,503 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "timer.h"
+#include "topology.h"
+
+// Integers beyond this saturate while parsing; anything that large is no link in either format anyway
+#define TOKEN_MAX ((int64_t)1 << 40)
+
+// One line of an edge list, with its line number so that the last line for a link wins after sorting
+typedef struct {
+    uint32_t src;
+    uint32_t dst;
+    distance_t cost;
+    size_t line;
+} edge_line_t;
+
+// A byte range of the file parsed by one thread; the ranges only split the file between integers
+typedef struct {
+    const char* begin;
+    const char* end;
+    bool links_only;   // keep only values that can be link costs, as the matrix needs, instead of every one
+    bool malformed;
+    size_t num_tokens; // every integer in the range
+    size_t num_kept;
+    size_t capacity;
+    size_t* positions; // token index within the range of each kept value, only when links_only
+    int64_t* values;
+} chunk_t;
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Parses the next integer at or after *cursor, as fscanf("%d") would
+// Returns 1 and advances *cursor past it, 0 at the end of the range, or -1 if something else is there
+static inline int next_token(const char** cursor, const char* end, int64_t* value)
+{
+    const char* p = *cursor;
+    while (p < end && is_space(*p)) {
+        p++;
+    }
+    if (p == end) {
+        *cursor = p;
+        return 0;
+    }
+    bool negative = *p == '-';
+    if (*p == '-' || *p == '+') {
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return -1;
+    }
+    int64_t parsed = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        if (parsed < TOKEN_MAX) {
+            parsed = parsed * 10 + (*p - '0');
+        }
+    }
+    if (p < end && !is_space(*p)) {
+        return -1;
+    }
+    *value = negative ? -parsed : parsed;
+    *cursor = p;
+    return 1;
+}
+
+static void* parse_chunk(void* arg)
+{
+    chunk_t* chunk = arg;
+    const char* cursor = chunk->begin;
+    int64_t value;
+    int found;
+    while ((found = next_token(&cursor, chunk->end, &value)) == 1) {
+        // negative values get converted to inf_distance
+        if (!chunk->links_only || (value >= 0 && value < inf_distance)) {
+            if (chunk->num_kept == chunk->capacity) {
+                chunk->capacity = chunk->capacity > 0 ? chunk->capacity * 2 : 1024;
+                chunk->values = realloc(chunk->values, sizeof(int64_t) * chunk->capacity);
+                assert(chunk->values != NULL);
+                if (chunk->links_only) {
+                    chunk->positions = realloc(chunk->positions, sizeof(size_t) * chunk->capacity);
+                    assert(chunk->positions != NULL);
+                }
+            }
+            if (chunk->links_only) {
+                chunk->positions[chunk->num_kept] = chunk->num_tokens;
+            }
+            chunk->values[chunk->num_kept++] = value;
+        }
+        chunk->num_tokens++;
+    }
+    chunk->malformed = found == -1;
+    return NULL;
+}
+
+// Parses [begin, end) with up to num_threads threads, one range each, the calling thread taking the first
+// Returns the number of ranges used
+static size_t parse_parallel(const char* begin, const char* end, bool links_only, size_t num_threads,
+                             chunk_t** chunks_out)
+{
+    if (num_threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = cpus > 0 ? (size_t)cpus : 1;
+    }
+    // ranges smaller than TOPOLOGY_PARSE_CHUNK are not worth a thread
+    size_t bytes = (size_t)(end - begin);
+    size_t max_chunks = bytes / TOPOLOGY_PARSE_CHUNK > 0 ? bytes / TOPOLOGY_PARSE_CHUNK : 1;
+    size_t num_chunks = num_threads < max_chunks ? num_threads : max_chunks;
+
+    chunk_t* chunks = calloc(num_chunks, sizeof(chunk_t));
+    pthread_t* threads = malloc(sizeof(pthread_t) * num_chunks);
+    assert(chunks != NULL && threads != NULL);
+    const char* split = begin;
+    for (size_t i = 0; i < num_chunks; i++) {
+        chunks[i].begin = split;
+        split = i + 1 == num_chunks ? end : begin + bytes / num_chunks * (i + 1);
+        if (split < chunks[i].begin) {
+            split = chunks[i].begin;
+        }
+        // move the split forward to whitespace so that no integer straddles two ranges
+        while (split < end && !is_space(*split)) {
+            split++;
+        }
+        chunks[i].end = split;
+        chunks[i].links_only = links_only;
+    }
+    for (size_t i = 1; i < num_chunks; i++) {
+        int pthread_status = pthread_create(&threads[i], NULL, parse_chunk, &chunks[i]);
+        assert(pthread_status == 0);
+        (void)pthread_status;
+    }
+    parse_chunk(&chunks[0]);
+    for (size_t i = 1; i < num_chunks; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    for (size_t i = 0; i < num_chunks; i++) {
+        assert(!chunks[i].malformed);
+    }
+    *chunks_out = chunks;
+    return num_chunks;
+}
+
+static void free_chunks(chunk_t* chunks, size_t num_chunks)
+{
+    for (size_t i = 0; i < num_chunks; i++) {
+        free(chunks[i].positions);
+        free(chunks[i].values);
+    }
+    free(chunks);
+}
+
+static topology_t* topology_allocate(size_t num_nodes, size_t capacity)
+{
+    topology_t* topology = calloc(1, sizeof(topology_t));
+    assert(topology != NULL);
+    topology->num_nodes = num_nodes;
+    topology->offsets = calloc(num_nodes + 1, sizeof(size_t));
+    topology->targets = malloc(sizeof(uint32_t) * (capacity > 0 ? capacity : 1));
+    topology->costs = malloc(sizeof(distance_t) * (capacity > 0 ? capacity : 1));
+    assert(topology->offsets != NULL && topology->targets != NULL && topology->costs != NULL);
+    return topology;
+}
+
+// Appends a link from src, which must not come before the last one appended, in CSR order
+static void append_link(topology_t* topology, size_t* row, size_t src, size_t dst, distance_t cost)
+{
+    while (*row < src) {
+        topology->offsets[++*row] = topology->num_links;
+    }
+    topology->targets[topology->num_links] = (uint32_t)dst;
+    topology->costs[topology->num_links] = cost;
+    topology->num_links++;
+}
+
+static void finish_rows(topology_t* topology, size_t row)
+{
+    while (row < topology->num_nodes) {
+        topology->offsets[++row] = topology->num_links;
+    }
+}
+
+static int compare_edge_lines(const void* a, const void* b)
+{
+    const edge_line_t* left = a;
+    const edge_line_t* right = b;
+    if (left->src != right->src) {
+        return left->src < right->src ? -1 : 1;
+    }
+    if (left->dst != right->dst) {
+        return left->dst < right->dst ? -1 : 1;
+    }
+    return left->line < right->line ? -1 : left->line > right->line;
+}
+
+// Parses the dense format after its node count: a row of link costs per node
+// The ranges keep only the entries that are links, in row-major order, so concatenating them is CSR order
+static topology_t* read_matrix(const char* begin, const char* end, size_t num_nodes, size_t num_threads)
+{
+    assert(num_nodes > 0 && num_nodes <= UINT32_MAX);
+    chunk_t* chunks;
+    size_t num_chunks = parse_parallel(begin, end, true, num_threads, &chunks);
+    size_t capacity = 0;
+    for (size_t i = 0; i < num_chunks; i++) {
+        capacity += chunks[i].num_kept;
+    }
+
+    topology_t* topology = topology_allocate(num_nodes, capacity);
+    size_t num_entries = num_nodes * num_nodes;
+    size_t first = 0; // index in the whole matrix of the first entry in the range
+    size_t row = 0;
+    for (size_t i = 0; i < num_chunks; i++) {
+        for (size_t k = 0; k < chunks[i].num_kept && first + chunks[i].positions[k] < num_entries; k++) {
+            size_t entry = first + chunks[i].positions[k];
+            if (entry / num_nodes != entry % num_nodes) {
+                append_link(topology, &row, entry / num_nodes, entry % num_nodes, (distance_t)chunks[i].values[k]);
+            }
+        }
+        first += chunks[i].num_tokens;
+    }
+    assert(first >= num_entries);
+    finish_rows(topology, row);
+    free_chunks(chunks, num_chunks);
+    return topology;
+}
+
+// Parses the sparse format after its header: "<src> <dst> <cost>" lines
+static topology_t* read_edges(const char* begin, const char* end, size_t num_nodes, size_t num_lines,
+                              size_t num_threads)
+{
+    assert(num_nodes > 0 && num_nodes <= UINT32_MAX);
+    chunk_t* chunks;
+    size_t num_chunks = parse_parallel(begin, end, false, num_threads, &chunks);
+    edge_line_t* lines = malloc(sizeof(edge_line_t) * (num_lines > 0 ? num_lines : 1));
+    assert(lines != NULL);
+    int64_t triple[3];
+    size_t token = 0;
+    for (size_t i = 0; i < num_chunks; i++) {
+        for (size_t k = 0; k < chunks[i].num_kept && token < 3 * num_lines; k++, token++) {
+            triple[token % 3] = chunks[i].values[k];
+            if (token % 3 == 2) {
+                assert(triple[0] >= 0 && (size_t)triple[0] < num_nodes);
+                assert(triple[1] >= 0 && (size_t)triple[1] < num_nodes);
+                // negative values get converted to inf_distance
+                distance_t cost = triple[2] >= 0 && triple[2] < inf_distance ? (distance_t)triple[2] : inf_distance;
+                lines[token / 3] = (edge_line_t){(uint32_t)triple[0], (uint32_t)triple[1], cost, token / 3};
+            }
+        }
+    }
+    assert(token == 3 * num_lines);
+    free_chunks(chunks, num_chunks);
+    qsort(lines, num_lines, sizeof(edge_line_t), compare_edge_lines);
+
+    topology_t* topology = topology_allocate(num_nodes, num_lines);
+    size_t row = 0;
+    for (size_t i = 0; i < num_lines; i++) {
+        // the last line for a link is the one that counts, and it may say there is no link after all
+        bool last = i + 1 == num_lines || lines[i + 1].src != lines[i].src || lines[i + 1].dst != lines[i].dst;
+        if (last && lines[i].src != lines[i].dst && lines[i].cost != inf_distance) {
+            append_link(topology, &row, lines[i].src, lines[i].dst, lines[i].cost);
+        }
+    }
+    finish_rows(topology, row);
+    free(lines);
+    return topology;
+}
+
+_Static_assert(sizeof(size_t) == sizeof(uint64_t), "binary topologies store offsets as 64-bit size_t");
+_Static_assert(sizeof(topology_header_t) % sizeof(size_t) == 0, "offsets must stay aligned after the header");
+
+// Adds a * b to *total, returning false if any step overflows size_t
+static bool add_product(size_t* total, size_t a, size_t b)
+{
+    size_t product;
+    return !__builtin_mul_overflow(a, b, &product) && !__builtin_add_overflow(*total, product, total);
+}
+
+// Points topology into a mapped binary file
+// The file may come from anywhere, so its sizes are checked without overflowing, every offset and target is
+// checked before anything indexes with them, and links must join distinct nodes with every cost and solution
+// entry at most inf_distance, as apsp.h needs so that sums cannot wrap
+// Returns NULL if the file is malformed
+static topology_t* map_binary(void* data, size_t size)
+{
+    const topology_header_t* header = data;
+    if (size < sizeof(topology_header_t) || header->version != TOPOLOGY_VERSION ||
+        header->num_nodes == 0 || header->num_nodes > UINT32_MAX) {
+        return NULL;
+    }
+    size_t num_nodes = (size_t)header->num_nodes;
+    size_t num_links = (size_t)header->num_links;
+    bool has_solution = header->flags & TOPOLOGY_HAS_SOLUTION;
+    size_t expected = sizeof(topology_header_t);
+    size_t num_cells;
+    if (!add_product(&expected, sizeof(size_t), num_nodes + 1) ||
+        !add_product(&expected, sizeof(uint32_t) + sizeof(distance_t), num_links) ||
+        __builtin_mul_overflow(num_nodes, num_nodes, &num_cells) ||
+        !add_product(&expected, has_solution ? sizeof(distance_t) : 0, num_cells) || size != expected) {
+        return NULL;
+    }
+
+    const size_t* offsets = (const size_t*)((char*)data + sizeof(topology_header_t));
+    const uint32_t* targets = (const uint32_t*)(offsets + num_nodes + 1);
+    const distance_t* costs = (const distance_t*)(targets + num_links);
+    if (offsets[0] != 0 || offsets[num_nodes] != num_links) {
+        return NULL;
+    }
+    for (size_t node = 0; node < num_nodes; node++) {
+        if (offsets[node + 1] < offsets[node] || offsets[node + 1] > num_links) {
+            return NULL;
+        }
+        for (size_t k = offsets[node]; k < offsets[node + 1]; k++) {
+            if (targets[k] >= num_nodes || targets[k] == node || (k > offsets[node] && targets[k] <= targets[k - 1]) ||
+                costs[k] > inf_distance) {
+                return NULL;
+            }
+        }
+    }
+    const distance_t* solution = has_solution ? costs + num_links : NULL;
+    for (size_t cell = 0; solution != NULL && cell < num_cells; cell++) {
+        if (solution[cell] > inf_distance) {
+            return NULL;
+        }
+    }
+
+    topology_t* topology = calloc(1, sizeof(topology_t));
+    assert(topology != NULL);
+    topology->num_nodes = num_nodes;
+    topology->num_links = num_links;
+    topology->offsets = (size_t*)offsets;
+    topology->targets = (uint32_t*)targets;
+    topology->costs = (distance_t*)costs;
+    topology->solution = solution;
+    topology->mapping = data;
+    return topology;
+}
+
+topology_t* topology_load(const char* filename, size_t num_threads)
+{
+    uint64_t start_ns = timer_now_ns();
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat info;
+    int status = fstat(fd, &info);
+    assert(status == 0 && info.st_size > 0);
+    (void)status;
+    size_t size = (size_t)info.st_size;
+    const char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    assert(data != MAP_FAILED);
+    close(fd);
+    if (size >= sizeof(TOPOLOGY_MAGIC) - 1 && memcmp(data, TOPOLOGY_MAGIC, sizeof(TOPOLOGY_MAGIC) - 1) == 0) {
+        // binary files stay mapped for as long as the topology is used
+        topology_t* topology = map_binary((void*)data, size);
+        if (topology == NULL) {
+            munmap((void*)data, size);
+            return NULL;
+        }
+        topology->file_bytes = size;
+        topology->load_seconds = (double)(timer_now_ns() - start_ns) / 1e9;
+        return topology;
+    }
+    madvise((void*)data, size, MADV_SEQUENTIAL);
+    const char* end = data + size;
+
+    // the first word is the node count of a matrix, or "edges" for an edge list
+    const char* cursor = data;
+    while (cursor < end && is_space(*cursor)) {
+        cursor++;
+    }
+    int64_t num_nodes;
+    topology_t* topology;
+    if ((size_t)(end - cursor) > 5 && strncmp(cursor, "edges", 5) == 0 && is_space(cursor[5])) {
+        cursor += 5;
+        int64_t num_lines;
+        int found = next_token(&cursor, end, &num_nodes);
+        assert(found == 1);
+        found = next_token(&cursor, end, &num_lines);
+        assert(found == 1 && num_lines >= 0);
+        (void)found;
+        topology = read_edges(cursor, end, (size_t)num_nodes, (size_t)num_lines, num_threads);
+    } else {
+        int found = next_token(&cursor, end, &num_nodes);
+        assert(found == 1);
+        (void)found;
+        topology = read_matrix(cursor, end, (size_t)num_nodes, num_threads);
+    }
+    munmap((void*)data, size);
+    topology->file_bytes = size;
+    topology->load_seconds = (double)(timer_now_ns() - start_ns) / 1e9;
+    return topology;
+}
+
+void topology_free(topology_t* topology)
+{
+    if (topology->mapping != NULL) {
+        munmap(topology->mapping, topology->file_bytes);
+    } else {
+        free(topology->offsets);
+        free(topology->targets);
+        free(topology->costs);
+    }
+    free(topology);
+}
+
+topology_t* topology_with_links(const topology_t* topology, const uint32_t* src, const uint32_t* dst, size_t count)
+{
+    // the links already there sort first among lines for the same link, and keep their costs
+    size_t num_lines = topology->num_links + count;
+    edge_line_t* lines = malloc(sizeof(edge_line_t) * (num_lines > 0 ? num_lines : 1));
+    assert(lines != NULL);
+    for (size_t node = 0; node < topology->num_nodes; node++) {
+        for (size_t link = topology->offsets[node]; link < topology->offsets[node + 1]; link++) {
+            lines[link] = (edge_line_t){(uint32_t)node, topology->targets[link], topology->costs[link], link};
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        assert(src[i] < topology->num_nodes && dst[i] < topology->num_nodes);
+        lines[topology->num_links + i] = (edge_line_t){src[i], dst[i], inf_distance, topology->num_links + i};
+    }
+    qsort(lines, num_lines, sizeof(edge_line_t), compare_edge_lines);
+
+    topology_t* copy = topology_allocate(topology->num_nodes, num_lines);
+    size_t row = 0;
+    for (size_t i = 0; i < num_lines; i++) {
+        bool first = i == 0 || lines[i - 1].src != lines[i].src || lines[i - 1].dst != lines[i].dst;
+        if (first && lines[i].src != lines[i].dst) {
+            append_link(copy, &row, lines[i].src, lines[i].dst, lines[i].cost);
+        }
+    }
+    finish_rows(copy, row);
+    free(lines);
+    copy->file_bytes = topology->file_bytes;
+    copy->load_seconds = topology->load_seconds;
+    return copy;
+}
+
+distance_t topology_link(const topology_t* topology, size_t src, size_t dst)
+{
+    if (src == dst) {
+        return 0;
+    }
+    size_t link = topology_find(topology, src, dst);
+    return link != SIZE_MAX ? topology->costs[link] : inf_distance;
+}
+
+size_t topology_find(const topology_t* topology, size_t src, size_t dst)
+{
+    size_t low = topology->offsets[src];
+    size_t high = topology->offsets[src + 1];
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (topology->targets[middle] < dst) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < topology->offsets[src + 1] && topology->targets[low] == dst ? low : SIZE_MAX;
+}
+
+void topology_to_matrix(const topology_t* topology, distance_t* dist)
+{
+    size_t n = topology->num_nodes;
+    for (size_t src = 0; src < n; src++) {
+        distance_t* row = &dist[src * n];
+        for (size_t dst = 0; dst < n; dst++) {
+            row[dst] = inf_distance;
+        }
+        row[src] = 0;
+        for (size_t link = topology->offsets[src]; link < topology->offsets[src + 1]; link++) {
+            row[topology->targets[link]] = topology->costs[link];
+        }
+    }
+}
+
+int topology_write_binary(FILE* file, const topology_t* topology, const distance_t* solution)
+{
+    topology_header_t header;
+    memcpy(header.magic, TOPOLOGY_MAGIC, sizeof(header.magic));
+    header.version = TOPOLOGY_VERSION;
+    header.flags = solution != NULL ? TOPOLOGY_HAS_SOLUTION : 0;
+    header.num_nodes = topology->num_nodes;
+    header.num_links = topology->num_links;
+    size_t n = topology->num_nodes;
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(topology->offsets, sizeof(size_t), n + 1, file);
+    fwrite(topology->targets, sizeof(uint32_t), topology->num_links, file);
+    fwrite(topology->costs, sizeof(distance_t), topology->num_links, file);
+    if (solution != NULL) {
+        fwrite(solution, sizeof(distance_t), n * n, file);
+    }
+    return ferror(file) ? -1 : 0;
+}
@@ -0,0 +1,81 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "apsp.h"
+
+// Router topology in compressed sparse row form: the links leaving node are
+//     targets[offsets[node]] ... targets[offsets[node + 1] - 1]
+// sorted by target, with their costs at the same indexes, so memory grows with the links, not nodes^2
+// Only links between distinct nodes with a cost below inf_distance are stored, except those topology_with_links
+// adds; every node is at distance 0 from itself
+typedef struct {
+    size_t num_nodes;
+    size_t num_links;
+    size_t* offsets;   // num_nodes + 1 entries
+    uint32_t* targets; // num_links entries
+    distance_t* costs; // num_links entries
+    size_t file_bytes;   // size of the file it was loaded from
+    double load_seconds; // time spent loading it, file_bytes / load_seconds being the parse throughput
+    const distance_t* solution; // num_nodes * num_nodes shortest distances if a binary file had them, or NULL
+    void* mapping;              // the binary file the arrays point into, or NULL if they were allocated
+} topology_t;
+
+// The binary format, in the byte order of the machine that wrote it:
+//     topology_header_t
+//     size_t offsets[num_nodes + 1]
+//     uint32_t targets[num_links]
+//     distance_t costs[num_links]
+//     distance_t solution[num_nodes * num_nodes], only with TOPOLOGY_HAS_SOLUTION
+// so loading it maps the file and points the arrays into it, with nothing to parse
+#define TOPOLOGY_MAGIC "CHANTOPO"
+#define TOPOLOGY_VERSION 1
+#define TOPOLOGY_HAS_SOLUTION 1u
+
+typedef struct {
+    char magic[8]; // TOPOLOGY_MAGIC, without its terminating zero
+    uint32_t version;
+    uint32_t flags;
+    uint64_t num_nodes;
+    uint64_t num_links;
+} topology_header_t;
+
+// Files are parsed in ranges of at least this many bytes, one thread per range
+#define TOPOLOGY_PARSE_CHUNK (64 * 1024)
+
+// Reads a topology file in any format stress.c accepts: the binary format above, or one of the text formats
+// of topogen.h, the dense matrix, where negative costs mean no link, or the sparse edge list, where a later
+// line for the same link replaces an earlier one
+// Text files are memory-mapped and split between up to num_threads threads (0 for one per online CPU), with
+// the same results as reading them with fscanf
+// Returns NULL if the file cannot be opened or is a malformed binary file
+topology_t* topology_load(const char* filename, size_t num_threads);
+
+void topology_free(topology_t* topology);
+
+// Returns a copy of topology that also has a link from src[i] to dst[i] for each i < count, at inf_distance
+// where topology has none, for code that walks the links to leave room for ones that come up later
+topology_t* topology_with_links(const topology_t* topology, const uint32_t* src, const uint32_t* dst, size_t count);
+
+// Returns the cost of the link from src to dst, 0 if they are the same node, inf_distance if there is none
+distance_t topology_link(const topology_t* topology, size_t src, size_t dst);
+
+// Returns the index in targets and costs of the link from src to dst, or SIZE_MAX if there is none
+size_t topology_find(const topology_t* topology, size_t src, size_t dst);
+
+// Returns the number of links leaving node
+static inline size_t topology_degree(const topology_t* topology, size_t node)
+{
+    return topology->offsets[node + 1] - topology->offsets[node];
+}
+
+// Fills the num_nodes * num_nodes row-major matrix dist with the link costs, as apsp.h expects them
+void topology_to_matrix(const topology_t* topology, distance_t* dist);
+
+// Writes topology in the binary format, with the shortest distances unless solution is NULL
+// Returns 0, or -1 if writing failed
+int topology_write_binary(FILE* file, const topology_t* topology, const distance_t* solution);
+
+#endif // TOPOLOGY_H
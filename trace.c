@@ -0,0 +1,208 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "timer.h"
+#include "trace.h"
+
+// Per-thread ring, written only by its owner so recording needs no locks or atomic read-modify-writes
+typedef struct trace_ring {
+    struct trace_ring* next; // next ring in the list of all rings
+    uint32_t tid;            // small id shown as the thread in the trace viewer
+    uint64_t sample_counter; // operations started by the owner, for the sampler
+    atomic_uint_fast64_t head; // events ever written, the next event goes to head % TRACE_RING_SIZE
+    trace_event_t events[TRACE_RING_SIZE];
+} trace_ring_t;
+
+atomic_bool trace_enabled = false;
+__thread bool trace_sampled = false;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+// all rings, protected by trace_lock; only grows between trace_free calls
+static trace_ring_t* rings;
+static uint32_t next_tid;
+// bumped by trace_free so that threads notice their cached ring is gone
+static atomic_uint_fast64_t ring_generation;
+static __thread trace_ring_t* thread_ring;
+static __thread uint64_t thread_ring_generation;
+
+static atomic_uint_fast32_t sample_every = 1;
+// timestamp and CLOCK_MONOTONIC time at trace_start, to convert TSC ticks into microseconds
+static uint64_t start_timestamp;
+static uint64_t start_ns;
+
+static uint64_t trace_timestamp(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return timer_now_ns();
+#endif
+}
+
+static trace_ring_t* trace_thread_ring(void)
+{
+    uint64_t generation = atomic_load_explicit(&ring_generation, memory_order_acquire);
+    if (thread_ring != NULL && thread_ring_generation == generation) {
+        return thread_ring;
+    }
+    trace_ring_t* ring = malloc(sizeof(trace_ring_t));
+    assert(ring != NULL);
+    ring->sample_counter = 0;
+    atomic_init(&ring->head, 0);
+    pthread_mutex_lock(&trace_lock);
+    ring->tid = ++next_tid;
+    ring->next = rings;
+    rings = ring;
+    pthread_mutex_unlock(&trace_lock);
+    thread_ring = ring;
+    thread_ring_generation = generation;
+    return ring;
+}
+
+void trace_record(enum trace_event_type type, const void* channel, int status)
+{
+    trace_ring_t* ring = trace_thread_ring();
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    trace_event_t* event = &ring->events[head % TRACE_RING_SIZE];
+    event->timestamp = trace_timestamp();
+    event->channel = channel;
+    event->type = (uint32_t)type;
+    event->status = status;
+    // publish the event; the exporter only runs at quiescence but reads head with acquire
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void trace_begin_sampled(enum trace_event_type type, const void* channel)
+{
+    trace_ring_t* ring = trace_thread_ring();
+    uint32_t every = (uint32_t)atomic_load_explicit(&sample_every, memory_order_relaxed);
+    trace_sampled = ring->sample_counter++ % every == 0;
+    if (trace_sampled) {
+        trace_record(type, channel, 0);
+    }
+}
+
+void trace_start(uint32_t every)
+{
+    pthread_mutex_lock(&trace_lock);
+    for (trace_ring_t* ring = rings; ring != NULL; ring = ring->next) {
+        atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+        ring->sample_counter = 0;
+    }
+    atomic_store_explicit(&sample_every, every == 0 ? 1 : every, memory_order_relaxed);
+    start_ns = timer_now_ns();
+    start_timestamp = trace_timestamp();
+    pthread_mutex_unlock(&trace_lock);
+    atomic_store(&trace_enabled, true);
+}
+
+void trace_stop(void)
+{
+    atomic_store(&trace_enabled, false);
+}
+
+uint64_t trace_dropped_events(void)
+{
+    uint64_t dropped = 0;
+    pthread_mutex_lock(&trace_lock);
+    for (trace_ring_t* ring = rings; ring != NULL; ring = ring->next) {
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (head > TRACE_RING_SIZE) {
+            dropped += head - TRACE_RING_SIZE;
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+    return dropped;
+}
+
+static const char* event_names[TRACE_EVENT_TYPES] = {
+    "send", "send", "receive", "receive", "select", "select",
+    "block", "wake", "select_register", "select_unregister", "close",
+};
+
+static const char* event_phase(uint32_t type)
+{
+    switch (type) {
+    case TRACE_SEND_BEGIN:
+    case TRACE_RECV_BEGIN:
+    case TRACE_SELECT_BEGIN:
+        return "B";
+    case TRACE_SEND_END:
+    case TRACE_RECV_END:
+    case TRACE_SELECT_END:
+        return "E";
+    default:
+        return "i";
+    }
+}
+
+size_t trace_write_chrome_json(FILE* file)
+{
+    pthread_mutex_lock(&trace_lock);
+    // ticks per microsecond, measured over the whole recording
+    double ticks_per_us = 1000.0;
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t elapsed_ns = timer_now_ns() - start_ns;
+    uint64_t elapsed_ticks = trace_timestamp() - start_timestamp;
+    if (elapsed_ns > 0) {
+        ticks_per_us = (double)elapsed_ticks * 1000.0 / (double)elapsed_ns;
+    }
+#endif
+    size_t written = 0;
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (trace_ring_t* ring = rings; ring != NULL; ring = ring->next) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                ring == rings ? "" : ",\n", ring->tid, ring->tid);
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        for (uint64_t i = first; i < head; i++) {
+            const trace_event_t* event = &ring->events[i % TRACE_RING_SIZE];
+            // events recorded before trace_start's calibration point are clamped to the start
+            double ts = event->timestamp > start_timestamp ? (double)(event->timestamp - start_timestamp) / ticks_per_us : 0.0;
+            const char* phase = event_phase(event->type);
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f",
+                    event_names[event->type], phase, ring->tid, ts);
+            if (phase[0] == 'i') {
+                fprintf(file, ",\"s\":\"t\"");
+            }
+            fprintf(file, ",\"args\":{\"channel\":\"%p\"", event->channel);
+            if (phase[0] == 'E') {
+                fprintf(file, ",\"status\":%d", event->status);
+            }
+            fprintf(file, "}}");
+            written++;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    pthread_mutex_unlock(&trace_lock);
+    return written;
+}
+
+long trace_write_chrome_json_path(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    size_t written = trace_write_chrome_json(file);
+    if (fclose(file) != 0) {
+        return -1;
+    }
+    return (long)written;
+}
+
+void trace_free(void)
+{
+    pthread_mutex_lock(&trace_lock);
+    while (rings != NULL) {
+        trace_ring_t* next = rings->next;
+        free(rings);
+        rings = next;
+    }
+    next_tid = 0;
+    atomic_fetch_add_explicit(&ring_generation, 1, memory_order_release);
+    pthread_mutex_unlock(&trace_lock);
+}
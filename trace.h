@@ -0,0 +1,116 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Channel event tracing, compiled in by default but idle until trace_start is called
+// While idle every hook costs one relaxed atomic load or one thread-local load
+// Build with -DCHANNEL_TRACE=0 to compile the hooks out of channel.c entirely
+#ifndef CHANNEL_TRACE
+#define CHANNEL_TRACE 1
+#endif
+
+// Events kept per thread; once a ring is full its oldest events are overwritten
+#define TRACE_RING_SIZE 16384
+
+enum trace_event_type {
+    TRACE_SEND_BEGIN,        // send, non-blocking send or batch send entered
+    TRACE_SEND_END,          // ... and returned, with its status
+    TRACE_RECV_BEGIN,        // receive, non-blocking receive or batch receive entered
+    TRACE_RECV_END,          // ... and returned, with its status
+    TRACE_SELECT_BEGIN,      // channel_select entered
+    TRACE_SELECT_END,        // ... and returned, with its status
+    TRACE_BLOCK,             // thread is about to sleep on a condition variable
+    TRACE_WAKE,              // ... and woke up again
+    TRACE_SELECT_REGISTER,   // a blocking select registered itself on a channel
+    TRACE_SELECT_UNREGISTER, // ... and removed itself again
+    TRACE_CLOSE,             // channel_close
+    TRACE_EVENT_TYPES
+};
+
+typedef struct {
+    uint64_t timestamp;  // TSC ticks where available, CLOCK_MONOTONIC ns otherwise
+    const void* channel; // channel the event happened on, NULL for a select block/wake
+    uint32_t type;       // enum trace_event_type
+    int32_t status;      // return value of *_END events
+} trace_event_t;
+
+// Set while tracing is running
+extern atomic_bool trace_enabled;
+// Set while the calling thread is inside an operation that was picked by the sampler
+extern __thread bool trace_sampled;
+
+// Slow paths of the hooks below, do not call directly
+void trace_begin_sampled(enum trace_event_type type, const void* channel);
+void trace_record(enum trace_event_type type, const void* channel, int status);
+
+// Starts recording and drops every event recorded so far
+// Only one in sample_every operations is recorded, together with all the events inside it (0 is treated as 1)
+// Must be called while no thread is inside a channel operation
+void trace_start(uint32_t sample_every);
+
+// Stops recording, the recorded events stay available for export
+void trace_stop(void);
+
+// Writes the recorded events of all threads as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)
+// Operations become duration slices, blocks, wakes, select registrations and closes become instant events
+// Must be called while no thread is recording, e.g. after trace_stop and joining the traced threads
+// Returns the number of events written
+size_t trace_write_chrome_json(FILE* file);
+
+// Same as trace_write_chrome_json, writing to the file at path
+// Returns the number of events written, or -1 if the file could not be written
+long trace_write_chrome_json_path(const char* path);
+
+// Returns the number of events lost because a ring wrapped around since the last trace_start
+uint64_t trace_dropped_events(void);
+
+// Frees every thread's ring, threads get a fresh ring on their next recorded event
+// Must be called while no thread is recording
+void trace_free(void);
+
+// Hooks used by channel.c
+#if CHANNEL_TRACE
+// Starts an operation, deciding whether it is sampled
+static inline void trace_op_begin(enum trace_event_type type, const void* channel)
+{
+    if (atomic_load_explicit(&trace_enabled, memory_order_relaxed)) {
+        trace_begin_sampled(type, channel);
+    }
+}
+
+// Records an event inside the current operation if it is sampled
+static inline void trace_op_event(enum trace_event_type type, const void* channel)
+{
+    if (trace_sampled) {
+        trace_record(type, channel, 0);
+    }
+}
+
+// Records a standalone event, such as a close, whenever tracing is running
+static inline void trace_op_instant(enum trace_event_type type, const void* channel)
+{
+    if (atomic_load_explicit(&trace_enabled, memory_order_relaxed)) {
+        trace_record(type, channel, 0);
+    }
+}
+
+// Ends the current operation
+static inline void trace_op_end(enum trace_event_type type, const void* channel, int status)
+{
+    if (trace_sampled) {
+        trace_record(type, channel, status);
+        trace_sampled = false;
+    }
+}
+#else
+static inline void trace_op_begin(enum trace_event_type type, const void* channel) {}
+static inline void trace_op_event(enum trace_event_type type, const void* channel) {}
+static inline void trace_op_instant(enum trace_event_type type, const void* channel) {}
+static inline void trace_op_end(enum trace_event_type type, const void* channel, int status) {}
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,319 @@
+#include <assert.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "timer.h"
+#include "watchdog.h"
+
+// What one thread is blocked on, written by the thread itself and read by the watchdog under lock
+typedef struct watchdog_thread {
+    struct watchdog_thread* next;
+    uint64_t id;  // small id used in the wait-for graph, 1 for the first thread seen
+    long tid;     // kernel thread id, to match reports with gdb or /proc
+    pthread_mutex_t lock;
+    bool waiting;
+    enum watchdog_op op;
+    uint64_t since_ns;     // when the current operation first blocked
+    uint64_t seq;          // operations that blocked so far, so the periodic check reports each one once
+    uint64_t reported_seq; // seq of the last operation reported by the periodic check
+    size_t num_waits;      // channels waited on, may exceed WATCHDOG_MAX_WAITS
+    watchdog_wait_t waits[WATCHDOG_MAX_WAITS];
+} watchdog_thread_t;
+
+atomic_bool watchdog_active = false;
+__thread bool watchdog_waiting = false;
+
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+// every thread that has touched a channel while the watchdog was active and has not exited yet
+static watchdog_thread_t* threads;
+static uint64_t next_id;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_key;
+static __thread watchdog_thread_t* self;
+
+static pthread_mutex_t watchdog_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t watchdog_cond;
+static pthread_t watchdog_thread;
+static bool watchdog_running = false;
+static bool watchdog_stopping = false;
+static uint64_t watchdog_threshold_ns;
+static uint64_t watchdog_period_ns;
+static FILE* watchdog_out;
+
+static const char* op_names[] = {"send", "receive", "select"};
+
+// Drops the record of an exiting thread
+static void thread_exit(void* arg)
+{
+    watchdog_thread_t* thread = arg;
+    pthread_mutex_lock(&threads_lock);
+    for (watchdog_thread_t** link = &threads; *link != NULL; link = &(*link)->next) {
+        if (*link == thread) {
+            *link = thread->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&threads_lock);
+    pthread_mutex_destroy(&thread->lock);
+    free(thread);
+}
+
+static void key_create(void)
+{
+    int status = pthread_key_create(&thread_key, thread_exit);
+    assert(status == 0);
+    (void)status;
+}
+
+static watchdog_thread_t* thread_self(void)
+{
+    if (self != NULL) {
+        return self;
+    }
+    pthread_once(&key_once, key_create);
+    watchdog_thread_t* thread = calloc(1, sizeof(watchdog_thread_t));
+    assert(thread != NULL);
+    pthread_mutex_init(&thread->lock, NULL);
+    thread->tid = syscall(SYS_gettid);
+    pthread_mutex_lock(&threads_lock);
+    thread->id = ++next_id;
+    thread->next = threads;
+    threads = thread;
+    pthread_mutex_unlock(&threads_lock);
+    pthread_setspecific(thread_key, thread);
+    self = thread;
+    return thread;
+}
+
+uint64_t watchdog_thread_id(void)
+{
+    return thread_self()->id;
+}
+
+void watchdog_wait_begin(enum watchdog_op op)
+{
+    watchdog_thread_t* thread = thread_self();
+    pthread_mutex_lock(&thread->lock);
+    if (!thread->waiting) {
+        thread->waiting = true;
+        thread->since_ns = timer_now_ns();
+        thread->seq++;
+    }
+    // the channels (and their likely peers) are published again on every sleep
+    thread->op = op;
+    thread->num_waits = 0;
+    pthread_mutex_unlock(&thread->lock);
+    watchdog_waiting = true;
+}
+
+void watchdog_wait_channel(const channel_t* channel, enum direction dir, uint64_t peer)
+{
+    watchdog_thread_t* thread = thread_self();
+    pthread_mutex_lock(&thread->lock);
+    if (thread->num_waits < WATCHDOG_MAX_WAITS) {
+        watchdog_wait_t* wait = &thread->waits[thread->num_waits];
+        wait->channel = channel;
+        memcpy(wait->name, channel->name, sizeof(wait->name));
+        wait->dir = dir;
+        wait->peer = peer;
+    }
+    thread->num_waits++;
+    pthread_mutex_unlock(&thread->lock);
+}
+
+void watchdog_wait_end(void)
+{
+    watchdog_waiting = false;
+    watchdog_thread_t* thread = thread_self();
+    pthread_mutex_lock(&thread->lock);
+    thread->waiting = false;
+    pthread_mutex_unlock(&thread->lock);
+}
+
+// Returns the index of the thread with the given id in the snapshot, count if it is not (or no longer) there
+static size_t find_thread(const watchdog_thread_t* snapshot, size_t count, uint64_t id)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (snapshot[i].id == id) {
+            return i;
+        }
+    }
+    return count;
+}
+
+static void report_thread(FILE* out, const watchdog_thread_t* thread, uint64_t now)
+{
+    fprintf(out, "watchdog: thread %llu (tid %ld) blocked for %llu ms in %s on %zu channel%s:\n",
+            (unsigned long long)thread->id, thread->tid, (unsigned long long)((now - thread->since_ns) / 1000000),
+            op_names[thread->op], thread->num_waits, thread->num_waits == 1 ? "" : "s");
+    size_t shown = thread->num_waits < WATCHDOG_MAX_WAITS ? thread->num_waits : WATCHDOG_MAX_WAITS;
+    for (size_t i = 0; i < shown; i++) {
+        const watchdog_wait_t* wait = &thread->waits[i];
+        fprintf(out, "watchdog:   %s \"%s\" (%p), waiting for ", wait->dir == SEND ? "send on" : "receive from",
+                wait->name, (const void*)wait->channel);
+        if (wait->peer == 0) {
+            fprintf(out, "an unknown %s\n", wait->dir == SEND ? "receiver" : "sender");
+        } else {
+            fprintf(out, "thread %llu\n", (unsigned long long)wait->peer);
+        }
+    }
+}
+
+// Checks all threads; when only_new is set, threads whose current operation was already reported are skipped
+static watchdog_report_t check(FILE* out, uint64_t threshold_ns, bool only_new)
+{
+    watchdog_report_t report = {0, 0, 0};
+    pthread_mutex_lock(&threads_lock);
+    size_t count = 0;
+    for (watchdog_thread_t* thread = threads; thread != NULL; thread = thread->next) {
+        count++;
+    }
+    watchdog_thread_t* snapshot = malloc(sizeof(watchdog_thread_t) * (count > 0 ? count : 1));
+    bool* progress = malloc(sizeof(bool) * (count > 0 ? count : 1));
+    bool* reported = malloc(sizeof(bool) * (count > 0 ? count : 1));
+    assert(snapshot != NULL && progress != NULL && reported != NULL);
+    size_t index = 0;
+    uint64_t now = timer_now_ns();
+    for (watchdog_thread_t* thread = threads; thread != NULL; thread = thread->next) {
+        pthread_mutex_lock(&thread->lock);
+        snapshot[index] = *thread;
+        reported[index] = thread->reported_seq == thread->seq;
+        if (only_new && thread->waiting && now - thread->since_ns > threshold_ns) {
+            thread->reported_seq = thread->seq;
+        }
+        pthread_mutex_unlock(&thread->lock);
+        index++;
+    }
+    pthread_mutex_unlock(&threads_lock);
+
+    // a thread can make progress unless it is stalled and every thread that could unblock it is stuck too
+    for (size_t i = 0; i < count; i++) {
+        bool stalled = snapshot[i].waiting && now - snapshot[i].since_ns > threshold_ns;
+        report.blocked += snapshot[i].waiting;
+        report.stalled += stalled;
+        progress[i] = !stalled || snapshot[i].num_waits == 0 || snapshot[i].num_waits > WATCHDOG_MAX_WAITS;
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < count; i++) {
+            for (size_t w = 0; !progress[i] && w < snapshot[i].num_waits; w++) {
+                size_t peer = find_thread(snapshot, count, snapshot[i].waits[w].peer);
+                if (peer == count || progress[peer]) {
+                    progress[i] = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        bool stalled = snapshot[i].waiting && now - snapshot[i].since_ns > threshold_ns;
+        report.deadlocked += !progress[i];
+        if (out != NULL && stalled && !(only_new && reported[i])) {
+            report_thread(out, &snapshot[i], now);
+        }
+    }
+    // walk each deadlock once, following the first stuck peer of every thread until the walk closes a cycle
+    for (size_t start = 0; out != NULL && start < count; start++) {
+        if (progress[start] || (only_new && reported[start])) {
+            continue;
+        }
+        size_t current = start;
+        fprintf(out, "watchdog: deadlock: thread %llu", (unsigned long long)snapshot[current].id);
+        progress[current] = true;
+        while (true) {
+            size_t next = count;
+            for (size_t w = 0; w < snapshot[current].num_waits && next == count; w++) {
+                size_t peer = find_thread(snapshot, count, snapshot[current].waits[w].peer);
+                if (peer != count && (!progress[peer] || peer == start)) {
+                    next = peer;
+                }
+            }
+            if (next == count) {
+                break;
+            }
+            fprintf(out, " -> thread %llu", (unsigned long long)snapshot[next].id);
+            if (next == start) {
+                break;
+            }
+            progress[next] = true;
+            current = next;
+        }
+        fprintf(out, "\n");
+    }
+    if (out != NULL) {
+        fflush(out);
+    }
+    free(reported);
+    free(progress);
+    free(snapshot);
+    return report;
+}
+
+watchdog_report_t watchdog_check(FILE* out, uint64_t threshold_ns)
+{
+    return check(out, threshold_ns, false);
+}
+
+static void* watchdog_main(void* arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&watchdog_lock);
+    while (!watchdog_stopping) {
+        uint64_t wake_ns = timer_now_ns() + watchdog_period_ns;
+        struct timespec wake;
+        wake.tv_sec = (time_t)(wake_ns / 1000000000ull);
+        wake.tv_nsec = (long)(wake_ns % 1000000000ull);
+        pthread_cond_timedwait(&watchdog_cond, &watchdog_lock, &wake);
+        if (!watchdog_stopping) {
+            check(watchdog_out, watchdog_threshold_ns, true);
+        }
+    }
+    pthread_mutex_unlock(&watchdog_lock);
+    return NULL;
+}
+
+int watchdog_start(uint64_t threshold_ns, uint64_t period_ns, FILE* out)
+{
+    pthread_mutex_lock(&watchdog_lock);
+    if (watchdog_running) {
+        pthread_mutex_unlock(&watchdog_lock);
+        return -1;
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&watchdog_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    watchdog_threshold_ns = threshold_ns;
+    watchdog_period_ns = period_ns;
+    watchdog_out = out;
+    watchdog_stopping = false;
+    watchdog_running = true;
+    atomic_store(&watchdog_active, true);
+    int pthread_status = pthread_create(&watchdog_thread, NULL, watchdog_main, NULL);
+    assert(pthread_status == 0);
+    (void)pthread_status;
+    pthread_mutex_unlock(&watchdog_lock);
+    return 0;
+}
+
+void watchdog_stop(void)
+{
+    pthread_mutex_lock(&watchdog_lock);
+    if (!watchdog_running) {
+        pthread_mutex_unlock(&watchdog_lock);
+        return;
+    }
+    atomic_store(&watchdog_active, false);
+    watchdog_stopping = true;
+    pthread_cond_signal(&watchdog_cond);
+    pthread_mutex_unlock(&watchdog_lock);
+    pthread_join(watchdog_thread, NULL);
+    pthread_cond_destroy(&watchdog_cond);
+    pthread_mutex_lock(&watchdog_lock);
+    watchdog_running = false;
+    pthread_mutex_unlock(&watchdog_lock);
+}
@@ -0,0 +1,91 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "channel.h"
+
+// Opt-in watchdog for blocked channel operations
+// While it runs, every thread that blocks in a send, receive or select publishes what it waits for, and every
+// channel remembers the last thread that sent on it and the last one that received from it
+// A blocked sender most likely waits for the channel's last receiver, a blocked receiver for its last sender;
+// following those edges gives a wait-for graph between threads, in which the watchdog looks for deadlocks
+
+// Channels of a select beyond this many are waited on but not reported
+#define WATCHDOG_MAX_WAITS 8
+
+enum watchdog_op {
+    WATCHDOG_SEND,
+    WATCHDOG_RECEIVE,
+    WATCHDOG_SELECT,
+};
+
+// One channel a blocked thread waits on
+typedef struct {
+    const channel_t* channel; // identity only, never dereferenced by the watchdog
+    char name[CHANNEL_NAME_MAX];
+    enum direction dir;
+    uint64_t peer; // watchdog id of the thread most likely to unblock this wait, 0 if unknown
+} watchdog_wait_t;
+
+typedef struct {
+    size_t blocked;    // threads currently blocked in a channel operation
+    size_t stalled;    // ... for longer than the threshold
+    size_t deadlocked; // stalled threads that can only be unblocked by other deadlocked threads
+} watchdog_report_t;
+
+// Set while the watchdog runs
+extern atomic_bool watchdog_active;
+// Set while the calling thread is blocked, or about to block, in a channel operation
+extern __thread bool watchdog_waiting;
+
+// Slow paths of the hooks below, do not call directly
+uint64_t watchdog_thread_id(void);
+void watchdog_wait_begin(enum watchdog_op op);
+void watchdog_wait_channel(const channel_t* channel, enum direction dir, uint64_t peer);
+void watchdog_wait_end(void);
+
+// Starts tracking blocked operations and a thread that checks them every period_ns, writing a report to out
+// about every thread blocked for longer than threshold_ns (each blocked operation is reported once)
+// and about every deadlock found
+// Returns 0 on success, -1 if the watchdog is already running
+int watchdog_start(uint64_t threshold_ns, uint64_t period_ns, FILE* out);
+
+// Stops the watchdog thread and the tracking
+void watchdog_stop(void);
+
+// Checks all blocked threads right now, reporting every one blocked for longer than threshold_ns to out
+// (out may be NULL to only count them)
+// Only operations that blocked while the watchdog was running are seen
+watchdog_report_t watchdog_check(FILE* out, uint64_t threshold_ns);
+
+// Hooks used by channel.c, all assume the channel's lock is held
+// Remembers the calling thread as the channel's most recent sender or receiver
+static inline void watchdog_note_peer(uint64_t* last_peer)
+{
+    if (atomic_load_explicit(&watchdog_active, memory_order_relaxed)) {
+        *last_peer = watchdog_thread_id();
+    }
+}
+
+// Publishes that the calling thread is about to block on channel, waiting for peer
+// A blocking operation that sleeps several times keeps the time of its first sleep
+static inline void watchdog_block(enum watchdog_op op, const channel_t* channel, enum direction dir, uint64_t peer)
+{
+    if (atomic_load_explicit(&watchdog_active, memory_order_relaxed)) {
+        watchdog_wait_begin(op);
+        watchdog_wait_channel(channel, dir, peer);
+    }
+}
+
+// Ends the calling thread's wait once its operation returns
+static inline void watchdog_done(void)
+{
+    if (watchdog_waiting) {
+        watchdog_wait_end();
+    }
+}
+
+#endif // WATCHDOG_H